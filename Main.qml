@@ -13,8 +13,15 @@ ApplicationWindow {
     property int rows: 0
     property int columns: 0
     property int selectedRow: -1
+    readonly property var columnWidths: [380, 200, 120, 160, 180, 180, 300]  // Part Name wider, Vendor wider
     property string fileType: "stock"  // "stock" or "purchase"
 
+    // Bring search hits and clicked rows into view
+    onSelectedRowChanged: {
+        if (selectedRow >= 0 && selectedRow < tableView.rows)
+            tableView.positionViewAtRow(selectedRow, TableView.Contain)
+    }
+
     title: {
         var fileName = "Untitled"
         if (excelHandler.currentFile !== "") {
@@ -56,6 +63,33 @@ ApplicationWindow {
         onSearchResultFound: function(row) {
             root.selectedRow = row
         }
+
+        onOperationStarted: function(operation) {
+            operationProgressBar.rowsProcessed = 0
+            operationProgressBar.bytesWritten = 0
+        }
+
+        onOperationProgress: function(operation, rowsProcessed, bytesWritten) {
+            operationProgressBar.rowsProcessed = rowsProcessed
+            operationProgressBar.bytesWritten = bytesWritten
+        }
+
+        onOperationFinished: function(operation, success) {
+            if (!success)
+                return
+            if (operation === "load") {
+                rows = excelHandler.model.rowCount()
+                columns = excelHandler.model.columnCount()
+                selectedRow = -1
+                root.fileType = excelHandler.getFileType()
+                console.log("📊 File opened - Rows:", rows, "Columns:", columns, "Type:", root.fileType)
+            } else if (operation === "merge") {
+                rows = excelHandler.model.rowCount()
+                columns = excelHandler.model.columnCount()
+            } else if (operation === "sync") {
+                statusLabel.text = "✅ Synced to cloud"
+            }
+        }
     }
 
     /* ================= DIALOGS ================= */
@@ -229,13 +263,7 @@ ApplicationWindow {
         fileMode: FileDialog.OpenFile
 
         onAccepted: {
-            if (excelHandler.loadExcel(selectedFile)) {
-                rows = excelHandler.model.rowCount()
-                columns = excelHandler.model.columnCount()
-                selectedRow = -1
-                root.fileType = excelHandler.getFileType()
-                console.log("📊 File opened - Rows:", rows, "Columns:", columns, "Type:", root.fileType)
-            }
+            excelHandler.loadExcelAsync(selectedFile)
         }
     }
 
@@ -247,7 +275,7 @@ ApplicationWindow {
         defaultSuffix: "xlsx"
 
         onAccepted: {
-            excelHandler.saveExcel(selectedFile)
+            excelHandler.saveExcelAsync(selectedFile)
         }
     }
 
@@ -280,10 +308,7 @@ ApplicationWindow {
         fileMode: FileDialog.OpenFile
 
         onAccepted: {
-            if (excelHandler.appendFromFile(selectedFile)) {
-                rows = excelHandler.model.rowCount()
-                columns = excelHandler.model.columnCount()
-            }
+            excelHandler.appendFromFileAsync(selectedFile)
         }
     }
 
@@ -753,6 +778,7 @@ ApplicationWindow {
 
             ToolButton {
                 text: "📦 Create Stock"
+                enabled: !excelHandler.busy
                 onClicked: newStockFileDialog.open()
                 ToolTip.visible: hovered
                 ToolTip.text: "Create new stock file"
@@ -805,7 +831,7 @@ ApplicationWindow {
 
             ToolButton {
                 text: "📌 Set Permanent"
-                enabled: loginDialog.isAuthenticated
+                enabled: loginDialog.isAuthenticated && !excelHandler.busy
                 onClicked: setPermanentDialog.open()
                 contentItem: Text {
                     text: parent.text
@@ -839,8 +865,8 @@ ApplicationWindow {
 
             ToolButton {
                 text: "💾 Save"
-                enabled: excelHandler.currentFile !== "" && loginDialog.isAuthenticated
-                onClicked: excelHandler.saveExcel("")
+                enabled: excelHandler.currentFile !== "" && loginDialog.isAuthenticated && !excelHandler.busy
+                onClicked: excelHandler.saveExcelAsync("")
                 contentItem: Text {
                     text: parent.text
                     color: parent.enabled ? "white" : "#7f8c8d"
@@ -987,12 +1013,8 @@ ApplicationWindow {
             // Sync To Cloud
             ToolButton {
                 text: "⬆️"
-                enabled: excelHandler.canEdit()
-                onClicked: {
-                    if (excelHandler.syncToCloud()) {
-                        statusLabel.text = "✅ Synced to cloud"
-                    }
-                }
+                enabled: excelHandler.canEdit() && !excelHandler.busy
+                onClicked: excelHandler.syncToCloudAsync()
                 ToolTip.visible: hovered
                 ToolTip.text: "Sync To Cloud"
             }
@@ -1000,6 +1022,7 @@ ApplicationWindow {
             // Sync From Cloud
             ToolButton {
                 text: "⬇️"
+                enabled: !excelHandler.busy
                 onClicked: {
                     if (excelHandler.syncFromCloud()) {
                         statusLabel.text = "✅ Downloaded from cloud"
@@ -1055,7 +1078,7 @@ ApplicationWindow {
                 Button {
                     text: "Set Now"
                     highlighted: true
-                    enabled: loginDialog.isAuthenticated
+                    enabled: loginDialog.isAuthenticated && !excelHandler.busy
                     onClicked: setPermanentDialog.open()
 
                     background: Rectangle {
@@ -1080,126 +1103,135 @@ ApplicationWindow {
             Layout.preferredHeight: 35
             color: "#2c3e50"
 
-            Row {
-                anchors.fill: parent
-                spacing: 0
-
-                Rectangle {
-                    width: 50
-                    height: 35
-                    color: "#2c3e50"
-                    border.color: "#1a252f"
+            Rectangle {
+                width: 50
+                height: 35
+                color: "#2c3e50"
+                border.color: "#1a252f"
 
-                    Text {
-                        anchors.centerIn: parent
-                        text: "#"
-                        color: "white"
-                        font.bold: true
-                    }
+                Text {
+                    anchors.centerIn: parent
+                    text: "#"
+                    color: "white"
+                    font.bold: true
                 }
+            }
 
-                Repeater {
-                    model: 7  // 7 columns
+            // Follows the table's horizontal scroll
+            Item {
+                x: 50
+                width: parent.width - 50
+                height: 35
+                clip: true
 
-                    Rectangle {
-                        width: {
-                            var widths = [380, 200, 120, 160, 180, 180, 300]  // Part Name wider, Vendor wider
-                            return widths[index]
-                        }
-                        height: 35
-                        color: "#34495e"
-                        border.color: "#2c3e50"
-
-                        Text {
-                            anchors.centerIn: parent
-                            text: {
-                                var headers = ["Part Name", "Part No",
-                                             root.fileType === "purchase" ? "Purchase" : "Stock",
-                                             "Department", "Prepared", "Approved", "Vendor"]
-                                return headers[index]
+                Row {
+                    x: -tableView.contentX
+                    spacing: 0
+
+                    Repeater {
+                        model: 7  // 7 columns
+
+                        Rectangle {
+                            width: root.columnWidths[index]
+                            height: 35
+                            color: "#34495e"
+                            border.color: "#2c3e50"
+
+                            Text {
+                                anchors.centerIn: parent
+                                text: {
+                                    var headers = ["Part Name", "Part No",
+                                                 root.fileType === "purchase" ? "Purchase" : "Stock",
+                                                 "Department", "Prepared", "Approved", "Vendor"]
+                                    return headers[index]
+                                }
+                                color: "white"
+                                font.bold: true
+                                font.pixelSize: 12
                             }
-                            color: "white"
-                            font.bold: true
-                            font.pixelSize: 12
                         }
                     }
                 }
             }
         }
 
-        // Data Area
-        ScrollView {
+        // Data Area - TableView only creates the visible cells and recycles
+        // them while scrolling
+        RowLayout {
             Layout.fillWidth: true
             Layout.fillHeight: true
-            clip: true
+            spacing: 0
 
-            Column {
-                spacing: 0
+            VerticalHeaderView {
+                id: rowHeader
+                syncView: tableView
+                Layout.preferredWidth: 50
+                Layout.fillHeight: true
+                clip: true
 
-                Repeater {
-                    model: root.rows
+                delegate: Rectangle {
+                    implicitWidth: 50
+                    implicitHeight: 35
+                    color: root.selectedRow === row ? "#27ae60" : "#95a5a6"
+                    border.color: "#7f8c8d"
 
-                    Row {
-                        spacing: 0
-                        property int r: index
+                    Text {
+                        anchors.centerIn: parent
+                        text: row + 1
+                        color: root.selectedRow === row ? "white" : "#2c3e50"
+                        font.bold: root.selectedRow === row
+                    }
 
-                        Rectangle {
-                            width: 50
-                            height: 35
-                            color: root.selectedRow === r ? "#27ae60" : "#95a5a6"
-                            border.color: "#7f8c8d"
+                    MouseArea {
+                        anchors.fill: parent
+                        cursorShape: Qt.PointingHandCursor
+                        onClicked: root.selectedRow = row
+                    }
+                }
+            }
 
-                            Text {
-                                anchors.centerIn: parent
-                                text: r + 1
-                                color: root.selectedRow === r ? "white" : "#2c3e50"
-                                font.bold: root.selectedRow === r
-                            }
+            TableView {
+                id: tableView
+                Layout.fillWidth: true
+                Layout.fillHeight: true
+                clip: true
+                reuseItems: true
+                boundsBehavior: Flickable.StopAtBounds
+                model: excelHandler.model
+
+                // Fixed sizes spare TableView from measuring delegates;
+                // columns past the 7 known ones stay hidden as before
+                columnWidthProvider: function(column) {
+                    return column < root.columnWidths.length ? root.columnWidths[column] : 0
+                }
+                rowHeightProvider: function(row) { return 35 }
 
-                            MouseArea {
-                                anchors.fill: parent
-                                cursorShape: Qt.PointingHandCursor
-                                onClicked: root.selectedRow = r
-                            }
-                        }
+                ScrollBar.vertical: ScrollBar {}
+                ScrollBar.horizontal: ScrollBar {}
 
-                        Repeater {
-                            model: 7  // 7 columns
+                delegate: Rectangle {
+                    implicitHeight: 35
+                    color: root.selectedRow === row ? "#d5f4e6" : "white"
+                    border.color: "#dfe6e9"
 
-                            Rectangle {
-                                width: {
-                                    var widths = [380, 200, 120, 160, 180, 180, 300]  // Part Name wider, Vendor wider
-                                    return widths[index]
-                                }
-                                height: 35
-                                color: root.selectedRow === r ? "#d5f4e6" : "white"
-                                border.color: "#dfe6e9"
-
-                                property int c: index
-
-                                // Regular text input
-                                TextInput {
-                                    visible: true  // Show for all 7 columns
-                                    anchors.fill: parent
-                                    anchors.margins: 4
-                                    verticalAlignment: Text.AlignVCenter
-                                    selectByMouse: true
-                                    enabled: loginDialog.isAuthenticated
-
-                                    text: {
-                                        var v = excelHandler.model.getData(r, c)
-                                        return v === null || v === undefined ? "" : v.toString()
-                                    }
-
-                                    color: enabled ? "black" : "#95a5a6"
-                                    font.pixelSize: 16
-
-                                    onEditingFinished: {
-                                        if (enabled) {
-                                            excelHandler.model.setDataAt(r, c, text)
-                                        }
-                                    }
-                                }
+                    property string cellText: model.display === null || model.display === undefined ?
+                                              "" : model.display.toString()
+
+                    TextInput {
+                        anchors.fill: parent
+                        anchors.margins: 4
+                        verticalAlignment: Text.AlignVCenter
+                        selectByMouse: true
+                        enabled: loginDialog.isAuthenticated
+
+                        text: parent.cellText
+
+                        color: enabled ? "black" : "#95a5a6"
+                        font.pixelSize: 16
+
+                        onEditingFinished: {
+                            if (enabled && text !== parent.cellText) {
+                                model.edit = text
                             }
                         }
                     }
@@ -1245,6 +1277,35 @@ ApplicationWindow {
                 color: "#34495e"
             }
 
+            // Background load/save/merge/sync progress
+            RowLayout {
+                visible: excelHandler.busy
+                spacing: 8
+
+                ProgressBar {
+                    id: operationProgressBar
+                    property int rowsProcessed: 0
+                    property real bytesWritten: 0
+                    indeterminate: true
+                    Layout.preferredWidth: 120
+                }
+
+                Label {
+                    text: operationProgressBar.bytesWritten > 0 ?
+                          "⏳ " + operationProgressBar.rowsProcessed + " rows, " +
+                          Math.round(operationProgressBar.bytesWritten / 1024) + " KB" :
+                          "⏳ " + operationProgressBar.rowsProcessed + " rows"
+                    font.pixelSize: 12
+                    color: "#2c3e50"
+                }
+
+                Button {
+                    text: "✖ Cancel"
+                    flat: true
+                    onClicked: excelHandler.cancelOperation()
+                }
+            }
+
             Item { Layout.fillWidth: true }
 
             Label {
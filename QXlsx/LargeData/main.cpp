@@ -20,6 +20,14 @@ static QVariant make_cell_value(int row, int col)
     }
 }
 
+// Same content as make_cell_value(), typed for Document::writeRow()
+static CellValue make_typed_cell_value(int row, int col)
+{
+    if (col % 2 == 0)
+        return CellValue(row * 1000 + col);
+    return CellValue(QStringLiteral("R%1C%2").arg(row).arg(col));
+}
+
 // Verify several sample cells inside the generated XLSX file
 static bool verify_sample_cells(Document &doc, int row_count, int col_count)
 {
@@ -76,22 +84,27 @@ int main(int argc, char *argv[])
                                      "Apply a simple cell formatting style");
     QCommandLineOption sheet_rows_opt({"S", "sheet-rows"},
                                       "Maximum rows per sheet (0 = single sheet)", "sheetRows", "0");
+    QCommandLineOption write_only_opt({"w", "write-only"},
+                                      "Stream rows into the file as they are written");
 
     parser.addOption(rows_opt);
     parser.addOption(cols_opt);
     parser.addOption(use_style_opt);
     parser.addOption(sheet_rows_opt);
+    parser.addOption(write_only_opt);
     parser.process(app);
 
     int row_count = parser.value(rows_opt).toInt();
     int col_count = parser.value(cols_opt).toInt();
     bool use_style = parser.isSet(use_style_opt);
     int sheet_rows = parser.value(sheet_rows_opt).toInt();
+    bool write_only = parser.isSet(write_only_opt);
 
     qInfo() << "[LargeData] rows =" << row_count
             << "cols =" << col_count
             << "use_style =" << use_style
-            << "sheet_rows =" << sheet_rows;
+            << "sheet_rows =" << sheet_rows
+            << "write_only =" << write_only;
 
     QString file_name = QStringLiteral("large_data_%1x%2.xlsx")
                             .arg(row_count)
@@ -99,6 +112,13 @@ int main(int argc, char *argv[])
 
     Document xlsx;
 
+           // Write-only mode: rows go to the file as they are appended,
+           // so memory stays flat however many rows are written
+    if (write_only && !xlsx.beginWriteOnly(file_name)) {
+        qCritical() << "[LargeData] failed to open file:" << file_name;
+        return 1;
+    }
+
            // Cell formatting (optional)
     Format data_format;
     if (use_style) {
@@ -143,16 +163,26 @@ int main(int argc, char *argv[])
     const double progress_step = 0.1;
     double next_progress = progress_step;
 
+    QVector<CellValue> row_values(col_count);
     for (int row = 1; row <= row_count; ++row) {
 
         ensure_sheet_for_row(row);
 
-        for (int col = 1; col <= col_count; ++col) {
-            QVariant value = make_cell_value(row, col);
+        if (write_only) {
+            QList<QVariant> values;
+            values.reserve(col_count);
+            for (int col = 1; col <= col_count; ++col)
+                values.append(make_cell_value(row, col));
             if (use_style)
-                xlsx.write(row - current_sheet_row_start + 1, col, value, data_format);
+                xlsx.appendRow(values, data_format);
             else
-                xlsx.write(row - current_sheet_row_start + 1, col, value);
+                xlsx.appendRow(values);
+        } else {
+            // One typed call per row rather than one QVariant per cell;
+            // data_format is left invalid without use_style
+            for (int col = 1; col <= col_count; ++col)
+                row_values[col - 1] = make_typed_cell_value(row, col);
+            xlsx.writeRow(row - current_sheet_row_start + 1, 1, row_values, data_format);
         }
 
                // Progress + timestamp (yyyy-MM-dd hh:mm:ss.zzz)
@@ -175,7 +205,7 @@ int main(int argc, char *argv[])
         }
     }
 
-    if (!xlsx.saveAs(file_name)) {
+    if (write_only ? !xlsx.endWriteOnly() : !xlsx.saveAs(file_name)) {
         qCritical() << "[LargeData] failed to save file:" << file_name;
         return 1;
     }
@@ -5,6 +5,16 @@
 QT += core
 QT += gui-private
 
+# Worksheet parts are inflated incrementally with zlib (Qt's bundled copy,
+# or the system one when Qt was built against it)
+qtConfig(system-zlib) {
+    LIBS += -lz
+} else {
+    QT += zlib-private
+    DEFINES += QXLSX_HAVE_QT_ZLIB
+}
+DEFINES += QXLSX_HAVE_ZLIB
+
 # TODO: Define your C++ version. c++14, c++17, etc.
 CONFIG += c++11
 
@@ -58,12 +68,14 @@ $${QXLSX_HEADERPATH}xlsxabstractooxmlfile.h \
 $${QXLSX_HEADERPATH}xlsxabstractooxmlfile_p.h \
 $${QXLSX_HEADERPATH}xlsxabstractsheet.h \
 $${QXLSX_HEADERPATH}xlsxabstractsheet_p.h \
+$${QXLSX_HEADERPATH}xlsxarena_p.h \
 $${QXLSX_HEADERPATH}xlsxcell.h \
 $${QXLSX_HEADERPATH}xlsxcellformula.h \
 $${QXLSX_HEADERPATH}xlsxcellformula_p.h \
 $${QXLSX_HEADERPATH}xlsxcelllocation.h \
 $${QXLSX_HEADERPATH}xlsxcellrange.h \
 $${QXLSX_HEADERPATH}xlsxcellreference.h \
+$${QXLSX_HEADERPATH}xlsxcellvalue.h \
 $${QXLSX_HEADERPATH}xlsxcell_p.h \
 $${QXLSX_HEADERPATH}xlsxchart.h \
 $${QXLSX_HEADERPATH}xlsxchartsheet.h \
@@ -90,7 +102,10 @@ $${QXLSX_HEADERPATH}xlsxnumformatparser_p.h \
 $${QXLSX_HEADERPATH}xlsxrelationships_p.h \
 $${QXLSX_HEADERPATH}xlsxrichstring.h \
 $${QXLSX_HEADERPATH}xlsxrichstring_p.h \
+$${QXLSX_HEADERPATH}xlsxscan_p.h \
 $${QXLSX_HEADERPATH}xlsxsharedstrings_p.h \
+$${QXLSX_HEADERPATH}xlsxsheetdatareader_p.h \
+$${QXLSX_HEADERPATH}xlsxsheetdatawriter_p.h \
 $${QXLSX_HEADERPATH}xlsxsimpleooxmlfile_p.h \
 $${QXLSX_HEADERPATH}xlsxstyles_p.h \
 $${QXLSX_HEADERPATH}xlsxtheme_p.h \
@@ -128,7 +143,10 @@ $${QXLSX_SOURCEPATH}xlsxmediafile.cpp \
 $${QXLSX_SOURCEPATH}xlsxnumformatparser.cpp \
 $${QXLSX_SOURCEPATH}xlsxrelationships.cpp \
 $${QXLSX_SOURCEPATH}xlsxrichstring.cpp \
+$${QXLSX_SOURCEPATH}xlsxscan.cpp \
 $${QXLSX_SOURCEPATH}xlsxsharedstrings.cpp \
+$${QXLSX_SOURCEPATH}xlsxsheetdatareader.cpp \
+$${QXLSX_SOURCEPATH}xlsxsheetdatawriter.cpp \
 $${QXLSX_SOURCEPATH}xlsxsimpleooxmlfile.cpp \
 $${QXLSX_SOURCEPATH}xlsxstyles.cpp \
 $${QXLSX_SOURCEPATH}xlsxtheme.cpp \
@@ -0,0 +1,113 @@
+// xlsxarena_p.h
+
+#ifndef XLSXARENA_P_H
+#define XLSXARENA_P_H
+
+#include "xlsxglobal.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+QT_BEGIN_NAMESPACE_XLSX
+
+// Monotonic allocator: memory is handed out from large chunks and is only
+// released, all at once, when the arena is destroyed. Not thread safe.
+class Arena
+{
+public:
+    explicit Arena(size_t chunkSize = 256 * 1024)
+        : m_chunkSize(chunkSize)
+    {
+    }
+    Arena(const Arena &)            = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    void *allocate(size_t size, size_t align)
+    {
+        uintptr_t p = (reinterpret_cast<uintptr_t>(m_cur) + align - 1) & ~uintptr_t(align - 1);
+        if (!m_cur || p + size > reinterpret_cast<uintptr_t>(m_end)) {
+            // Big requests get a chunk of their own so the current one
+            // keeps its free space
+            if (size + align > m_chunkSize / 4) {
+                m_used += size;
+                return alignUp(newChunk(size + align), align);
+            }
+            m_cur = newChunk(m_chunkSize);
+            m_end = m_cur + m_chunkSize;
+            p     = reinterpret_cast<uintptr_t>(alignUp(m_cur, align));
+        }
+        m_cur = reinterpret_cast<char *>(p + size);
+        m_used += size;
+        return reinterpret_cast<void *>(p);
+    }
+
+    size_t bytesUsed() const { return m_used; }
+
+private:
+    static void *alignUp(char *p, size_t align)
+    {
+        return reinterpret_cast<void *>((reinterpret_cast<uintptr_t>(p) + align - 1) &
+                                        ~uintptr_t(align - 1));
+    }
+
+    char *newChunk(size_t size)
+    {
+        m_chunks.emplace_back(new char[size]);
+        return m_chunks.back().get();
+    }
+
+    std::vector<std::unique_ptr<char[]>> m_chunks;
+    char *m_cur        = nullptr;
+    char *m_end        = nullptr;
+    size_t m_chunkSize = 0;
+    size_t m_used      = 0;
+};
+
+// Standard allocator on top of an Arena. Every copy shares ownership of
+// the arena, so objects made with std::allocate_shared keep their memory
+// valid even after the owner that created the arena is gone.
+template<typename T>
+class ArenaAllocator
+{
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(std::shared_ptr<Arena> arena)
+        : m_arena(std::move(arena))
+    {
+    }
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other)
+        : m_arena(other.arena())
+    {
+    }
+
+    T *allocate(size_t n)
+    {
+        return static_cast<T *>(m_arena->allocate(n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T *, size_t) {}
+
+    const std::shared_ptr<Arena> &arena() const { return m_arena; }
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U> &other) const
+    {
+        return m_arena == other.arena();
+    }
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U> &other) const
+    {
+        return m_arena != other.arena();
+    }
+
+private:
+    std::shared_ptr<Arena> m_arena;
+};
+
+QT_END_NAMESPACE_XLSX
+
+#endif // XLSXARENA_P_H
@@ -0,0 +1,54 @@
+// xlsxcellvalue.h
+
+#ifndef QXLSX_XLSXCELLVALUE_H
+#define QXLSX_XLSXCELLVALUE_H
+
+#include "xlsxglobal.h"
+
+#include <QString>
+
+QT_BEGIN_NAMESPACE_XLSX
+
+// A plain value for Worksheet::writeRow(): a number, a string or nothing.
+// Unlike the QVariant given to write(), a string is stored as it is, never
+// taken for a formula, a hyperlink, a number or rich text.
+class CellValue
+{
+public:
+    enum Type { Blank, Number, String };
+
+    CellValue()
+        : m_type(Blank)
+        , m_number(0)
+    {
+    }
+    CellValue(double number)
+        : m_type(Number)
+        , m_number(number)
+    {
+    }
+    CellValue(int number)
+        : m_type(Number)
+        , m_number(number)
+    {
+    }
+    CellValue(const QString &string)
+        : m_type(String)
+        , m_number(0)
+        , m_string(string)
+    {
+    }
+
+    Type type() const { return m_type; }
+    double number() const { return m_number; }
+    const QString &string() const { return m_string; }
+
+private:
+    Type m_type;
+    double m_number;
+    QString m_string;
+};
+
+QT_END_NAMESPACE_XLSX
+
+#endif // QXLSX_XLSXCELLVALUE_H
@@ -13,6 +13,8 @@
 #include <QObject>
 #include <QVariant>
 
+#include <functional>
+
 QT_BEGIN_NAMESPACE_XLSX
 
 class Workbook;
@@ -30,13 +32,53 @@ class QXLSX_EXPORT Document : public QObject
     Q_DECLARE_PRIVATE(Document) // D-Pointer. Qt classes have a Q_DECLARE_PRIVATE
                                 // macro in the public class. The macro reads: qglobal.h
 public:
+    // How an existing document is read
+    struct LoadOptions {
+        // Parse worksheets on a thread pool once styles and shared strings
+        // are loaded, instead of one after the other
+        bool parallelSheets = false;
+        // Threads for parallelSheets; 0 uses QThread::idealThreadCount()
+        int maxThreads = 0;
+    };
+
+    // How a document is written by saveAs() and in write-only mode
+    struct SaveOptions {
+        enum Compression {
+            DefaultCompression, // zlib's default level
+            NoCompression,      // store the part as is
+            FastCompression,    // deflate at level 1
+            BestCompression     // deflate at level 9
+        };
+
+        Compression compression = DefaultCompression;
+        // Parts smaller than this many bytes are stored
+        int storeBelow = 0;
+        // Optional per-part choice, e.g. for "xl/worksheets/sheet1.xml", given
+        // the part's uncompressed size, or -1 for worksheets and shared
+        // strings, which are compressed while they are generated. Overrides
+        // the two above; it is called from the threads that generate them.
+        std::function<Compression(const QString &partName, qint64 size)> partCompression;
+    };
+
     explicit Document(QObject *parent = nullptr);
     Document(const QString &xlsxName, QObject *parent = nullptr);
+    Document(const QString &xlsxName, const LoadOptions &options, QObject *parent = nullptr);
     Document(QIODevice *device, QObject *parent = nullptr);
+    Document(QIODevice *device, const LoadOptions &options, QObject *parent = nullptr);
     ~Document();
 
     bool write(const CellReference &cell, const QVariant &value, const Format &format = Format());
     bool write(int row, int col, const QVariant &value, const Format &format = Format());
+    bool appendRow(const QList<QVariant> &values, const Format &format = Format());
+    bool writeRow(int row,
+                  int col,
+                  const CellValue *values,
+                  int count,
+                  const Format &format = Format());
+    bool writeRow(int row,
+                  int col,
+                  const QVector<CellValue> &values,
+                  const Format &format = Format());
 
     QVariant read(const CellReference &cell) const;
     QVariant read(int row, int col) const;
@@ -117,6 +159,13 @@ public:
     bool save() const;
     bool saveAs(const QString &xlsXname) const;
     bool saveAs(QIODevice *device) const;
+    bool saveAs(const QString &xlsXname, const SaveOptions &options) const;
+    bool saveAs(QIODevice *device, const SaveOptions &options) const;
+
+    bool beginWriteOnly(const QString &xlsxName, const SaveOptions &options = SaveOptions());
+    bool beginWriteOnly(QIODevice *device, const SaveOptions &options = SaveOptions());
+    bool endWriteOnly();
+    bool isWriteOnly() const;
 
     bool saveAsCsv(const QString mainCSVFileName) const;
 
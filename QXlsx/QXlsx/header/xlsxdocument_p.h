@@ -14,6 +14,8 @@
 
 QT_BEGIN_NAMESPACE_XLSX
 
+class ZipWriter;
+
 class DocumentPrivate
 {
     Q_DECLARE_PUBLIC(Document)
@@ -21,8 +23,15 @@ public:
     DocumentPrivate(Document *p);
     void init();
 
-    bool loadPackage(QIODevice *device);
-    bool savePackage(QIODevice *device) const;
+    bool loadPackage(QIODevice *device,
+                     const Document::LoadOptions &options = Document::LoadOptions());
+    bool savePackage(QIODevice *device,
+                     const Document::SaveOptions &options = Document::SaveOptions()) const;
+    bool writePackage(ZipWriter &zipWriter) const;
+
+    bool beginWriteOnly(std::unique_ptr<ZipWriter> zipWriter, const Document::SaveOptions &options);
+    bool streamSheet(Worksheet *sheet);
+    bool endSheetStream();
 
     bool saveCsv(const QString mainCSVFileName) const;
 
@@ -40,6 +49,12 @@ public:
 
     // Store the entire xlsx (zip) bytes so that even when opened with QIODevice, the zip can be reopened in SAX
     std::shared_ptr<QByteArray> package_bytes;
+
+    // Write-only mode: the package being written, and the sheet whose rows
+    // currently go into it
+    std::unique_ptr<ZipWriter> writeOnlyZip;
+    Worksheet *streamingSheet = nullptr;
+    bool writeOnly            = false; // stays set once the package is done
 };
 
 QT_END_NAMESPACE_XLSX
@@ -4,12 +4,63 @@
 
 #include "xlsxformat.h"
 
+#include <QHash>
 #include <QMap>
 #include <QSet>
 #include <QSharedData>
+#include <QStringList>
+#include <QVariant>
+#include <QVector>
 
 QT_BEGIN_NAMESPACE_XLSX
 
+// The properties of a format, or of one group of them, reduced to plain
+// values. It hashes to 64 bits once, when built, and compares field by
+// field, so Styles can look formats up without serializing them.
+class FormatKey
+{
+public:
+    void addProperty(int id, const QVariant &value);
+
+    quint64 hash() const { return m_hash; }
+
+    bool operator==(const FormatKey &other) const
+    {
+        return m_hash == other.m_hash && m_fields == other.m_fields &&
+               m_strings == other.m_strings;
+    }
+    bool operator!=(const FormatKey &other) const { return !(*this == other); }
+
+private:
+    struct Field {
+        int id;
+        int type;     // QMetaType id of the value
+        qint64 value; // the number, the bits of a double, or an index into m_strings
+
+        bool operator==(const Field &other) const
+        {
+            return id == other.id && type == other.type && value == other.value;
+        }
+    };
+
+    qint64 addString(const QString &string);
+    void addField(int id, int type, qint64 value);
+    void mix(quint64 word);
+
+    QVector<Field> m_fields;
+    QStringList m_strings;
+    quint64 m_hash = Q_UINT64_C(0xcbf29ce484222325);
+};
+
+#if QT_VERSION >= 0x060000 // Qt 6.0 or over
+inline size_t qHash(const FormatKey &key, size_t seed = 0) Q_DECL_NOTHROW
+#else
+inline uint qHash(const FormatKey &key, uint seed = 0) Q_DECL_NOTHROW
+#endif
+{
+    return decltype(seed)(key.hash() ^ (key.hash() >> 32)) ^ seed;
+}
+
 class FormatPrivate : public QSharedData
 {
 public:
@@ -88,10 +139,16 @@ public:
         P_ENDID
     };
 
+    // What Styles deduplicates by: all the properties, or those of the
+    // font, fill or border
+    enum KeyGroup { XfKey, FontKey, FillKey, BorderKey, KeyGroupCount };
+
     FormatPrivate();
     FormatPrivate(const FormatPrivate &other);
     ~FormatPrivate();
 
+    const FormatKey &key(KeyGroup group);
+
     bool dirty; // The key re-generation is need.
     QByteArray formatKey;
 
@@ -120,6 +177,9 @@ public:
     int theme;
 
     QMap<int, QVariant> properties;
+
+    bool keys_dirty; // All of keys are rebuilt when a property changes
+    FormatKey keys[KeyGroupCount];
 };
 
 QT_END_NAMESPACE_XLSX
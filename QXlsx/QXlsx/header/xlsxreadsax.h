@@ -1,6 +1,7 @@
 #ifndef XLSXREADSAX_H
 #define XLSXREADSAX_H
 
+#include <QIODevice>
 #include <QXmlStreamReader>
 #include <QString>
 #include <QVariant>
@@ -13,6 +14,7 @@ struct sax_options
     bool resolve_shared_strings = true;
     bool read_formulas_as_text = false;
     bool stop_on_empty_sheetdata = false;
+    int max_row = 0;     // stop once past this row (0 = read the whole sheet)
 };
 
 struct sax_cell
@@ -35,6 +37,26 @@ bool read_sheet_xml_sax(const QByteArray& sheet_xml,
                         const QStringList* shared_strings, // nullptr 가능
                         const sax_cell_callback& on_cell);
 
+// Same, reading the sheet XML from a device as the parser needs it
+bool read_sheet_xml_sax(QIODevice* sheet_xml,
+                        const sax_options& opt,
+                        const QStringList* shared_strings,
+                        const sax_cell_callback& on_cell);
+
+// Stream one sheet straight from an .xlsx package, without building a Document.
+// Only _rels/.rels, the workbook part and its rels are read to locate the sheet,
+// and sharedStrings.xml is only parsed as far as the cells read so far need,
+// so peeking at a header row (opt.max_row = 1) stays cheap.
+bool read_xlsx_sheet_sax(QIODevice* device,
+                         int sheet_index,
+                         const sax_options& opt,
+                         const sax_cell_callback& on_cell);
+
+bool read_xlsx_sheet_sax(const QString& xlsx_path,
+                         int sheet_index,
+                         const sax_options& opt,
+                         const sax_cell_callback& on_cell);
+
 } // namespace QXlsx
 
 #endif // XLSXREADSAX_H
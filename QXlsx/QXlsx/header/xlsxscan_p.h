@@ -0,0 +1,45 @@
+// xlsxscan_p.h
+
+#ifndef XLSXSCAN_P_H
+#define XLSXSCAN_P_H
+
+#include "xlsxglobal.h"
+
+#include <QString>
+
+#include <vector>
+
+QT_BEGIN_NAMESPACE_XLSX
+
+// Byte scanning kernels for the XML readers: finding tag boundaries,
+// attribute quotes and entities, and validating UTF-8. Each kernel set
+// works on [p, end) and returns end when nothing is found.
+namespace Scan {
+
+struct Kernels {
+    const char *name;
+
+    // First byte equal to a
+    const char *(*findByte)(const char *p, const char *end, char a);
+    // First byte equal to a or b
+    const char *(*findEither)(const char *p, const char *end, char a, char b);
+    // Whether the bytes are well-formed UTF-8
+    bool (*isValidUtf8)(const char *p, const char *end);
+};
+
+// The fastest kernels this CPU supports, picked on first use
+QXLSX_EXPORT const Kernels &kernels();
+
+// Every kernel set usable on this CPU, scalar first; for benchmarking
+QXLSX_EXPORT std::vector<const Kernels *> availableKernels();
+
+// Converts XML character data to a QString, resolving the predefined and
+// numeric entities and normalizing line ends as an XML parser would.
+// Returns false for anything else, e.g. an entity declared in a DTD.
+QXLSX_EXPORT bool decodeText(const char *begin, const char *end, QString *out);
+
+} // namespace Scan
+
+QT_END_NAMESPACE_XLSX
+
+#endif // XLSXSCAN_P_H
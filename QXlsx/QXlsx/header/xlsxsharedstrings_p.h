@@ -42,6 +42,7 @@
 
 #include <QHash>
 #include <QIODevice>
+#include <QMutex>
 #include <QStringList>
 #include <QXmlStreamReader>
 #include <QXmlStreamWriter>
@@ -73,6 +74,7 @@ public:
     void removeSharedString(const QString &string);
     void removeSharedString(const RichString &string);
     void incRefByStringIndex(int idx);
+    void incRefByStringIndex(int idx, int count);
 
     int getSharedStringIndex(const QString &string) const;
     int getSharedStringIndex(const RichString &string) const;
@@ -92,6 +94,10 @@ private:
     QHash<RichString, XlsxSharedStringInfo> m_stringTable; // for fast lookup
     QList<RichString> m_stringList;
     int m_stringCount;
+
+    // incRefByStringIndex() is called from the threads of a parallel load;
+    // lookups only read the string list, which is complete by then
+    QMutex m_refMutex;
 };
 
 QT_END_NAMESPACE_XLSX
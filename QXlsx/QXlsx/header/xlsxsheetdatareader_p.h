@@ -0,0 +1,176 @@
+// xlsxsheetdatareader_p.h
+
+#ifndef XLSXSHEETDATAREADER_P_H
+#define XLSXSHEETDATAREADER_P_H
+
+#include "xlsxcell.h"
+#include "xlsxglobal.h"
+
+#include <QByteArray>
+#include <QChar>
+#include <QIODevice>
+#include <QString>
+
+#include <vector>
+
+QT_BEGIN_NAMESPACE_XLSX
+
+class WorksheetPrivate;
+
+namespace Scan {
+struct Kernels;
+}
+
+namespace SheetDataText {
+inline int codeUnit(char c)
+{
+    return uchar(c);
+}
+inline int codeUnit(QChar c)
+{
+    return c.unicode();
+}
+} // namespace SheetDataText
+
+// Whether text is a plain decimal such as "12", "-0.5" or "1234.25" that
+// QString::number(value, 'g', 15) gives back unchanged: no exponent, no
+// redundant zeros, at most 15 significant digits, and neither so small
+// nor so large that 'g' would switch to scientific notation.
+template<typename Char>
+bool isPlainDecimal(const Char *text, int size)
+{
+    using SheetDataText::codeUnit;
+
+    int i = 0;
+    if (i < size && codeUnit(text[i]) == '-')
+        ++i;
+    const int intBegin = i;
+    while (i < size && codeUnit(text[i]) >= '0' && codeUnit(text[i]) <= '9')
+        ++i;
+    const int intDigits = i - intBegin;
+    if (intDigits == 0 || (intDigits > 1 && codeUnit(text[intBegin]) == '0'))
+        return false;
+
+    int fracDigits = 0;
+    int fracZeros  = 0; // zeros right after the point
+    if (i < size && codeUnit(text[i]) == '.') {
+        ++i;
+        const int fracBegin = i;
+        while (i < size && codeUnit(text[i]) >= '0' && codeUnit(text[i]) <= '9')
+            ++i;
+        fracDigits = i - fracBegin;
+        if (fracDigits == 0 || codeUnit(text[i - 1]) == '0')
+            return false;
+        while (fracZeros < fracDigits && codeUnit(text[fracBegin + fracZeros]) == '0')
+            ++fracZeros;
+    }
+    if (i != size)
+        return false;
+
+    if (codeUnit(text[intBegin]) != '0')
+        return intDigits + fracDigits <= 15;
+    if (fracDigits == 0)
+        return intBegin == 0; // "0", but not "-0"
+    return fracZeros <= 3 && fracDigits - fracZeros <= 15;
+}
+
+// Reads the content of a worksheet's <sheetData> element straight from
+// its UTF-8 bytes, without QXmlStreamReader, and stores rows and cells in
+// the sheet the same way WorksheetPrivate::loadXmlSheetData() does.
+class SheetDataReader
+{
+public:
+    // Byte offsets of <sheetData> in a worksheet part
+    struct Location {
+        int elementBegin = 0;
+        int contentBegin = 0;
+        int contentEnd   = 0;
+        int elementEnd   = 0;
+    };
+
+    explicit SheetDataReader(WorksheetPrivate *sheet);
+
+    // Finds a <sheetData> element with content; false if there is none
+    static bool locate(const QByteArray &xml, Location *location);
+
+    // Reads [begin, end), the bytes between <sheetData> and </sheetData>.
+    // Returns false if the data uses XML this reader does not handle
+    // (namespace prefixes, CDATA, unknown entities); the sheet may then
+    // hold part of the data and must be cleared before falling back.
+    bool read(const char *begin, const char *end);
+
+    enum StreamResult {
+        StreamLoaded,     // cell data read; *xml holds the part without it
+        StreamNoData,     // no <sheetData> content; *xml holds the whole part
+        StreamUnsupported // as read() returning false; *xml is not set
+    };
+
+    // Reads a worksheet part from device, passing <sheetData> to the
+    // parser a few complete rows at a time so only a small window of the
+    // part is in memory. The rest of the part is returned in *xml with an
+    // empty <sheetData/> in place of the cell data.
+    StreamResult readStream(QIODevice *device, QByteArray *xml);
+
+    // The last row and column read. The part's <dimension> comes before
+    // <sheetData> but is loaded after it, so the caller extends the
+    // dimension with these once the rest of the part has been read.
+    int lastRow() const { return m_row; }
+    int lastColumn() const { return m_col; }
+
+private:
+    struct Span {
+        Span() = default;
+        Span(const char *b, const char *e)
+            : begin(b)
+            , end(e)
+        {
+        }
+
+        const char *begin = nullptr;
+        const char *end   = nullptr;
+
+        bool isNull() const { return !begin; }
+        int size() const { return int(end - begin); }
+        bool operator==(const char *latin1) const;
+    };
+
+    void reset();
+    bool feed(const char *begin, const char *end);
+    void finish();
+
+    bool readRow();
+    bool readCell();
+    bool readInlineString(QString *text, bool *found);
+
+    bool skipToTag();
+    bool readStartTag(Span *name, bool *isEnd);
+    template<typename F>
+    bool readAttributes(F onAttribute, bool *selfClosing);
+    bool skipAttributes(bool *selfClosing);
+    bool readText(Span *text);
+    bool readEndTag(const char *name);
+    bool skipElement(bool selfClosing);
+
+    void countSharedString(int index);
+    bool isDateStyle(int styleIndex);
+    bool decode(const Span &text, QString *out) const;
+
+    static int toInt(const Span &span);
+    static double toDouble(const Span &span);
+
+    WorksheetPrivate *m_sheet;
+    const Scan::Kernels &m_scan;
+    const char *m_p   = nullptr;
+    const char *m_end = nullptr;
+    bool m_error      = false;
+
+    int m_row = 0;
+    int m_col = 0;
+
+    std::vector<int> m_sharedStringRefs; // per shared string index
+    std::vector<qint8> m_dateStyles;     // per style: -1 unknown, 0 or 1
+};
+
+QT_END_NAMESPACE_XLSX
+
+#endif // XLSXSHEETDATAREADER_P_H
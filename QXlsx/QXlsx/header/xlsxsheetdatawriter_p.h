@@ -0,0 +1,65 @@
+// xlsxsheetdatawriter_p.h
+
+#ifndef XLSXSHEETDATAWRITER_P_H
+#define XLSXSHEETDATAWRITER_P_H
+
+#include "xlsxglobal.h"
+
+#include <QByteArray>
+#include <QString>
+
+class QIODevice;
+class QXmlStreamWriter;
+
+QT_BEGIN_NAMESPACE_XLSX
+
+// Writes the rows and cells of a worksheet's <sheetData> element as UTF-8
+// bytes, straight into the device of a QXmlStreamWriter. Markup is copied
+// from literals, numbers and cell references are formatted in place, and
+// text is only escaped when a scan finds something to escape. Content this
+// doesn't cover, such as formulas, is written with xmlWriter(); the two can
+// be interleaved as long as each leaves complete elements behind.
+class SheetDataWriter
+{
+public:
+    // Ends a start tag writer may have left open, e.g. <sheetData>
+    explicit SheetDataWriter(QXmlStreamWriter &writer);
+    ~SheetDataWriter();
+
+    template<int N>
+    void append(const char (&literal)[N])
+    {
+        append(literal, N - 1);
+    }
+    void append(const char *data, int size);
+
+    void appendInteger(qint64 value);
+    // Like QString::number(value, 'g', 15), but with as many digits as it
+    // takes for the value to be read back unchanged
+    void appendNumber(double value);
+    // "A1" style, e.g. "XFD1048576"
+    void appendCellReference(int row, int column);
+    // Element text, with <, >, &, " and carriage returns escaped and
+    // characters XML doesn't allow dropped
+    void appendEscaped(const QString &text);
+
+    // Writes out what is buffered and returns the XML writer, to write
+    // content the slow way
+    QXmlStreamWriter &xmlWriter();
+    void flush();
+    // Whether writing to the device failed
+    bool hasError() const;
+
+private:
+    Q_DISABLE_COPY(SheetDataWriter)
+
+    QXmlStreamWriter &m_writer;
+    QIODevice *m_device;
+    QByteArray m_buffer;
+    int m_size   = 0;
+    bool m_error = false;
+};
+
+QT_END_NAMESPACE_XLSX
+
+#endif // XLSXSHEETDATAWRITER_P_H
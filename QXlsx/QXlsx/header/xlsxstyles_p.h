@@ -51,6 +51,7 @@
 
 #include "xlsxabstractooxmlfile.h"
 #include "xlsxformat.h"
+#include "xlsxformat_p.h"
 #include "xlsxglobal.h"
 
 QT_BEGIN_NAMESPACE_XLSX
@@ -88,6 +89,8 @@ private:
     // friend class ::StylesTest;
 
     void fixNumFmt(const Format &format);
+    // The key format is deduplicated by; empty formats all share one
+    static const FormatKey &key(const Format &format, FormatPrivate::KeyGroup group);
 
     void writeNumFmts(QXmlStreamWriter &writer) const;
     void writeFonts(QXmlStreamWriter &writer) const;
@@ -131,18 +134,18 @@ private:
     QList<Format> m_fontsList;
     QList<Format> m_fillsList;
     QList<Format> m_bordersList;
-    QHash<QByteArray, Format> m_fontsHash;
-    QHash<QByteArray, Format> m_fillsHash;
-    QHash<QByteArray, Format> m_bordersHash;
+    QHash<FormatKey, Format> m_fontsHash;
+    QHash<FormatKey, Format> m_fillsHash;
+    QHash<FormatKey, Format> m_bordersHash;
 
     QVector<QColor> m_indexedColors;
     bool m_isIndexedColorsDefault;
 
     QList<Format> m_xf_formatsList;
-    QHash<QByteArray, Format> m_xf_formatsHash;
+    QHash<FormatKey, Format> m_xf_formatsHash;
 
     QList<Format> m_dxf_formatsList;
-    QHash<QByteArray, Format> m_dxf_formatsHash;
+    QHash<FormatKey, Format> m_dxf_formatsHash;
 
     bool m_emptyFormatAdded;
 };
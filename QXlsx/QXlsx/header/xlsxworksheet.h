@@ -8,6 +8,7 @@
 #include "xlsxcelllocation.h"
 #include "xlsxcellrange.h"
 #include "xlsxcellreference.h"
+#include "xlsxcellvalue.h"
 
 #include <QDateTime>
 #include <QIODevice>
@@ -54,6 +55,16 @@ public:
                const QVariant &value,
                const Format &format = Format());
     bool write(int row, int column, const QVariant &value, const Format &format = Format());
+    bool appendRow(const QList<QVariant> &values, const Format &format = Format());
+    bool writeRow(int row,
+                  int column,
+                  const CellValue *values,
+                  int count,
+                  const Format &format = Format());
+    bool writeRow(int row,
+                  int column,
+                  const QVector<CellValue> &values,
+                  const Format &format = Format());
 
     QVariant read(const CellReference &row_column) const;
     QVariant read(int row, int column) const;
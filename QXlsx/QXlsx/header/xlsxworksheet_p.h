@@ -4,6 +4,7 @@
 #define XLSXWORKSHEET_P_H
 
 #include "xlsxabstractsheet_p.h"
+#include "xlsxarena_p.h"
 #include "xlsxcell.h"
 #include "xlsxcellformula.h"
 #include "xlsxconditionalformatting.h"
@@ -17,12 +18,18 @@
 #include <QString>
 #include <QVector>
 
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+class QIODevice;
 class QXmlStreamWriter;
 class QXmlStreamReader;
 
 QT_BEGIN_NAMESPACE_XLSX
 
 class SharedStrings;
+class SheetDataWriter;
 
 struct XlsxHyperlinkData {
     enum LinkType { External, Internal };
@@ -132,54 +139,249 @@ struct XlsxColumnInfo {
     bool collapsed;
 };
 
+// A cell as stored in its row. Plain values read from a file - numbers,
+// booleans, shared strings, blanks and the standard error codes - are kept
+// inline in 16 bytes; anything else (formulas, inline or rich text, cells
+// written through the API) lives in a full Cell held by the table, and
+// index refers to it.
+struct CompactCell
+{
+    enum Kind : quint8 {
+        Blank,
+        Number,
+        SharedString, // index into the workbook's shared strings
+        Boolean,
+        Error,        // index into the error code table
+        Full,         // index into CellTable's out-of-line cells
+    };
+
+    union {
+        double number;
+        qint32 index;
+        bool boolean;
+    };
+    qint32 styleIndex;
+    quint16 column;
+    Kind kind;
+    quint8 cellType; // Cell::CellType
+
+    static QString errorCode(int index);
+    static int errorCodeIndex(const QString &text);
+    static int errorCodeIndex(const char *text, int size);
+};
+static_assert(sizeof(CompactCell) == 16, "CompactCell is meant to fit in 16 bytes");
+
+// Row-major cell storage: rows are grouped in blocks of RowsPerBlock, and
+// each row keeps its cells in a vector sorted by column. Walking rows and
+// their cells in order needs no sorting, and a plain cell costs one 16-byte
+// slot instead of two hash nodes and a Cell.
 class CellTable
 {
 public:
-    static QList<int> sorteIntList(QList<int> &&keys)
+    static constexpr int RowsPerBlock = 256;
+
+    using Entry = CompactCell;
+    using Row   = std::vector<Entry>; // sorted by column
+
+    QList<int> sortedRows() const
     {
-        std::sort(keys.begin(), keys.end());
-        return keys;
+        QList<int> rows;
+        forEachRow([&rows](int row, const Row &) { rows.append(row); });
+        return rows;
     }
 
-    inline QList<int> sortedRows() const
+    void setValue(int row, int column, const std::shared_ptr<Cell> &cell)
     {
-        QList<int> keys = cells.keys();
-        std::sort(keys.begin(), keys.end());
-        return keys;
+        Entry *entry = insert(row, column);
+        if (!entry)
+            return;
+        if (entry->kind != CompactCell::Full) {
+            entry->kind  = CompactCell::Full;
+            entry->index = addFullCell(cell);
+        } else {
+            fullCells[size_t(entry->index)] = cell;
+        }
+        entry->styleIndex = cell ? cell->styleNumber() : -1;
+        entry->cellType   = quint8(cell ? cell->cellType() : Cell::CustomType);
     }
 
-    void setValue(int row, int column, const std::shared_ptr<Cell> &cell)
+    void setCompact(int row, int column, const CompactCell &cell)
+    {
+        Q_ASSERT(cell.kind != CompactCell::Full);
+        Entry *entry = insert(row, column);
+        if (!entry)
+            return;
+        if (entry->kind == CompactCell::Full)
+            releaseFullCell(entry->index);
+        *entry        = cell;
+        entry->column = quint16(column);
+    }
+
+    const Entry *find(int row, int column) const
     {
-        cells[row].insert(column, cell);
-        firstRow    = qMin(firstRow, row);
-        firstColumn = qMin(firstColumn, column);
-        lastRow     = qMin(lastRow, row);
-        lastColumn  = qMin(lastColumn, column);
+        const Row *cells = findRow(row);
+        if (!cells)
+            return nullptr;
+        auto it = lowerBound(*cells, column);
+        if (it != cells->end() && it->column == column)
+            return &*it;
+        return nullptr;
     }
 
-    std::shared_ptr<Cell> cellAt(int row, int column) const
+    // The out-of-line cell of a Full entry
+    std::shared_ptr<Cell> fullCell(const Entry &entry) const
     {
-        return cells.value(row).value(column);
+        Q_ASSERT(entry.kind == CompactCell::Full);
+        return fullCells[size_t(entry.index)];
     }
 
-    bool contains(int row, int column) const
+    bool contains(int row, int column) const { return find(row, column) != nullptr; }
+
+    // Makes room for a row's cells up front, e.g. from its spans attribute
+    void reserveRow(int row, int columns)
     {
-        auto it = cells.find(row);
-        if (it != cells.end()) {
-            return it->contains(column);
+        if (row >= 0 && columns > 0)
+            rowAt(row).reserve(size_t(columns));
+    }
+
+    // The cells of a row in column order, or nullptr if the row has none
+    const Row *findRow(int row) const
+    {
+        if (row < 0)
+            return nullptr;
+        const size_t block = size_t(row) / RowsPerBlock;
+        if (block >= blocks.size() || blocks[block].empty())
+            return nullptr;
+        const Row &cells = blocks[block][size_t(row) % RowsPerBlock];
+        return cells.empty() ? nullptr : &cells;
+    }
+
+    // Calls f(row, cells) for every non-empty row, in row order
+    template<typename F>
+    void forEachRow(F f) const
+    {
+        for (size_t block = 0; block < blocks.size(); ++block) {
+            const std::vector<Row> &rows = blocks[block];
+            for (size_t i = 0; i < rows.size(); ++i) {
+                if (!rows[i].empty())
+                    f(int(block * RowsPerBlock + i), rows[i]);
+            }
         }
-        return false;
     }
 
-    bool isEmpty() const { return cells.isEmpty(); }
+    // Drops the cells of a row. A block's storage goes with its last row,
+    // and the full cells once the table is empty, so a table that rows pass
+    // through (write-only sheets) stays small.
+    void removeRow(int row)
+    {
+        const size_t block = size_t(row) / RowsPerBlock;
+        if (row < 0 || block >= blocks.size() || blocks[block].empty())
+            return;
+        Row &cells = blocks[block][size_t(row) % RowsPerBlock];
+        for (const Entry &entry : cells) {
+            if (entry.kind == CompactCell::Full)
+                releaseFullCell(entry.index);
+        }
+        cellCount -= int(cells.size());
+        Row().swap(cells);
+
+        if (row % RowsPerBlock == RowsPerBlock - 1) {
+            const std::vector<Row> &rows = blocks[block];
+            if (std::all_of(rows.begin(), rows.end(), [](const Row &r) { return r.empty(); }))
+                std::vector<Row>().swap(blocks[block]);
+        }
+        if (cellCount == 0) {
+            fullCells.clear();
+            freeFullCells.clear();
+        }
+    }
+
+    bool isEmpty() const { return cellCount == 0; }
+    int count() const { return cellCount; }
 
-    // It's faster with a single QHash, but in Qt5 it's capacity limits
-    // how much cells we can hold
-    QHash<int, QHash<int, std::shared_ptr<Cell>>> cells;
     int firstRow    = -1;
     int firstColumn = -1;
     int lastRow     = -1;
     int lastColumn  = -1;
+
+private:
+    template<typename R>
+    static auto lowerBound(R &cells, int column) -> decltype(cells.begin())
+    {
+        // Cells mostly arrive left to right, so check the end first
+        if (cells.empty() || cells.back().column < column)
+            return cells.end();
+        return std::lower_bound(cells.begin(), cells.end(), column,
+                                [](const Entry &e, int c) { return e.column < c; });
+    }
+
+    // Returns the entry for (row, column), adding a blank one if needed;
+    // nullptr if the position cannot be stored
+    Entry *insert(int row, int column)
+    {
+        if (row < 0 || column < 0 || column > 0xFFFF)
+            return nullptr;
+
+        Row &cells = rowAt(row);
+        auto it    = lowerBound(cells, column);
+        if (it != cells.end() && it->column == column)
+            return &*it;
+
+        Entry entry;
+        entry.index      = 0;
+        entry.styleIndex = -1;
+        entry.column     = quint16(column);
+        entry.kind       = CompactCell::Blank;
+        entry.cellType   = quint8(Cell::CustomType);
+        it               = cells.insert(it, entry);
+
+        if (cellCount++ == 0) {
+            firstRow = lastRow = row;
+            firstColumn = lastColumn = column;
+        } else {
+            firstRow    = qMin(firstRow, row);
+            firstColumn = qMin(firstColumn, column);
+            lastRow     = qMax(lastRow, row);
+            lastColumn  = qMax(lastColumn, column);
+        }
+        return &*it;
+    }
+
+    // Slots of cells that went back to compact form are reused, so a cell
+    // rewritten over and over doesn't grow fullCells
+    qint32 addFullCell(const std::shared_ptr<Cell> &cell)
+    {
+        if (freeFullCells.empty()) {
+            fullCells.push_back(cell);
+            return qint32(fullCells.size() - 1);
+        }
+        const qint32 index = freeFullCells.back();
+        freeFullCells.pop_back();
+        fullCells[size_t(index)] = cell;
+        return index;
+    }
+
+    void releaseFullCell(qint32 index)
+    {
+        fullCells[size_t(index)].reset();
+        freeFullCells.push_back(index);
+    }
+
+    Row &rowAt(int row)
+    {
+        const size_t block = size_t(row) / RowsPerBlock;
+        if (block >= blocks.size())
+            blocks.resize(block + 1);
+        if (blocks[block].empty())
+            blocks[block].resize(RowsPerBlock);
+        return blocks[block][size_t(row) % RowsPerBlock];
+    }
+
+    // Allocated lazily: an empty vector stands for a block without cells
+    std::vector<std::vector<Row>> blocks;
+    std::vector<std::shared_ptr<Cell>> fullCells;
+    std::vector<qint32> freeFullCells; // released slots of fullCells
+    int cellCount = 0;
 };
 
 class WorksheetPrivate : public AbstractSheetPrivate
@@ -193,16 +395,24 @@ public:
 public:
     int checkDimensions(int row, int col, bool ignore_row = false, bool ignore_col = false);
     Format cellFormat(int row, int col) const;
+    std::shared_ptr<Cell> cellAt(int row, int col) const;
+    std::shared_ptr<Cell> mutableCellAt(int row, int col);
+    std::shared_ptr<Cell> materializeCell(const CompactCell &cell) const;
     QString generateDimensionString() const;
-    void calculateSpans() const;
+    bool calculateSpan(int block, int *first, int *last) const;
     void splitColsInfo(int colFirst, int colLast);
     void validateDimension();
 
+    void saveXmlSheetHead(QXmlStreamWriter &writer, bool withDimension) const;
+    void saveXmlSheetTail(QXmlStreamWriter &writer) const;
     void saveXmlSheetData(QXmlStreamWriter &writer) const;
-    void saveXmlCellData(QXmlStreamWriter &writer,
+    void saveXmlRow(SheetDataWriter &out, int row, int spanFirst, int spanLast) const;
+    void saveXmlCellData(SheetDataWriter &out,
                          int row,
                          int col,
                          std::shared_ptr<Cell> cell) const;
+    bool saveXmlCompactCellData(SheetDataWriter &out, int row, const CompactCell &cell) const;
+    void saveXmlCellStyle(SheetDataWriter &out, int row, int col, const Format &format) const;
     void saveXmlMergeCells(QXmlStreamWriter &writer) const;
     void saveXmlHyperlinks(QXmlStreamWriter &writer) const;
     void saveXmlDrawings(QXmlStreamWriter &writer) const;
@@ -212,6 +422,13 @@ public:
     int colPixelsSize(int col) const;
 
     void loadXmlSheetData(QXmlStreamReader &reader);
+    void storeLoadedCell(int row,
+                         int col,
+                         Cell::CellType cellType,
+                         qint32 styleIndex,
+                         const CellFormula &formula,
+                         const QString *value,
+                         const QString *inlineText);
     void loadXmlColumnsInfo(QXmlStreamReader &reader);
     void loadXmlMergeCells(QXmlStreamReader &reader);
     void loadXmlDataValidations(QXmlStreamReader &reader);
@@ -226,8 +443,15 @@ public:
 
     SharedStrings *sharedStrings() const;
 
+    void beginStream(std::unique_ptr<QIODevice> device, const QString &path);
+    bool streamRows(int lastRow);
+    bool endStream();
+
 public:
     CellTable cellTable;
+    // Full cells and row info created while loading; shared with every
+    // such object so it lives as long as the last of them
+    std::shared_ptr<Arena> loadArena;
 
     QHash<int, QHash<int, QString>> comments;
     QHash<int, QHash<int, std::shared_ptr<XlsxHyperlinkData>>> urlTable;
@@ -243,7 +467,6 @@ public:
 
     CellRange dimension;
 
-    mutable QHash<int, QString> row_spans;
     QHash<int, double> row_sizes;
     QHash<int, double> col_sizes;
 
@@ -286,6 +509,16 @@ public:
 
     QRegularExpression urlPattern;
 
+    int appendedRow = 0; // last row written by appendRow()
+
+    // Write-only mode, see Document::beginWriteOnly(): rows go to the
+    // part's archive entry as soon as appendRow() moves past them
+    std::unique_ptr<QIODevice> streamDevice;
+    std::unique_ptr<QXmlStreamWriter> streamWriter;
+    std::unique_ptr<SheetDataWriter> streamOut; // rows, into streamWriter's device
+    QString streamPath; // the part streamed to; stays set once it's done
+    int streamedRows = 0;
+
 private:
     static double calculateColWidth(int characters);
 };
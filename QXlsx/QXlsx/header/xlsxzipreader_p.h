@@ -5,12 +5,17 @@
 
 #include "xlsxglobal.h"
 
+#include <QHash>
 #include <QIODevice>
+#include <QMutex>
 #include <QScopedPointer>
 #include <QStringList>
 #include <QVector>
 
+#include <memory>
+
 class QZipReader;
+class QFile;
 
 QT_BEGIN_NAMESPACE_XLSX
 
@@ -24,11 +29,38 @@ public:
     QStringList filePaths() const;
     QByteArray fileData(const QString &fileName) const;
 
+    // Opens a part for reading. Deflated parts are inflated a
+    // block at a time as the device is read, so a large worksheet is never
+    // held in memory as a whole. Falls back to a QBuffer over fileData()
+    // when the entry can't be streamed (Zip64, no zlib). Returns nullptr if
+    // there is no such part. The device reads from the archive and must not
+    // outlive this reader; devices of one reader may be read from different
+    // threads.
+    std::unique_ptr<QIODevice> openFile(const QString &fileName) const;
+
 private:
     Q_DISABLE_COPY(ZipReader)
+
+    // Entry of the central directory
+    struct Entry {
+        quint16 method           = 0;
+        quint32 crc              = 0;
+        qint64 compressedSize    = 0;
+        qint64 size              = 0;
+        qint64 localHeaderOffset = 0;
+    };
+
     void init();
+    bool readDirectory() const;
+
+    QScopedPointer<QFile> m_file;
+    QIODevice *m_device = nullptr;
     QScopedPointer<QZipReader> m_reader;
     QStringList m_filePaths;
+
+    mutable QHash<QString, Entry> m_entries;
+    mutable bool m_directoryRead = false;
+    mutable QMutex m_deviceMutex; // for openFile() devices
 };
 
 QT_END_NAMESPACE_XLSX
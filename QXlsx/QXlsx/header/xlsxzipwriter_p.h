@@ -6,8 +6,14 @@
 #include "xlsxglobal.h"
 
 #include <QIODevice>
+#include <QScopedPointer>
 #include <QString>
+#include <QVector>
 
+#include <functional>
+#include <memory>
+
+class QFile;
 class QZipWriter;
 
 QT_BEGIN_NAMESPACE_XLSX
@@ -15,17 +21,88 @@ QT_BEGIN_NAMESPACE_XLSX
 class ZipWriter
 {
 public:
+    // A part compressed ahead of writing, so that deflating can run on other
+    // threads while the parts are appended to the archive in order
+    struct Entry {
+        QByteArray data;    // deflated or stored bytes; the part itself without zlib
+        quint16 method = 0; // 0 stored, 8 deflated (to be, without zlib)
+        quint32 crc    = 0;
+        qint64 size    = 0; // uncompressed size
+    };
+
+    // zlib level for a part given its path and size: 0 stores it, 1 (fastest)
+    // to 9 (smallest), -1 zlib's default
+    using LevelFunction = std::function<int(const QString &filePath, qint64 size)>;
+
     explicit ZipWriter(const QString &filePath);
     explicit ZipWriter(QIODevice *device);
     ~ZipWriter();
 
     void addFile(const QString &filePath, QIODevice *device);
     void addFile(const QString &filePath, const QByteArray &data);
+    void addEntry(const QString &filePath, const Entry &entry);
+    // Opens an entry whose data is written through the returned device and
+    // compressed as it comes in, at compressionLevel(filePath, -1). The entry
+    // is complete once the device is closed; close() closes it if need be.
+    // Nothing else can be added meanwhile, and the device must not outlive
+    // the writer. A stored entry on a sequential device is held in memory
+    // until it is closed, as its header has to come with the sizes.
+    std::unique_ptr<QIODevice> openEntry(const QString &filePath);
     bool error() const;
     void close();
 
+    // Sets the level addFile() compresses parts with; without zlib only
+    // stored and deflated at QZipWriter's level are told apart
+    void setCompressionLevel(int level);
+    void setCompressionLevel(const LevelFunction &level);
+    // May be called from any thread, as long as the level isn't being set
+    int compressionLevel(const QString &filePath, qint64 size) const;
+
+    // Deflates data at the given level, or stores it if that doesn't make it
+    // smaller. Touches no writer state, so it may be called from any thread.
+    static Entry compress(const QByteArray &data, int level = -1);
+    // Like compress(), for a part written to the returned device: it is
+    // compressed as it comes in, so only the compressed bytes are held.
+    // entry is filled in once the device is closed.
+    static std::unique_ptr<QIODevice> compressTo(Entry *entry, int level = -1);
+
 private:
+    Q_DISABLE_COPY(ZipWriter)
+
+    class EntryDevice;
+
+    LevelFunction m_level;
+    EntryDevice *m_openEntry = nullptr;
+
+#ifdef QXLSX_HAVE_ZLIB
+    // Central directory record of an entry already written
+    struct Record {
+        QByteArray name;
+        quint16 flags          = 0;
+        quint16 method         = 0;
+        quint32 crc            = 0;
+        quint32 compressedSize = 0;
+        quint32 size           = 0;
+        quint32 offset         = 0;
+    };
+
+    void writeLocalHeader(const Record &record);
+    // Fills in the CRC and sizes of the record's local header, written
+    // earlier on the (seekable) device
+    void patchLocalHeader(const Record &record);
+    void write(const QByteArray &bytes);
+
+    QScopedPointer<QFile> m_file;
+    QIODevice *m_device = nullptr;
+    QVector<Record> m_records;
+    qint64 m_offset   = 0;
+    quint16 m_dosTime = 0;
+    quint16 m_dosDate = 0;
+    bool m_error      = false;
+    bool m_closed     = false;
+#else
     QZipWriter *m_writer;
+#endif
 };
 
 QT_END_NAMESPACE_XLSX
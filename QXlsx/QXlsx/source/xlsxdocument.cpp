@@ -17,6 +17,7 @@
 #include "xlsxworkbook.h"
 #include "xlsxworkbook_p.h"
 #include "xlsxworksheet.h"
+#include "xlsxworksheet_p.h"
 #include "xlsxzipreader_p.h"
 #include "xlsxzipwriter_p.h"
 
@@ -28,6 +29,10 @@
 #include <QFile>
 #include <QPointF>
 #include <QTemporaryFile>
+#include <QSemaphore>
+#include <QThreadPool>
+
+#include <vector>
 
 /*
         From Wikipedia: The Open Packaging Conventions (OPC) is a
@@ -159,6 +164,106 @@ DocumentPrivate::DocumentPrivate(Document *p)
 {
 }
 
+namespace {
+
+// Loads one sheet of a package for the parallel mode of loadPackage()
+class SheetLoadTask : public QRunnable
+{
+public:
+    SheetLoadTask(AbstractSheet *sheet, QIODevice *part)
+        : m_sheet(sheet)
+        , m_part(part)
+    {
+    }
+
+    void run() override { m_sheet->loadFromXmlFile(m_part); }
+
+private:
+    AbstractSheet *m_sheet;
+    QIODevice *m_part;
+};
+
+// Generates and deflates one part, and its relationships, for savePackage()
+class PartSaveJob : public QRunnable
+{
+public:
+    PartSaveJob(const AbstractOOXmlFile *part, const QString &path, const QString &relsPath,
+                const ZipWriter *zipWriter)
+        : m_part(part)
+        , m_path(path)
+        , m_relsPath(relsPath)
+        , m_zipWriter(zipWriter)
+    {
+        setAutoDelete(false);
+    }
+
+    void run() override
+    {
+        // Deflated as it is generated, so the part is never held uncompressed
+        std::unique_ptr<QIODevice> device =
+            ZipWriter::compressTo(&m_xml, m_zipWriter->compressionLevel(m_path, -1));
+        m_part->saveToXmlFile(device.get());
+        device->close();
+        // Sheets fill in their relationships while they are saved
+        const Relationships *rels = m_part->relationships();
+        m_hasRelationships        = !rels->isEmpty();
+        if (m_hasRelationships)
+            m_relationships = compress(m_relsPath, rels->saveToXmlData());
+        m_done.release();
+    }
+
+    // Blocks until run() has finished
+    void wait()
+    {
+        m_done.acquire();
+        m_done.release();
+    }
+
+    const QString &path() const { return m_path; }
+    const ZipWriter::Entry &xml() const { return m_xml; }
+    bool hasRelationships() const { return m_hasRelationships; }
+    const QString &relationshipsPath() const { return m_relsPath; }
+    const ZipWriter::Entry &relationships() const { return m_relationships; }
+
+private:
+    ZipWriter::Entry compress(const QString &path, const QByteArray &data) const
+    {
+        return ZipWriter::compress(data, m_zipWriter->compressionLevel(path, data.size()));
+    }
+
+    const AbstractOOXmlFile *m_part;
+    QString m_path;
+    QString m_relsPath;
+    const ZipWriter *m_zipWriter;
+    ZipWriter::Entry m_xml;
+    ZipWriter::Entry m_relationships;
+    bool m_hasRelationships = false;
+    QSemaphore m_done;
+};
+
+// zlib level of a part under the given save options
+int compressionLevel(const Document::SaveOptions &options, const QString &path, qint64 size)
+{
+    Document::SaveOptions::Compression compression = options.compression;
+    if (options.partCompression)
+        compression = options.partCompression(path, size);
+    else if (size >= 0 && size < options.storeBelow)
+        compression = Document::SaveOptions::NoCompression;
+
+    switch (compression) {
+    case Document::SaveOptions::NoCompression:
+        return 0;
+    case Document::SaveOptions::FastCompression:
+        return 1;
+    case Document::SaveOptions::BestCompression:
+        return 9;
+    default:
+        return -1;
+    }
+}
+
+} // namespace
+
 void DocumentPrivate::init()
 {
     if (!contentTypes)
@@ -168,7 +273,7 @@ void DocumentPrivate::init()
         workbook = std::shared_ptr<Workbook>(new Workbook(Workbook::F_NewFromScratch));
 }
 
-bool DocumentPrivate::loadPackage(QIODevice *device)
+bool DocumentPrivate::loadPackage(QIODevice *device, const Document::LoadOptions &options)
 {
     Q_Q(Document);
     ZipReader zipReader(device);
@@ -274,16 +379,38 @@ bool DocumentPrivate::loadPackage(QIODevice *device)
     }
 
     // load sheets
-    for (int i = 0; i < workbook->sheetCount(); ++i) {
+    // Worksheets are inflated as they are parsed instead of all at once
+    const int sheetCount = workbook->sheetCount();
+    std::vector<std::unique_ptr<QIODevice>> sheetParts(sheetCount);
+    for (int i = 0; i < sheetCount; ++i) {
         AbstractSheet *sheet = workbook->sheet(i);
         QString strFilePath  = sheet->filePath();
         QString rel_path     = getRelFilePath(strFilePath);
         // If the .rel file exists, load it.
         if (zipReader.filePaths().contains(rel_path))
             sheet->relationships()->loadFromXmlData(zipReader.fileData(rel_path));
-        sheet->loadFromXmlData(zipReader.fileData(sheet->filePath()));
+        sheetParts[i] = zipReader.openFile(sheet->filePath());
+        if (!sheetParts[i]) {
+            sheetParts[i].reset(new QBuffer);
+            sheetParts[i]->open(QIODevice::ReadOnly);
+        }
     }
 
+    if (options.parallelSheets && sheetCount > 1) {
+        // Sheets only read the styles and shared strings loaded above;
+        // shared string reference counts are updated under a lock
+        QThreadPool pool;
+        if (options.maxThreads > 0)
+            pool.setMaxThreadCount(options.maxThreads);
+        for (int i = 0; i < sheetCount; ++i)
+            pool.start(new SheetLoadTask(workbook->sheet(i), sheetParts[i].get()));
+        pool.waitForDone();
+    } else {
+        for (int i = 0; i < sheetCount; ++i)
+            workbook->sheet(i)->loadFromXmlFile(sheetParts[i].get());
+    }
+    sheetParts.clear();
+
     // load external links
     for (int i = 0; i < workbook->d_func()->externalLinks.count(); ++i) {
         SimpleOOXmlFile *link = workbook->d_func()->externalLinks[i].get();
@@ -322,13 +449,29 @@ bool DocumentPrivate::loadPackage(QIODevice *device)
     return true;
 }
 
-bool DocumentPrivate::savePackage(QIODevice *device) const
+bool DocumentPrivate::savePackage(QIODevice *device, const Document::SaveOptions &options) const
 {
-    Q_Q(const Document);
+    // The rows of write-only sheets are gone once they have been streamed
+    if (writeOnly) {
+        qWarning("Document: a write-only document is saved by endWriteOnly()");
+        return false;
+    }
 
     ZipWriter zipWriter(device);
     if (zipWriter.error())
         return false;
+    zipWriter.setCompressionLevel([options](const QString &path, qint64 size) {
+        return compressionLevel(options, path, size);
+    });
+
+    return writePackage(zipWriter);
+}
+
+// Writes every part to zipWriter and closes it. Worksheets already streamed
+// in write-only mode are in the archive and only get listed.
+bool DocumentPrivate::writePackage(ZipWriter &zipWriter) const
+{
+    Q_Q(const Document);
 
     contentTypes->clearOverrides();
 
@@ -341,18 +484,76 @@ bool DocumentPrivate::savePackage(QIODevice *device) const
     if (!worksheets.isEmpty())
         docPropsApp.addHeadingPair(QStringLiteral("Worksheets"), worksheets.size());
 
+    // Worksheets and the shared strings, the large parts, are generated and
+    // deflated on a thread pool. They only read the workbook, so they can
+    // run side by side; this thread appends them to the archive in order.
+    // The first worksheet needs no job: this thread writes it straight into
+    // the archive while the others are generated.
+    std::vector<std::unique_ptr<PartSaveJob>> sheetJobs;
+    std::unique_ptr<PartSaveJob> sharedStringsJob;
+    QThreadPool pool;
+    for (int i = 0; i < worksheets.size(); ++i) {
+        if (i == 0 ||
+            !static_cast<Worksheet *>(worksheets[i].get())->d_func()->streamPath.isEmpty()) {
+            sheetJobs.emplace_back();
+            continue;
+        }
+        sheetJobs.emplace_back(
+            new PartSaveJob(worksheets[i].get(),
+                            QStringLiteral("xl/worksheets/sheet%1.xml").arg(i + 1),
+                            QStringLiteral("xl/worksheets/_rels/sheet%1.xml.rels").arg(i + 1),
+                            &zipWriter));
+        pool.start(sheetJobs.back().get());
+    }
+    if (!workbook->sharedStrings()->isEmpty()) {
+        sharedStringsJob.reset(new PartSaveJob(workbook->sharedStrings(),
+                                               QStringLiteral("xl/sharedStrings.xml"),
+                                               QString(),
+                                               &zipWriter));
+        pool.start(sharedStringsJob.get());
+    }
+
     for (int i = 0; i < worksheets.size(); ++i) {
         std::shared_ptr<AbstractSheet> sheet = worksheets[i];
         contentTypes->addWorksheetName(QStringLiteral("sheet%1").arg(i + 1));
         docPropsApp.addPartTitle(sheet->sheetName());
 
-        zipWriter.addFile(QStringLiteral("xl/worksheets/sheet%1.xml").arg(i + 1),
-                          sheet->saveToXmlData());
+        // Stop early once the device fails, e.g. a canceled save
+        if (zipWriter.error()) {
+            pool.clear();
+            return false;
+        }
 
-        Relationships *rel = sheet->relationships();
-        if (!rel->isEmpty())
-            zipWriter.addFile(QStringLiteral("xl/worksheets/_rels/sheet%1.xml.rels").arg(i + 1),
-                              rel->saveToXmlData());
+        PartSaveJob *job = sheetJobs[i].get();
+        const QString &streamPath = static_cast<Worksheet *>(sheet.get())->d_func()->streamPath;
+        if (!job && streamPath.isEmpty()) {
+            const QString path = QStringLiteral("xl/worksheets/sheet%1.xml").arg(i + 1);
+            std::unique_ptr<QIODevice> entry = zipWriter.openEntry(path);
+            if (!entry) {
+                pool.clear();
+                return false;
+            }
+            sheet->saveToXmlFile(entry.get());
+            entry->close();
+            Relationships *rel = sheet->relationships();
+            if (!rel->isEmpty())
+                zipWriter.addFile(QStringLiteral("xl/worksheets/_rels/sheet%1.xml.rels").arg(i + 1),
+                                  rel->saveToXmlData());
+            continue;
+        }
+        if (!job) {
+            // Streamed; sheets must not have been inserted or moved before it
+            if (streamPath != QStringLiteral("xl/worksheets/sheet%1.xml").arg(i + 1)) {
+                qWarning("Document: a write-only sheet was moved after it was written");
+                pool.clear();
+                return false;
+            }
+            continue;
+        }
+        job->wait();
+        zipWriter.addEntry(job->path(), job->xml());
+        if (job->hasRelationships())
+            zipWriter.addEntry(job->relationshipsPath(), job->relationships());
     }
 
     // save chartsheet xml files
@@ -417,10 +618,10 @@ bool DocumentPrivate::savePackage(QIODevice *device) const
     zipWriter.addFile(QStringLiteral("docProps/core.xml"), docPropsCore.saveToXmlData());
 
     // save sharedStrings xml file
-    if (!workbook->sharedStrings()->isEmpty()) {
+    if (sharedStringsJob) {
         contentTypes->addSharedString();
-        zipWriter.addFile(QStringLiteral("xl/sharedStrings.xml"),
-                          workbook->sharedStrings()->saveToXmlData());
+        sharedStringsJob->wait();
+        zipWriter.addEntry(sharedStringsJob->path(), sharedStringsJob->xml());
     }
 
     // save calc chain [dev16]
@@ -467,7 +668,7 @@ bool DocumentPrivate::savePackage(QIODevice *device) const
     zipWriter.addFile(QStringLiteral("[Content_Types].xml"), contentTypes->saveToXmlData());
 
     zipWriter.close();
-    return true;
+    return !zipWriter.error();
 }
 
 //
@@ -667,6 +868,17 @@ Document::Document(QObject *parent)
  * The \a parent argument is passed to QObject's constructor.
  */
 Document::Document(const QString &name, QObject *parent)
+    : Document(name, LoadOptions(), parent)
+{
+}
+
+/*!
+ * \overload
+ * Try to open an existing xlsx document named \a name, reading it as set
+ * out by \a options.
+ * The \a parent argument is passed to QObject's constructor.
+ */
+Document::Document(const QString &name, const LoadOptions &options, QObject *parent)
     : QObject(parent)
     , d_ptr(new DocumentPrivate(this))
 {
@@ -675,7 +887,7 @@ Document::Document(const QString &name, QObject *parent)
     if (QFile::exists(name)) {
         QFile xlsx(name);
         if (xlsx.open(QFile::ReadOnly)) {
-            if (!d_ptr->loadPackage(&xlsx)) {
+            if (!d_ptr->loadPackage(&xlsx, options)) {
                 // NOTICE: failed to load package
             }
         }
@@ -690,11 +902,22 @@ Document::Document(const QString &name, QObject *parent)
  * The \a parent argument is passed to QObject's constructor.
  */
 Document::Document(QIODevice *device, QObject *parent)
+    : Document(device, LoadOptions(), parent)
+{
+}
+
+/*!
+ * \overload
+ * Try to open an existing xlsx document from \a device, reading it as set
+ * out by \a options.
+ * The \a parent argument is passed to QObject's constructor.
+ */
+Document::Document(QIODevice *device, const LoadOptions &options, QObject *parent)
     : QObject(parent)
     , d_ptr(new DocumentPrivate(this))
 {
     if (device && device->isReadable()) {
-        if (!d_ptr->loadPackage(device)) {
+        if (!d_ptr->loadPackage(device, options)) {
             // NOTICE: failed to load package
         }
     }
@@ -724,6 +947,45 @@ bool Document::write(int row, int col, const QVariant &value, const Format &form
     return false;
 }
 
+/*!
+ * Writes \a values to the row below the last one holding data in the
+ * current worksheet, with the \a format. In write-only mode the row goes to
+ * the package right away.
+ *
+ * \sa Worksheet::appendRow(), beginWriteOnly()
+ */
+bool Document::appendRow(const QList<QVariant> &values, const Format &format)
+{
+    Q_D(Document);
+    Worksheet *sheet = currentWorksheet();
+    if (!sheet || (d->writeOnlyZip && !d->streamSheet(sheet)))
+        return false;
+    return sheet->appendRow(values, format);
+}
+
+/*!
+ * Writes \a count \a values to row \a row of the current worksheet, from
+ * column \a col on, with the \a format.
+ *
+ * \sa Worksheet::writeRow()
+ */
+bool Document::writeRow(int row, int col, const CellValue *values, int count, const Format &format)
+{
+    if (Worksheet *sheet = currentWorksheet())
+        return sheet->writeRow(row, col, values, count, format);
+    return false;
+}
+
+/*!
+ * \overload
+ */
+bool Document::writeRow(int row, int col, const QVector<CellValue> &values, const Format &format)
+{
+    if (Worksheet *sheet = currentWorksheet())
+        return sheet->writeRow(row, col, values, format);
+    return false;
+}
+
 /*!
         \overload
         Returns the contents of the cell \a cell.
@@ -1271,6 +1533,8 @@ bool Document::copySheet(const QString &srcName, const QString &distName)
 bool Document::moveSheet(const QString &srcName, int distIndex)
 {
     Q_D(Document);
+    if (d->writeOnlyZip)
+        return false;
     return d->workbook->moveSheet(sheetNames().indexOf(srcName), distIndex);
 }
 
@@ -1281,6 +1545,8 @@ bool Document::moveSheet(const QString &srcName, int distIndex)
 bool Document::deleteSheet(const QString &name)
 {
     Q_D(Document);
+    if (d->writeOnlyZip)
+        return false;
     return d->workbook->deleteSheet(sheetNames().indexOf(name));
 }
 
@@ -1373,6 +1639,150 @@ bool Document::saveAs(QIODevice *device) const
     return d->savePackage(device);
 }
 
+/*!
+ * \overload
+ * Saves the document to the file with the given \a name, compressing its
+ * parts as \a options asks for.
+ */
+bool Document::saveAs(const QString &name, const SaveOptions &options) const
+{
+    QFile file(name);
+    if (file.open(QIODevice::WriteOnly))
+        return saveAs(&file, options);
+    return false;
+}
+
+/*!
+ * \overload
+ * Writes the document to \a device, compressing its parts as \a options
+ * asks for.
+ *
+ * \warning The \a device will be closed when this function returned.
+ */
+bool Document::saveAs(QIODevice *device, const SaveOptions &options) const
+{
+    Q_D(const Document);
+    return d->savePackage(device, options);
+}
+
+/*!
+ * Starts write-only mode, writing the document to the file \a xlsxName with
+ * the given \a options as it is built.
+ *
+ * Rows added with appendRow() are written to the package right away and
+ * aren't kept, so memory doesn't grow with the number of rows. The rows of
+ * one worksheet have to be appended before those of the next one, and the
+ * settings that go before the cells (column widths, sheet view) before its
+ * first row; sheets can't be moved or deleted meanwhile. Shared strings,
+ * styles and the other parts are written by endWriteOnly(), which finishes
+ * the package.
+ *
+ * Returns false if the file can't be written.
+ */
+bool Document::beginWriteOnly(const QString &xlsxName, const SaveOptions &options)
+{
+    Q_D(Document);
+    return d->beginWriteOnly(std::unique_ptr<ZipWriter>(new ZipWriter(xlsxName)), options);
+}
+
+/*!
+ * \overload
+ * Starts write-only mode, writing the document to \a device, which must
+ * stay valid until endWriteOnly().
+ */
+bool Document::beginWriteOnly(QIODevice *device, const SaveOptions &options)
+{
+    Q_D(Document);
+    return d->beginWriteOnly(std::unique_ptr<ZipWriter>(new ZipWriter(device)), options);
+}
+
+/*!
+ * Finishes write-only mode: the rows still held and the rest of the
+ * package are written, and the file is closed. Called by the destructor if
+ * need be. The document can't be saved again afterwards.
+ *
+ * Returns true if the whole package was written.
+ */
+bool Document::endWriteOnly()
+{
+    Q_D(Document);
+    if (!d->writeOnlyZip)
+        return false;
+
+    bool ok = d->endSheetStream();
+    ok      = d->writePackage(*d->writeOnlyZip) && ok;
+    d->writeOnlyZip.reset();
+    return ok;
+}
+
+/*!
+ * Returns true once beginWriteOnly() has been called.
+ */
+bool Document::isWriteOnly() const
+{
+    Q_D(const Document);
+    return d->writeOnly;
+}
+
+bool DocumentPrivate::beginWriteOnly(std::unique_ptr<ZipWriter> zipWriter,
+                                     const Document::SaveOptions &options)
+{
+    if (writeOnly || zipWriter->error())
+        return false;
+    zipWriter->setCompressionLevel([options](const QString &path, qint64 size) {
+        return compressionLevel(options, path, size);
+    });
+    writeOnlyZip = std::move(zipWriter);
+    writeOnly    = true;
+    return true;
+}
+
+// Makes sheet the one appended rows are streamed to. The archive takes one
+// entry at a time, so the sheet streamed so far is finished first.
+bool DocumentPrivate::streamSheet(Worksheet *sheet)
+{
+    WorksheetPrivate *sheet_d = sheet->d_func();
+    if (sheet_d->streamWriter)
+        return true;
+    if (!sheet_d->streamPath.isEmpty()) {
+        qWarning("Document: a write-only sheet is finished once another one is written");
+        return false;
+    }
+    if (!endSheetStream())
+        return false;
+
+    const QList<std::shared_ptr<AbstractSheet>> worksheets =
+        workbook->getSheetsByTypes(AbstractSheet::ST_WorkSheet);
+    int index = 0;
+    while (index < worksheets.size() && worksheets[index].get() != sheet)
+        ++index;
+
+    const QString path = QStringLiteral("xl/worksheets/sheet%1.xml").arg(index + 1);
+    std::unique_ptr<QIODevice> entry = writeOnlyZip->openEntry(path);
+    if (!entry)
+        return false;
+    sheet_d->beginStream(std::move(entry), path);
+    streamingSheet = sheet;
+    return true;
+}
+
+bool DocumentPrivate::endSheetStream()
+{
+    if (!streamingSheet)
+        return true;
+    WorksheetPrivate *sheet_d = streamingSheet->d_func();
+    streamingSheet            = nullptr;
+
+    bool ok = sheet_d->endStream();
+    // Hyperlinks and drawings add the sheet's relationships as it's finished
+    if (!sheet_d->relationships->isEmpty()) {
+        const QString name = sheet_d->streamPath.section(QLatin1Char('/'), -1);
+        writeOnlyZip->addFile(QStringLiteral("xl/worksheets/_rels/%1.rels").arg(name),
+                              sheet_d->relationships->saveToXmlData());
+    }
+    return ok && !writeOnlyZip->error();
+}
+
 bool Document::saveAsCsv(const QString mainCSVFileName) const
 {
     Q_D(const Document);
@@ -1401,6 +1811,8 @@ bool Document::copyStyle(const QString &from, const QString &to)
  */
 Document::~Document()
 {
+    if (d_ptr->writeOnlyZip)
+        endWriteOnly();
     delete d_ptr;
 }
 
@@ -1599,12 +2011,12 @@ bool Document::read_sheet_sax(int sheet_index,
         return false;
 
     const QString sheet_path = abs_sheet->filePath();
-    const QByteArray sheet_xml = zip.fileData(sheet_path);
+    std::unique_ptr<QIODevice> sheet_xml = zip.openFile(sheet_path);
 
-    if (sheet_xml.isEmpty())
+    if (!sheet_xml || sheet_xml->size() == 0)
         return false;
 
-    return QXlsx::read_sheet_xml_sax(sheet_xml, opt,
+    return QXlsx::read_sheet_xml_sax(sheet_xml.get(), opt,
                                      opt.resolve_shared_strings ? &shared_strings : nullptr,
                                      on_cell);
 }
@@ -9,6 +9,8 @@
 #include <QDataStream>
 #include <QDebug>
 
+#include <cstring>
+
 QT_BEGIN_NAMESPACE_XLSX
 
 FormatPrivate::FormatPrivate()
@@ -28,6 +30,7 @@ FormatPrivate::FormatPrivate()
     , dxf_index(-1)
     , dxf_indexValid(false)
     , theme(0)
+    , keys_dirty(true)
 {
 }
 
@@ -54,6 +57,7 @@ FormatPrivate::FormatPrivate(const FormatPrivate &other)
     , dxf_indexValid(other.dxf_indexValid)
     , theme(other.theme)
     , properties(other.properties)
+    , keys_dirty(true)
 {
 }
 
@@ -61,6 +65,90 @@ FormatPrivate::~FormatPrivate()
 {
 }
 
+const FormatKey &FormatPrivate::key(KeyGroup group)
+{
+    if (keys_dirty) {
+        for (int i = 0; i < KeyGroupCount; ++i)
+            keys[i] = FormatKey();
+        for (auto it = properties.constBegin(); it != properties.constEnd(); ++it) {
+            const int id = it.key();
+            keys[XfKey].addProperty(id, it.value());
+            if (id >= P_Font_STARTID && id < P_Font_ENDID)
+                keys[FontKey].addProperty(id, it.value());
+            else if (id >= P_Fill_STARTID && id < P_Fill_ENDID)
+                keys[FillKey].addProperty(id, it.value());
+            else if (id >= P_Border_STARTID && id < P_Border_ENDID)
+                keys[BorderKey].addProperty(id, it.value());
+        }
+        keys_dirty = false;
+    }
+    return keys[group];
+}
+
+void FormatKey::addProperty(int id, const QVariant &value)
+{
+    const int type = value.userType();
+    switch (type) {
+    case QMetaType::Bool:
+    case QMetaType::Int:
+    case QMetaType::UInt:
+    case QMetaType::LongLong:
+    case QMetaType::ULongLong:
+        addField(id, type, value.toLongLong());
+        return;
+    case QMetaType::Double:
+    case QMetaType::Float: {
+        const double number = value.toDouble();
+        qint64 bits;
+        std::memcpy(&bits, &number, sizeof(bits));
+        addField(id, QMetaType::Double, bits);
+        return;
+    }
+    default:
+        break;
+    }
+
+    if (type == qMetaTypeId<XlsxColor>()) {
+        // Tagged by kind in the top bits
+        const XlsxColor color = value.value<XlsxColor>();
+        if (color.isRgbColor())
+            addField(id, type, (qint64(1) << 40) | color.rgbColor().rgba());
+        else if (color.isIndexedColor())
+            addField(id, type, (qint64(2) << 40) | quint32(color.indexedColor()));
+        else if (color.isThemeColor())
+            addField(id,
+                     type,
+                     (qint64(3) << 40) | addString(color.themeColor().join(QLatin1Char(':'))));
+        else
+            addField(id, type, 0);
+        return;
+    }
+
+    addField(id, type, addString(value.toString()));
+}
+
+// Keeps a string to compare by and hashes it; returns its index
+qint64 FormatKey::addString(const QString &string)
+{
+    m_strings.append(string);
+    mix(quint64(qHash(string)));
+    return m_strings.size() - 1;
+}
+
+void FormatKey::addField(int id, int type, qint64 value)
+{
+    m_fields.append(Field{id, type, value});
+    mix(quint64(id));
+    mix(quint64(type));
+    mix(quint64(value));
+}
+
+// FNV-1a, a word at a time
+void FormatKey::mix(quint64 word)
+{
+    m_hash = (m_hash ^ word) * Q_UINT64_C(0x100000001b3);
+}
+
 /*!
  * \class Format
  * \inmodule QtXlsx
@@ -1278,7 +1366,9 @@ bool Format::dxfIndexValid() const
 */
 bool Format::operator==(const Format &format) const
 {
-    return this->formatKey() == format.formatKey();
+    if (isEmpty() || format.isEmpty())
+        return isEmpty() && format.isEmpty();
+    return d->key(FormatPrivate::XfKey) == format.d->key(FormatPrivate::XfKey);
 }
 
 /*!
@@ -1286,7 +1376,7 @@ bool Format::operator==(const Format &format) const
 */
 bool Format::operator!=(const Format &format) const
 {
-    return this->formatKey() != format.formatKey();
+    return !(*this == format);
 }
 
 int Format::theme() const
@@ -1338,6 +1428,7 @@ void Format::setProperty(int propertyId,
     }
 
     d->dirty          = true;
+    d->keys_dirty     = true;
     d->xf_indexValid  = false;
     d->dxf_indexValid = false;
 
@@ -3,10 +3,16 @@
 #include "xlsxzipreader_p.h"    // QXlsx internal zip reader (adjust include as per project structure)
 
 #include "xlsxreadsax.h"
+#include "xlsxrelationships_p.h"
+#include "xlsxscan_p.h"
+#include "xlsxutility_p.h"
 
 #include <QtCore>
 #include <QXmlStreamReader>
 
+#include <cstring>
+#include <memory>
+
 namespace QXlsx {
 
 int parse_col_letters(const QStringView& s, int* letters_len)
@@ -42,43 +48,249 @@ bool parse_cell_ref(const QString& r, int* out_row, int* out_col)
     return true;
 }
 
-QStringList load_shared_strings_all(ZipReader& zip)
+namespace {
+
+// Parses sharedStrings.xml on demand, only as far as the highest index asked for.
+// Plain UTF-8 parts are scanned directly with the byte kernels, each entry being
+// validated as it is read; on anything the fast path does not handle (invalid
+// UTF-8, DTDs, CDATA, unknown entities) it hands over to QXmlStreamReader, which
+// skips the entries already read.
+class SharedStringsCursor
 {
-    QStringList out;
-    const QByteArray xml = zip.fileData(QStringLiteral("xl/sharedStrings.xml"));
-    if (xml.isEmpty())
-        return out;
+public:
+    explicit SharedStringsCursor(const QByteArray& xml)
+        : m_xml(xml)
+        , m_scan(Scan::kernels())
+        , m_pos(m_xml.constData())
+        , m_end(m_xml.constData() + m_xml.size())
+        , m_fast(true)
+    {
+    }
+
+    bool lookup(int idx, QString* out)
+    {
+        if (idx < 0)
+            return false;
+        while (m_strings.size() <= idx && read_next())
+            ;
+        if (idx >= m_strings.size())
+            return false;
+        *out = m_strings[idx];
+        return true;
+    }
 
-    QXmlStreamReader rd(xml);
+    QStringList take_all()
+    {
+        while (read_next())
+            ;
+        return std::move(m_strings);
+    }
 
-    bool in_si = false;
-    QString acc;
+private:
+    enum class fast_result { found, end, unsupported };
 
-    while (!rd.atEnd()) {
-        rd.readNext();
-        if (rd.isStartElement()) {
-            const auto name = rd.name();
-            if (name == QLatin1String("si")) {
+    // Appends the next <si> entry; false at the end of the document
+    bool read_next()
+    {
+        if (m_fast) {
+            switch (read_next_fast()) {
+            case fast_result::found:
+                return true;
+            case fast_result::end:
+                return false;
+            case fast_result::unsupported:
+                m_fast = false;
+                m_reader.reset(new QXmlStreamReader(m_xml));
+                m_skip = int(m_strings.size());
+                break;
+            }
+        }
+        return read_next_slow();
+    }
+
+    bool read_next_slow()
+    {
+        bool in_si = false;
+        QString acc;
+
+        while (!m_reader->atEnd()) {
+            m_reader->readNext();
+            if (m_reader->isStartElement()) {
+                const auto name = m_reader->name();
+                if (name == QLatin1String("si")) {
+                    in_si = true;
+                    acc.clear();
+                } else if (in_si && name == QLatin1String("t")) {
+                    acc += m_reader->readElementText(QXmlStreamReader::IncludeChildElements);
+                }
+            } else if (m_reader->isEndElement()) {
+                if (in_si && m_reader->name() == QLatin1String("si")) {
+                    in_si = false;
+                    if (m_skip > 0) {
+                        --m_skip;
+                        continue;
+                    }
+                    m_strings.push_back(acc);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    fast_result read_next_fast()
+    {
+        const char* const begin = m_pos;
+        bool in_si = false;
+        QString acc;
+
+        for (;;) {
+            m_pos = m_scan.findByte(m_pos, m_end, '<');
+            if (m_pos == m_end)
+                return in_si ? fast_result::unsupported : fast_result::end;
+            const char* tag = ++m_pos;
+            if (tag == m_end)
+                return fast_result::unsupported;
+
+            if (*tag == '?') {
+                const char* close = find_sequence(tag, "?>");
+                if (!close)
+                    return fast_result::unsupported;
+                m_pos = close + 2;
+                continue;
+            }
+            if (*tag == '!') {
+                if (m_end - tag < 3 || tag[1] != '-' || tag[2] != '-')
+                    return fast_result::unsupported; // CDATA or DOCTYPE
+                const char* close = find_sequence(tag + 3, "-->");
+                if (!close)
+                    return fast_result::unsupported;
+                m_pos = close + 3;
+                continue;
+            }
+
+            const bool is_end = *tag == '/';
+            const char* name_begin = is_end ? tag + 1 : tag;
+            const char* name_end = name_begin;
+            while (name_end < m_end && !is_name_end(*name_end))
+                ++name_end;
+            const char* local = name_begin;
+            for (const char* c = name_begin; c < name_end; ++c) {
+                if (*c == ':')
+                    local = c + 1;
+            }
+
+            bool self_closing = false;
+            if (!skip_tag(name_end, &self_closing))
+                return fast_result::unsupported;
+
+            if (is_end) {
+                if (in_si && local_name_is(local, name_end, "si"))
+                    return append_entry(begin, acc);
+            } else if (local_name_is(local, name_end, "si")) {
                 in_si = true;
                 acc.clear();
-            } else if (in_si && name == QLatin1String("t")) {
-                acc += rd.readElementText(QXmlStreamReader::IncludeChildElements);
+                if (self_closing)
+                    return append_entry(begin, acc);
+            } else if (in_si && local_name_is(local, name_end, "t") && !self_closing) {
+                // Rich text runs hold plain character data only; anything
+                // nested inside <t> goes to the slow path
+                const char* text_end = m_scan.findByte(m_pos, m_end, '<');
+                if (text_end == m_end || text_end + 1 == m_end || text_end[1] != '/')
+                    return fast_result::unsupported;
+                QString text;
+                if (!Scan::decodeText(m_pos, text_end, &text))
+                    return fast_result::unsupported;
+                acc += text;
+                m_pos = text_end;
             }
-        } else if (rd.isEndElement()) {
-            const auto name = rd.name();
-            if (name == QLatin1String("si")) {
-                in_si = false;
-                out.push_back(acc);
+        }
+    }
+
+    // Appends an entry once the bytes read for it, [begin, m_pos), are
+    // known to be valid UTF-8
+    fast_result append_entry(const char* begin, const QString& text)
+    {
+        if (!m_scan.isValidUtf8(begin, m_pos))
+            return fast_result::unsupported;
+        m_strings.push_back(text);
+        return fast_result::found;
+    }
+
+    // Moves m_pos past the attributes and the closing '>' of the tag
+    bool skip_tag(const char* p, bool* self_closing)
+    {
+        char quote = 0;
+        for (; p < m_end; ++p) {
+            if (quote) {
+                if (*p == quote)
+                    quote = 0;
+            } else if (*p == '"' || *p == '\'') {
+                quote = *p;
+            } else if (*p == '>') {
+                *self_closing = p[-1] == '/';
+                m_pos = p + 1;
+                return true;
             }
         }
+        return false;
     }
-    return out;
+
+    const char* find_sequence(const char* p, const char* sequence) const
+    {
+        const size_t length = std::strlen(sequence);
+        for (;;) {
+            p = m_scan.findByte(p, m_end, sequence[0]);
+            if (size_t(m_end - p) < length)
+                return nullptr;
+            if (std::memcmp(p, sequence, length) == 0)
+                return p;
+            ++p;
+        }
+    }
+
+    static bool is_name_end(char c)
+    {
+        return c == '>' || c == '/' || c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    static bool local_name_is(const char* begin, const char* end, const char* name)
+    {
+        const size_t length = std::strlen(name);
+        return size_t(end - begin) == length && std::memcmp(begin, name, length) == 0;
+    }
+
+    QByteArray m_xml;
+    const Scan::Kernels& m_scan;
+    const char* m_pos;
+    const char* m_end;
+    bool m_fast;
+
+    std::unique_ptr<QXmlStreamReader> m_reader;
+    int m_skip = 0;
+    QStringList m_strings;
+};
+
+} // namespace
+
+using shared_string_lookup = std::function<bool(int, QString*)>;
+
+QStringList load_shared_strings_all(ZipReader& zip)
+{
+    const QByteArray xml = zip.fileData(QStringLiteral("xl/sharedStrings.xml"));
+    if (xml.isEmpty())
+        return QStringList();
+
+    SharedStringsCursor cursor(xml);
+    return cursor.take_all();
 }
 
-bool read_sheet_xml_sax(const QByteArray& sheet_xml,
-                        const sax_options& opt,
-                        const QStringList* shared_strings,
-                        const sax_cell_callback& on_cell)
+// QXmlStreamReader pulls the part from the device in small blocks, so a
+// streamed part (ZipReader::openFile) is never held in memory as a whole
+static bool read_sheet_xml_sax_impl(QIODevice* sheet_xml,
+                                    const sax_options& opt,
+                                    const shared_string_lookup& shared_string,
+                                    const sax_cell_callback& on_cell)
 {
     QXmlStreamReader rd(sheet_xml);
 
@@ -86,6 +298,10 @@ bool read_sheet_xml_sax(const QByteArray& sheet_xml,
     bool in_c = false;
     bool in_v = false;
 
+    // Position of the last row and cell, for elements without an r attribute
+    int row_num = 0;
+    int col_num = 0;
+
     QString cell_r;
     QString cell_t;
     QString cell_s;
@@ -99,6 +315,14 @@ bool read_sheet_xml_sax(const QByteArray& sheet_xml,
 
             if (name == QLatin1String("sheetData")) {
                 in_sheetdata = true;
+            } else if (in_sheetdata && name == QLatin1String("row")) {
+                bool ok = false;
+                const int row = rd.attributes().value(QLatin1String("r")).toInt(&ok);
+                row_num       = ok ? row : row_num + 1;
+                col_num       = 0;
+                // Rows are stored in order, so nothing past max_row is needed
+                if (opt.max_row > 0 && row_num > opt.max_row)
+                    return true;
             } else if (in_sheetdata && name == QLatin1String("c")) {
                 in_c = true;
                 cell_r = rd.attributes().value(QLatin1String("r")).toString();
@@ -130,10 +354,19 @@ bool read_sheet_xml_sax(const QByteArray& sheet_xml,
             } else if (in_c && name == QLatin1String("c")) {
                 in_c = false;
 
+                // Cells without a reference follow the previous one
                 int row = 0, col = 0;
-                if (!parse_cell_ref(cell_r, &row, &col)) {
+                if (cell_r.isEmpty()) {
+                    row = row_num;
+                    col = col_num + 1;
+                } else if (!parse_cell_ref(cell_r, &row, &col)) {
                     continue;
                 }
+                col_num = col;
+                if (row < 1)
+                    continue;
+                if (opt.max_row > 0 && row > opt.max_row)
+                    return true;
 
                 sax_cell c;
                 c.row = row;
@@ -142,8 +375,9 @@ bool read_sheet_xml_sax(const QByteArray& sheet_xml,
                 if (cell_t == QLatin1String("s")) {
                     bool ok = false;
                     const int idx = v_text.toInt(&ok);
-                    if (ok && shared_strings && idx >= 0 && idx < shared_strings->size())
-                        c.value = (*shared_strings)[idx];
+                    QString text;
+                    if (ok && shared_string && shared_string(idx, &text))
+                        c.value = text;
                     else
                         c.value = v_text;
                 } else if (cell_t == QLatin1String("b")) {
@@ -165,4 +399,118 @@ bool read_sheet_xml_sax(const QByteArray& sheet_xml,
     return !rd.hasError();
 }
 
+bool read_sheet_xml_sax(const QByteArray& sheet_xml,
+                        const sax_options& opt,
+                        const QStringList* shared_strings,
+                        const sax_cell_callback& on_cell)
+{
+    QBuffer buffer;
+    buffer.setData(sheet_xml);
+    buffer.open(QIODevice::ReadOnly);
+    return read_sheet_xml_sax(&buffer, opt, shared_strings, on_cell);
+}
+
+bool read_sheet_xml_sax(QIODevice* sheet_xml,
+                        const sax_options& opt,
+                        const QStringList* shared_strings,
+                        const sax_cell_callback& on_cell)
+{
+    shared_string_lookup lookup;
+    if (shared_strings) {
+        lookup = [shared_strings](int idx, QString* out) {
+            if (idx < 0 || idx >= shared_strings->size())
+                return false;
+            *out = (*shared_strings)[idx];
+            return true;
+        };
+    }
+    return read_sheet_xml_sax_impl(sheet_xml, opt, lookup, on_cell);
+}
+
+// Locate the zip path of the sheet at sheet_index from the package relationships
+static QString find_sheet_path(ZipReader& zip, int sheet_index)
+{
+    Relationships root_rels;
+    root_rels.loadFromXmlData(zip.fileData(QStringLiteral("_rels/.rels")));
+
+    const QList<XlsxRelationship> rels_xl =
+        root_rels.documentRelationships(QStringLiteral("/officeDocument"));
+    if (rels_xl.isEmpty())
+        return QString();
+
+    QString workbook_path = rels_xl[0].target;
+    if (workbook_path.startsWith(QLatin1Char('/')))
+        workbook_path = workbook_path.mid(1);
+
+    Relationships workbook_rels;
+    workbook_rels.loadFromXmlData(zip.fileData(getRelFilePath(workbook_path)));
+
+    QXmlStreamReader rd(zip.fileData(workbook_path));
+    int index = 0;
+
+    while (!rd.atEnd()) {
+        rd.readNext();
+        if (!rd.isStartElement() || rd.name() != QLatin1String("sheet"))
+            continue;
+        if (index++ != sheet_index)
+            continue;
+
+        const QString r_id = rd.attributes().value(QLatin1String("r:id")).toString();
+        const XlsxRelationship rel = workbook_rels.getRelationshipById(r_id);
+        if (rel.target.isEmpty())
+            return QString();
+        if (rel.target.startsWith(QLatin1Char('/')))
+            return QDir::cleanPath(rel.target.mid(1));
+
+        const QString workbook_dir = splitPath(workbook_path).first();
+        return QDir::cleanPath(workbook_dir + QLatin1Char('/') + rel.target);
+    }
+
+    return QString();
+}
+
+bool read_xlsx_sheet_sax(QIODevice* device,
+                         int sheet_index,
+                         const sax_options& opt,
+                         const sax_cell_callback& on_cell)
+{
+    if (!device || !device->isReadable())
+        return false;
+
+    ZipReader zip(device);
+    if (!zip.exists())
+        return false;
+
+    const QString sheet_path = find_sheet_path(zip, sheet_index);
+    if (sheet_path.isEmpty())
+        return false;
+
+    std::unique_ptr<QIODevice> sheet_xml = zip.openFile(sheet_path);
+    if (!sheet_xml || sheet_xml->size() == 0)
+        return false;
+
+    shared_string_lookup lookup;
+    std::shared_ptr<SharedStringsCursor> cursor;
+    if (opt.resolve_shared_strings) {
+        const QByteArray sst_xml = zip.fileData(QStringLiteral("xl/sharedStrings.xml"));
+        if (!sst_xml.isEmpty()) {
+            cursor = std::make_shared<SharedStringsCursor>(sst_xml);
+            lookup = [cursor](int idx, QString* out) { return cursor->lookup(idx, out); };
+        }
+    }
+
+    return read_sheet_xml_sax_impl(sheet_xml.get(), opt, lookup, on_cell);
+}
+
+bool read_xlsx_sheet_sax(const QString& xlsx_path,
+                         int sheet_index,
+                         const sax_options& opt,
+                         const sax_cell_callback& on_cell)
+{
+    QFile file(xlsx_path);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    return read_xlsx_sheet_sax(&file, sheet_index, opt, on_cell);
+}
+
 } // namespace QXlsx
@@ -0,0 +1,344 @@
+// xlsxscan.cpp
+
+#include "xlsxscan_p.h"
+
+#include <cstring>
+
+#include <QByteArray>
+#include <QString>
+#include <QtCore/qalgorithms.h>
+#include <QtGlobal>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define QXLSX_SCAN_SSE2
+#    include <emmintrin.h>
+#    define QXLSX_SCAN_AVX2
+#    include <immintrin.h>
+#    if defined(_MSC_VER) && !defined(__clang__)
+#        include <intrin.h>
+#        define QXLSX_AVX2_TARGET
+#    else
+#        define QXLSX_AVX2_TARGET __attribute__((target("avx2")))
+#    endif
+#endif
+
+QT_BEGIN_NAMESPACE_XLSX
+
+namespace Scan {
+namespace {
+
+// ==================== scalar ====================
+
+const char *findByteScalar(const char *p, const char *end, char a)
+{
+    while (p < end && *p != a)
+        ++p;
+    return p;
+}
+
+const char *findEitherScalar(const char *p, const char *end, char a, char b)
+{
+    while (p < end && *p != a && *p != b)
+        ++p;
+    return p;
+}
+
+// Length of the well-formed UTF-8 sequence at p, 0 if there is none
+int utf8SequenceLength(const uchar *p, const uchar *end)
+{
+    const uchar c = p[0];
+    if (c < 0x80)
+        return 1;
+    if (c < 0xC2) // stray continuation byte or overlong lead
+        return 0;
+    if (c < 0xE0)
+        return end - p >= 2 && (p[1] & 0xC0) == 0x80 ? 2 : 0;
+    if (c < 0xF0) {
+        if (end - p < 3 || (p[1] & 0xC0) != 0x80 || (p[2] & 0xC0) != 0x80)
+            return 0;
+        if ((c == 0xE0 && p[1] < 0xA0) || (c == 0xED && p[1] >= 0xA0)) // overlong, surrogate
+            return 0;
+        return 3;
+    }
+    if (c < 0xF5) {
+        if (end - p < 4 || (p[1] & 0xC0) != 0x80 || (p[2] & 0xC0) != 0x80 ||
+            (p[3] & 0xC0) != 0x80)
+            return 0;
+        if ((c == 0xF0 && p[1] < 0x90) || (c == 0xF4 && p[1] >= 0x90)) // overlong, > U+10FFFF
+            return 0;
+        return 4;
+    }
+    return 0;
+}
+
+bool isValidUtf8Scalar(const char *p, const char *end)
+{
+    const uchar *u = reinterpret_cast<const uchar *>(p);
+    const uchar *e = reinterpret_cast<const uchar *>(end);
+    while (u < e) {
+        const int length = utf8SequenceLength(u, e);
+        if (!length)
+            return false;
+        u += length;
+    }
+    return true;
+}
+
+const Kernels scalarKernels = {"scalar", findByteScalar, findEitherScalar, isValidUtf8Scalar};
+
+// ==================== SSE2 ====================
+
+#ifdef QXLSX_SCAN_SSE2
+const char *findByteSse2(const char *p, const char *end, char a)
+{
+    const __m128i va = _mm_set1_epi8(a);
+    for (; end - p >= 16; p += 16) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        const uint mask     = uint(_mm_movemask_epi8(_mm_cmpeq_epi8(block, va)));
+        if (mask)
+            return p + qCountTrailingZeroBits(mask);
+    }
+    return findByteScalar(p, end, a);
+}
+
+const char *findEitherSse2(const char *p, const char *end, char a, char b)
+{
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+    for (; end - p >= 16; p += 16) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        const __m128i hits  = _mm_or_si128(_mm_cmpeq_epi8(block, va), _mm_cmpeq_epi8(block, vb));
+        const uint mask     = uint(_mm_movemask_epi8(hits));
+        if (mask)
+            return p + qCountTrailingZeroBits(mask);
+    }
+    return findEitherScalar(p, end, a, b);
+}
+
+// ASCII runs are skipped a block at a time; multi-byte sequences are
+// checked one by one
+bool isValidUtf8Sse2(const char *p, const char *end)
+{
+    const uchar *u = reinterpret_cast<const uchar *>(p);
+    const uchar *e = reinterpret_cast<const uchar *>(end);
+    while (e - u >= 16) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(u));
+        const uint mask     = uint(_mm_movemask_epi8(block));
+        if (!mask) {
+            u += 16;
+            continue;
+        }
+        u += qCountTrailingZeroBits(mask);
+        const int length = utf8SequenceLength(u, e);
+        if (!length)
+            return false;
+        u += length;
+    }
+    return isValidUtf8Scalar(reinterpret_cast<const char *>(u), end);
+}
+
+const Kernels sse2Kernels = {"sse2", findByteSse2, findEitherSse2, isValidUtf8Sse2};
+#endif
+
+// ==================== AVX2 ====================
+
+#ifdef QXLSX_SCAN_AVX2
+QXLSX_AVX2_TARGET const char *findByteAvx2(const char *p, const char *end, char a)
+{
+    const __m256i va = _mm256_set1_epi8(a);
+    for (; end - p >= 32; p += 32) {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        const uint mask     = uint(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, va)));
+        if (mask)
+            return p + qCountTrailingZeroBits(mask);
+    }
+    return findByteSse2(p, end, a);
+}
+
+QXLSX_AVX2_TARGET const char *findEitherAvx2(const char *p, const char *end, char a, char b)
+{
+    const __m256i va = _mm256_set1_epi8(a);
+    const __m256i vb = _mm256_set1_epi8(b);
+    for (; end - p >= 32; p += 32) {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        const __m256i hits =
+            _mm256_or_si256(_mm256_cmpeq_epi8(block, va), _mm256_cmpeq_epi8(block, vb));
+        const uint mask = uint(_mm256_movemask_epi8(hits));
+        if (mask)
+            return p + qCountTrailingZeroBits(mask);
+    }
+    return findEitherSse2(p, end, a, b);
+}
+
+QXLSX_AVX2_TARGET bool isValidUtf8Avx2(const char *p, const char *end)
+{
+    const uchar *u = reinterpret_cast<const uchar *>(p);
+    const uchar *e = reinterpret_cast<const uchar *>(end);
+    while (e - u >= 32) {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(u));
+        const uint mask     = uint(_mm256_movemask_epi8(block));
+        if (!mask) {
+            u += 32;
+            continue;
+        }
+        u += qCountTrailingZeroBits(mask);
+        const int length = utf8SequenceLength(u, e);
+        if (!length)
+            return false;
+        u += length;
+    }
+    return isValidUtf8Sse2(reinterpret_cast<const char *>(u), end);
+}
+
+const Kernels avx2Kernels = {"avx2", findByteAvx2, findEitherAvx2, isValidUtf8Avx2};
+
+bool cpuHasAvx2()
+{
+#    if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx     = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) // OS saves the YMM registers
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#    else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#    endif
+}
+#endif
+
+bool equals(const char *begin, const char *end, const char *latin1)
+{
+    const size_t length = std::strlen(latin1);
+    return size_t(end - begin) == length && std::memcmp(begin, latin1, length) == 0;
+}
+
+void appendUtf8(QByteArray &out, uint cp)
+{
+    if (cp < 0x80) {
+        out.append(char(cp));
+    } else if (cp < 0x800) {
+        out.append(char(0xC0 | (cp >> 6)));
+        out.append(char(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out.append(char(0xE0 | (cp >> 12)));
+        out.append(char(0x80 | ((cp >> 6) & 0x3F)));
+        out.append(char(0x80 | (cp & 0x3F)));
+    } else {
+        out.append(char(0xF0 | (cp >> 18)));
+        out.append(char(0x80 | ((cp >> 12) & 0x3F)));
+        out.append(char(0x80 | ((cp >> 6) & 0x3F)));
+        out.append(char(0x80 | (cp & 0x3F)));
+    }
+}
+
+// Appends the character an entity reference (without '&' and ';') stands for
+bool appendEntity(QByteArray &out, const char *begin, const char *end)
+{
+    if (equals(begin, end, "lt")) {
+        out.append('<');
+    } else if (equals(begin, end, "gt")) {
+        out.append('>');
+    } else if (equals(begin, end, "amp")) {
+        out.append('&');
+    } else if (equals(begin, end, "quot")) {
+        out.append('"');
+    } else if (equals(begin, end, "apos")) {
+        out.append('\'');
+    } else if (end - begin > 1 && begin[0] == '#') {
+        const bool hex = begin[1] == 'x';
+        uint cp        = 0;
+        const char *d  = begin + (hex ? 2 : 1);
+        if (d == end || end - d > 8)
+            return false;
+        for (; d < end; ++d) {
+            int digit = -1;
+            if (*d >= '0' && *d <= '9')
+                digit = *d - '0';
+            else if (hex && *d >= 'a' && *d <= 'f')
+                digit = *d - 'a' + 10;
+            else if (hex && *d >= 'A' && *d <= 'F')
+                digit = *d - 'A' + 10;
+            if (digit < 0)
+                return false;
+            cp = cp * (hex ? 16 : 10) + uint(digit);
+        }
+        if (cp == 0 || cp > 0x10FFFF)
+            return false;
+        appendUtf8(out, cp);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool decodeText(const char *begin, const char *end, QString *out)
+{
+    const Kernels &scan = kernels();
+
+    const char *p = scan.findEither(begin, end, '&', '\r');
+    if (p == end) {
+        *out = QString::fromUtf8(begin, int(end - begin));
+        return true;
+    }
+
+    QByteArray bytes;
+    bytes.reserve(int(end - begin));
+    bytes.append(begin, int(p - begin));
+    while (p < end) {
+        if (*p == '\r') {
+            bytes.append('\n');
+            if (++p < end && *p == '\n')
+                ++p;
+            continue;
+        }
+        if (*p != '&') {
+            const char *next = scan.findEither(p, end, '&', '\r');
+            bytes.append(p, int(next - p));
+            p = next;
+            continue;
+        }
+
+        const char *semicolon = scan.findByte(p, end, ';');
+        if (semicolon == end || !appendEntity(bytes, p + 1, semicolon))
+            return false;
+        p = semicolon + 1;
+    }
+
+    *out = QString::fromUtf8(bytes);
+    return true;
+}
+
+const Kernels &kernels()
+{
+    static const Kernels *const best = [] {
+        const std::vector<const Kernels *> available = availableKernels();
+        return available.back();
+    }();
+    return *best;
+}
+
+std::vector<const Kernels *> availableKernels()
+{
+    std::vector<const Kernels *> available{&scalarKernels};
+#ifdef QXLSX_SCAN_SSE2
+    available.push_back(&sse2Kernels);
+#endif
+#ifdef QXLSX_SCAN_AVX2
+    if (cpuHasAvx2())
+        available.push_back(&avx2Kernels);
+#endif
+    return available;
+}
+
+} // namespace Scan
+
+QT_END_NAMESPACE_XLSX
@@ -67,9 +67,30 @@ void SharedStrings::incRefByStringIndex(int idx)
         return;
     }
 
+    QMutexLocker locker(&m_refMutex);
     addSharedString(m_stringList[idx]);
 }
 
+/*
+ * Same as calling incRefByStringIndex(idx) count times, with one lookup.
+ */
+void SharedStrings::incRefByStringIndex(int idx, int count)
+{
+    if (idx < 0 || idx >= m_stringList.size()) {
+        qDebug("SharedStrings: invalid index");
+        return;
+    }
+
+    QMutexLocker locker(&m_refMutex);
+    m_stringCount += count;
+
+    auto it = m_stringTable.find(m_stringList[idx]);
+    if (it != m_stringTable.end())
+        it->count += count;
+    else
+        m_stringTable[m_stringList[idx]] = XlsxSharedStringInfo(idx, count);
+}
+
 /*
  * Broken, don't use.
  */
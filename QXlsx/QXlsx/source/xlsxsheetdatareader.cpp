@@ -0,0 +1,770 @@
+// xlsxsheetdatareader.cpp
+
+#include "xlsxsheetdatareader_p.h"
+
+#include "xlsxcellformula.h"
+#include "xlsxscan_p.h"
+#include "xlsxsharedstrings_p.h"
+#include "xlsxstyles_p.h"
+#include "xlsxworkbook.h"
+#include "xlsxworksheet_p.h"
+
+#include <climits>
+#include <cstring>
+
+#include <QXmlStreamReader>
+
+#if defined(__has_include)
+#    if __has_include(<charconv>) &&                                                              \
+        (__cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L))
+#        include <charconv>
+#    endif
+#endif
+
+// Floating point std::from_chars is only in newer standard libraries
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+#    define QXLSX_HAS_FLOAT_FROM_CHARS
+#endif
+
+QT_BEGIN_NAMESPACE_XLSX
+
+namespace {
+
+inline bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Parses an A1 style reference ("$" allowed)
+bool parseReference(const char *p, const char *end, int *row, int *col)
+{
+    if (p < end && *p == '$')
+        ++p;
+    int column  = 0;
+    int letters = 0;
+    while (p < end && *p >= 'A' && *p <= 'Z') {
+        column = column * 26 + (*p - 'A' + 1);
+        ++letters;
+        ++p;
+    }
+    if (letters < 1 || letters > 3)
+        return false;
+    if (p < end && *p == '$')
+        ++p;
+    if (p == end || end - p > 9)
+        return false;
+    int number = 0;
+    for (; p < end; ++p) {
+        if (*p < '0' || *p > '9')
+            return false;
+        number = number * 10 + (*p - '0');
+    }
+    *row = number;
+    *col = column;
+    return true;
+}
+
+// Offset of the first "<sheetData" start tag at or after from, -1 if none
+int findStartTag(const QByteArray &xml, int from)
+{
+    int begin = xml.indexOf("<sheetData", from);
+    while (begin >= 0) {
+        if (begin + 10 >= xml.size())
+            return -1; // can't tell yet whether the name goes on
+        const char next = xml.at(begin + 10);
+        if (next == '>' || next == '/' || isSpace(next))
+            return begin;
+        begin = xml.indexOf("<sheetData", begin + 1);
+    }
+    return -1;
+}
+
+} // namespace
+
+bool SheetDataReader::Span::operator==(const char *latin1) const
+{
+    const size_t length = std::strlen(latin1);
+    return begin && size_t(size()) == length && std::memcmp(begin, latin1, length) == 0;
+}
+
+SheetDataReader::SheetDataReader(WorksheetPrivate *sheet)
+    : m_sheet(sheet)
+    , m_scan(Scan::kernels())
+{
+}
+
+bool SheetDataReader::locate(const QByteArray &xml, Location *location)
+{
+    const int begin = findStartTag(xml, 0);
+    if (begin < 0)
+        return false;
+
+    const int open = xml.indexOf('>', begin);
+    if (open < 0 || xml.at(open - 1) == '/') // <sheetData/> has nothing to read
+        return false;
+    const int close = xml.indexOf("</sheetData", open);
+    if (close < 0)
+        return false;
+    const int end = xml.indexOf('>', close);
+    if (end < 0)
+        return false;
+
+    location->elementBegin = begin;
+    location->contentBegin = open + 1;
+    location->contentEnd   = close;
+    location->elementEnd   = end + 1;
+    return true;
+}
+
+bool SheetDataReader::read(const char *begin, const char *end)
+{
+    reset();
+    if (!feed(begin, end))
+        return false;
+    finish();
+    return true;
+}
+
+SheetDataReader::StreamResult SheetDataReader::readStream(QIODevice *device, QByteArray *xml)
+{
+    const qint64 chunkSize = 256 * 1024;
+
+    // Everything up to and including the <sheetData> start tag
+    QByteArray head;
+    int elementBegin = -1;
+    int contentBegin = -1;
+    for (int from = 0;;) {
+        elementBegin = findStartTag(head, from);
+        if (elementBegin >= 0) {
+            const int open = head.indexOf('>', elementBegin);
+            if (open >= 0) {
+                if (head.at(open - 1) == '/') { // <sheetData/>
+                    *xml = head + device->readAll();
+                    return StreamNoData;
+                }
+                contentBegin = open + 1;
+                break;
+            }
+            from = elementBegin;
+        } else {
+            from = qMax(0, int(head.size()) - 10);
+        }
+        const QByteArray chunk = device->read(chunkSize);
+        if (chunk.isEmpty()) {
+            *xml = head;
+            return StreamNoData;
+        }
+        head += chunk;
+    }
+
+    // Rows are parsed as soon as they are complete; a row cut by the end of
+    // a chunk waits in pending for the next one
+    QByteArray pending = head.mid(contentBegin);
+    head.truncate(elementBegin);
+    reset();
+    for (int from = 0;;) {
+        const int close = pending.indexOf("</sheetData", from);
+        if (close >= 0) {
+            if (!feed(pending.constData(), pending.constData() + close))
+                return StreamUnsupported;
+            pending.remove(0, close);
+            break;
+        }
+
+        int cut = pending.lastIndexOf("</row>");
+        if (cut >= 0) {
+            cut += 6;
+            if (!feed(pending.constData(), pending.constData() + cut))
+                return StreamUnsupported;
+            pending.remove(0, cut);
+        }
+
+        const QByteArray chunk = device->read(chunkSize);
+        if (chunk.isEmpty())
+            return StreamUnsupported; // truncated part
+        from = qMax(0, int(pending.size()) - 10);
+        pending += chunk;
+    }
+    finish();
+
+    // pending starts at </sheetData; the rest of the part is small
+    pending += device->readAll();
+    const int end = pending.indexOf('>');
+    if (end < 0)
+        return StreamUnsupported;
+    *xml = head + QByteArrayLiteral("<sheetData/>") + pending.mid(end + 1);
+    return StreamLoaded;
+}
+
+void SheetDataReader::reset()
+{
+    m_error = false;
+    m_row   = 0;
+    m_col   = 0;
+    m_sharedStringRefs.clear();
+
+    if (!m_sheet->loadArena)
+        m_sheet->loadArena = std::make_shared<Arena>();
+}
+
+// Parses whole rows in [begin, end); may be called repeatedly between
+// reset() and finish()
+bool SheetDataReader::feed(const char *begin, const char *end)
+{
+    m_p   = begin;
+    m_end = end;
+
+    // Malformed UTF-8 is left to QXmlStreamReader to report
+    if (!m_scan.isValidUtf8(begin, end))
+        return false;
+
+    while (skipToTag()) {
+        Span name;
+        bool isEnd = false;
+        if (!readStartTag(&name, &isEnd) || isEnd)
+            return false;
+        if (name == "row") {
+            if (!readRow())
+                return false;
+        } else {
+            bool selfClosing = false;
+            if (!skipAttributes(&selfClosing) || !skipElement(selfClosing))
+                return false;
+        }
+    }
+    return !m_error;
+}
+
+void SheetDataReader::finish()
+{
+    // Shared string references are counted per string and added in one go
+    SharedStrings *sst = m_sheet->sharedStrings();
+    for (size_t i = 0; i < m_sharedStringRefs.size(); ++i) {
+        if (m_sharedStringRefs[i] > 0)
+            sst->incRefByStringIndex(int(i), m_sharedStringRefs[i]);
+    }
+}
+
+bool SheetDataReader::readRow()
+{
+    Span r, spans, s, customFormat, customHeight, ht, hidden, outlineLevel, collapsed;
+    auto onAttribute = [&](const Span &name, const Span &value) {
+        if (name == "r")
+            r = value;
+        else if (name == "spans")
+            spans = value;
+        else if (name == "s")
+            s = value;
+        else if (name == "customFormat")
+            customFormat = value;
+        else if (name == "customHeight")
+            customHeight = value;
+        else if (name == "ht")
+            ht = value;
+        else if (name == "hidden")
+            hidden = value;
+        else if (name == "outlineLevel")
+            outlineLevel = value;
+        else if (name == "collapsed")
+            collapsed = value;
+    };
+    bool selfClosing = false;
+    if (!readAttributes(onAttribute, &selfClosing))
+        return false;
+
+    if (!customFormat.isNull() || !customHeight.isNull() || !hidden.isNull() ||
+        !outlineLevel.isNull() || !collapsed.isNull()) {
+
+        auto info =
+            std::allocate_shared<XlsxRowInfo>(ArenaAllocator<XlsxRowInfo>(m_sheet->loadArena));
+        if (!customFormat.isNull() && !s.isNull())
+            info->format = m_sheet->workbook->styles()->xfFormat(toInt(s));
+
+        if (!customHeight.isNull()) {
+            info->customHeight = customHeight == "1";
+            // Row height is only specified when customHeight is set
+            if (!ht.isNull())
+                info->height = toDouble(ht);
+            else
+                info->customHeight = false;
+        }
+
+        // both "hidden" and "collapsed" default are false
+        info->hidden    = hidden == "1";
+        info->collapsed = collapsed == "1";
+
+        if (!outlineLevel.isNull())
+            info->outlineLevel = toInt(outlineLevel);
+
+        //"r" is optional too.
+        if (!r.isNull())
+            m_sheet->rowsInfo[toInt(r)] = info;
+    }
+
+    m_row = r.isNull() ? m_row + 1 : toInt(r);
+    m_col = 0;
+
+    if (!spans.isNull()) {
+        const char *colon = m_scan.findByte(spans.begin, spans.end, ':');
+        if (colon != spans.end) {
+            Span first{spans.begin, colon};
+            Span last{colon + 1, spans.end};
+            const int columns = toInt(last) - toInt(first) + 1;
+            if (toInt(first) > 0 && columns > 0)
+                m_sheet->cellTable.reserveRow(m_row, columns);
+        }
+    }
+
+    if (selfClosing)
+        return true;
+
+    while (skipToTag()) {
+        Span name;
+        bool isEnd = false;
+        if (!readStartTag(&name, &isEnd))
+            return false;
+        if (isEnd)
+            return name == "row";
+        if (name == "c") {
+            if (!readCell())
+                return false;
+        } else {
+            bool childClosed = false;
+            if (!skipAttributes(&childClosed) || !skipElement(childClosed))
+                return false;
+        }
+    }
+    return false; // no </row>
+}
+
+bool SheetDataReader::readCell()
+{
+    Span r, s, t;
+    auto onAttribute = [&](const Span &name, const Span &value) {
+        if (name == "r")
+            r = value;
+        else if (name == "s")
+            s = value;
+        else if (name == "t")
+            t = value;
+    };
+    bool selfClosing = false;
+    if (!readAttributes(onAttribute, &selfClosing))
+        return false;
+
+    int row = -1;
+    int col = -1;
+    if (r.isNull() || r.size() == 0) {
+        row = m_row;
+        col = ++m_col;
+    } else if (!parseReference(r.begin, r.end, &row, &col)) {
+        row = col = -1; // dropped, as an invalid CellReference would be
+    }
+
+    const qint32 styleIndex = s.isNull() ? -1 : toInt(s);
+
+    Cell::CellType cellType = Cell::CustomType;
+    if (!t.isNull()) {
+        if (t == "s")
+            cellType = Cell::SharedStringType;
+        else if (t == "inlineStr")
+            cellType = Cell::InlineStringType;
+        else if (t == "str")
+            cellType = Cell::StringType;
+        else if (t == "b")
+            cellType = Cell::BooleanType;
+        else if (t == "e")
+            cellType = Cell::ErrorType;
+        else if (t == "d")
+            cellType = Cell::DateType;
+        else if (t == "n")
+            cellType = Cell::NumberType;
+    }
+
+    if ((cellType == Cell::NumberType || cellType == Cell::DateType ||
+         cellType == Cell::CustomType) &&
+        isDateStyle(styleIndex)) {
+        cellType = Cell::DateType;
+    }
+
+    bool hasValue   = false;
+    bool hasFormula = false;
+    bool hasInline  = false;
+    Span value;
+    CellFormula formula;
+    QString inlineText;
+
+    while (!selfClosing) {
+        if (!skipToTag())
+            return false;
+        const char *tagBegin = m_p;
+        Span name;
+        bool isEnd = false;
+        if (!readStartTag(&name, &isEnd))
+            return false;
+        if (isEnd) {
+            if (!(name == "c"))
+                return false;
+            break;
+        }
+
+        bool childClosed = false;
+        if (!skipAttributes(&childClosed))
+            return false;
+
+        if (name == "v") {
+            hasValue = true;
+            if (childClosed) {
+                value = Span{m_p, m_p};
+            } else if (!readText(&value) || !readEndTag("v")) {
+                return false;
+            }
+        } else if (name == "f") {
+            // Formulas are rare enough to hand to the generic reader
+            if (!skipElement(childClosed))
+                return false;
+            QXmlStreamReader reader(QByteArray::fromRawData(tagBegin, int(m_p - tagBegin)));
+            reader.readNextStartElement();
+            hasFormula = true;
+            formula.loadFromXml(reader);
+            if (formula.formulaType() == CellFormula::SharedType &&
+                !formula.formulaText().isEmpty()) {
+                int si                        = formula.sharedIndex();
+                m_sheet->sharedFormulaMap[si] = formula;
+            }
+        } else if (name == "is") {
+            if (!childClosed && !readInlineString(&inlineText, &hasInline))
+                return false;
+        } else if (!skipElement(childClosed)) {
+            return false;
+        }
+    }
+
+    // Plain values are stored inline; everything else gets a Cell
+    if (!hasFormula && !hasInline) {
+        CompactCell compact;
+        compact.index      = 0;
+        compact.styleIndex = styleIndex;
+        compact.cellType   = quint8(cellType);
+        compact.kind       = CompactCell::Full;
+
+        if (!hasValue) {
+            compact.kind = CompactCell::Blank;
+        } else if (cellType == Cell::SharedStringType) {
+            const int sst_idx = toInt(value);
+            countSharedString(sst_idx);
+            compact.kind  = CompactCell::SharedString;
+            compact.index = sst_idx;
+        } else if (cellType == Cell::NumberType || cellType == Cell::DateType) {
+            compact.kind   = CompactCell::Number;
+            compact.number = toDouble(value);
+        } else if (cellType == Cell::BooleanType) {
+            compact.kind    = CompactCell::Boolean;
+            compact.boolean = toInt(value) ? true : false;
+        } else if (cellType == Cell::ErrorType) {
+            const int code = CompactCell::errorCodeIndex(value.begin, value.size());
+            if (code >= 0) {
+                compact.kind  = CompactCell::Error;
+                compact.index = code;
+            }
+        } else if (cellType == Cell::CustomType) {
+            // Only if the text comes back unchanged when read
+            if (isPlainDecimal(value.begin, value.size())) {
+                compact.kind   = CompactCell::Number;
+                compact.number = toDouble(value);
+            }
+        }
+
+        if (compact.kind != CompactCell::Full) {
+            m_sheet->cellTable.setCompact(row, col, compact);
+            return true;
+        }
+    }
+
+    QString valueText;
+    if (hasValue && !decode(value, &valueText))
+        return false;
+    if (hasValue && cellType == Cell::SharedStringType)
+        countSharedString(toInt(value));
+
+    m_sheet->storeLoadedCell(row,
+                             col,
+                             cellType,
+                             styleIndex,
+                             formula,
+                             hasValue ? &valueText : nullptr,
+                             hasInline ? &inlineText : nullptr);
+    return true;
+}
+
+// Reads an <is> element up to </is>; like loadXmlSheetData(), the text of
+// the last <t> found anywhere inside wins
+bool SheetDataReader::readInlineString(QString *text, bool *found)
+{
+    while (skipToTag()) {
+        Span name;
+        bool isEnd = false;
+        if (!readStartTag(&name, &isEnd))
+            return false;
+        if (isEnd) {
+            if (name == "is")
+                return true;
+            continue;
+        }
+
+        bool selfClosing = false;
+        if (!skipAttributes(&selfClosing))
+            return false;
+        if (!(name == "t"))
+            continue;
+
+        *found = true;
+        if (selfClosing) {
+            text->clear();
+        } else {
+            Span span;
+            if (!readText(&span) || !readEndTag("t") || !decode(span, text))
+                return false;
+        }
+    }
+    return false;
+}
+
+// Moves to the next tag, skipping text and comments. False at the end of
+// the data, or on an error (m_error is set then).
+bool SheetDataReader::skipToTag()
+{
+    for (;;) {
+        m_p = m_scan.findByte(m_p, m_end, '<');
+        if (m_p == m_end)
+            return false;
+        if (m_end - m_p >= 4 && std::memcmp(m_p, "<!--", 4) == 0) {
+            const char *p = m_p + 4;
+            while (p + 3 <= m_end && std::memcmp(p, "-->", 3) != 0)
+                ++p;
+            if (p + 3 > m_end) {
+                m_error = true;
+                return false;
+            }
+            m_p = p + 3;
+            continue;
+        }
+        return true;
+    }
+}
+
+// At '<': reads the tag name. End tags are consumed up to their '>';
+// for start tags the attributes follow.
+bool SheetDataReader::readStartTag(Span *name, bool *isEnd)
+{
+    ++m_p;
+    if (m_p == m_end || *m_p == '!' || *m_p == '?') // CDATA, DTD or PI
+        return false;
+
+    *isEnd = *m_p == '/';
+    if (*isEnd)
+        ++m_p;
+
+    const char *begin = m_p;
+    while (m_p < m_end && !isSpace(*m_p) && *m_p != '/' && *m_p != '>') {
+        if (*m_p == ':') // namespace prefixes are left to QXmlStreamReader
+            return false;
+        ++m_p;
+    }
+    if (m_p == begin || m_p == m_end)
+        return false;
+    *name = Span{begin, m_p};
+
+    if (*isEnd) {
+        while (m_p < m_end && isSpace(*m_p))
+            ++m_p;
+        if (m_p == m_end || *m_p != '>')
+            return false;
+        ++m_p;
+    }
+    return true;
+}
+
+template<typename F>
+bool SheetDataReader::readAttributes(F onAttribute, bool *selfClosing)
+{
+    for (;;) {
+        while (m_p < m_end && isSpace(*m_p))
+            ++m_p;
+        if (m_p == m_end)
+            return false;
+        if (*m_p == '>') {
+            ++m_p;
+            *selfClosing = false;
+            return true;
+        }
+        if (*m_p == '/') {
+            if (m_end - m_p < 2 || m_p[1] != '>')
+                return false;
+            m_p += 2;
+            *selfClosing = true;
+            return true;
+        }
+
+        const char *nameBegin = m_p;
+        while (m_p < m_end && !isSpace(*m_p) && *m_p != '=')
+            ++m_p;
+        const Span name{nameBegin, m_p};
+        while (m_p < m_end && isSpace(*m_p))
+            ++m_p;
+        if (m_p == m_end || *m_p != '=')
+            return false;
+        ++m_p;
+        while (m_p < m_end && isSpace(*m_p))
+            ++m_p;
+        if (m_p == m_end || (*m_p != '"' && *m_p != '\''))
+            return false;
+
+        // Attributes here are numbers and names; entities mean something
+        // unusual is going on
+        const char quote     = *m_p++;
+        const char *valueEnd = m_scan.findEither(m_p, m_end, quote, '&');
+        if (valueEnd == m_end || *valueEnd != quote)
+            return false;
+        const Span value{m_p, valueEnd};
+        m_p = valueEnd + 1;
+
+        onAttribute(name, value);
+    }
+}
+
+bool SheetDataReader::skipAttributes(bool *selfClosing)
+{
+    return readAttributes([](const Span &, const Span &) {}, selfClosing);
+}
+
+bool SheetDataReader::readText(Span *text)
+{
+    const char *lt = m_scan.findByte(m_p, m_end, '<');
+    if (lt == m_end)
+        return false;
+    *text = Span{m_p, lt};
+    m_p   = lt;
+    return true;
+}
+
+bool SheetDataReader::readEndTag(const char *name)
+{
+    Span tag;
+    bool isEnd = false;
+    return m_p < m_end && *m_p == '<' && readStartTag(&tag, &isEnd) && isEnd && tag == name;
+}
+
+bool SheetDataReader::skipElement(bool selfClosing)
+{
+    int depth = selfClosing ? 0 : 1;
+    while (depth > 0) {
+        if (!skipToTag())
+            return false;
+        Span name;
+        bool isEnd = false;
+        if (!readStartTag(&name, &isEnd))
+            return false;
+        if (isEnd) {
+            --depth;
+            continue;
+        }
+        bool childClosed = false;
+        if (!skipAttributes(&childClosed))
+            return false;
+        if (!childClosed)
+            ++depth;
+    }
+    return true;
+}
+
+// Shared string references are only added to the table in finish(), so a
+// read that falls back to loadXmlSheetData() leaves no counts behind
+void SheetDataReader::countSharedString(int index)
+{
+    if (index < 0)
+        return;
+    if (size_t(index) >= m_sharedStringRefs.size())
+        m_sharedStringRefs.resize(size_t(index) + 1, 0);
+    ++m_sharedStringRefs[size_t(index)];
+}
+
+bool SheetDataReader::isDateStyle(int styleIndex)
+{
+    if (styleIndex < 0)
+        return false;
+    if (size_t(styleIndex) >= m_dateStyles.size())
+        m_dateStyles.resize(size_t(styleIndex) + 1, -1);
+
+    qint8 &known = m_dateStyles[size_t(styleIndex)];
+    if (known < 0) {
+        const Format format = m_sheet->workbook->styles()->xfFormat(styleIndex);
+        known               = Cell::isDateType(Cell::NumberType, format) ? 1 : 0;
+    }
+    return known == 1;
+}
+
+bool SheetDataReader::decode(const Span &text, QString *out) const
+{
+    return Scan::decodeText(text.begin, text.end, out);
+}
+
+// Like QString::toInt(): surrounding spaces allowed, 0 if not a number
+int SheetDataReader::toInt(const Span &span)
+{
+    const char *p   = span.begin;
+    const char *end = span.end;
+    while (p < end && isSpace(*p))
+        ++p;
+    while (end > p && isSpace(end[-1]))
+        --end;
+
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+    if (p == end)
+        return 0;
+
+    qint64 value = 0;
+    for (; p < end; ++p) {
+        if (*p < '0' || *p > '9')
+            return 0;
+        value = value * 10 + (*p - '0');
+        if (value > qint64(INT_MAX) + 1)
+            return 0;
+    }
+    if (negative)
+        value = -value;
+    return value > INT_MAX || value < INT_MIN ? 0 : int(value);
+}
+
+// Like QString::toDouble(): surrounding spaces allowed, 0 if not a number
+double SheetDataReader::toDouble(const Span &span)
+{
+    const char *p   = span.begin;
+    const char *end = span.end;
+    while (p < end && isSpace(*p))
+        ++p;
+    while (end > p && isSpace(end[-1]))
+        --end;
+    if (p == end)
+        return 0;
+
+#ifdef QXLSX_HAS_FLOAT_FROM_CHARS
+    {
+        const char *digits = p;
+        if (*digits == '+' && end - digits > 1 && digits[1] != '-')
+            ++digits;
+        double value      = 0;
+        const auto result = std::from_chars(digits, end, value);
+        if (result.ec == std::errc() && result.ptr == end)
+            return value;
+    }
+#endif
+
+    bool ok            = false;
+    const double value = QByteArray(p, int(end - p)).toDouble(&ok);
+    return ok ? value : 0;
+}
+
+QT_END_NAMESPACE_XLSX
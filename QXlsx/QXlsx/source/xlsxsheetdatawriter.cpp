@@ -0,0 +1,203 @@
+// xlsxsheetdatawriter.cpp
+
+#include "xlsxsheetdatawriter_p.h"
+
+#include "xlsxcellreference.h"
+
+#include <cstring>
+#include <vector>
+
+#include <QIODevice>
+#include <QLocale>
+#include <QXmlStreamWriter>
+
+#if defined(__has_include)
+#    if __has_include(<charconv>) &&                                                              \
+        (__cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L))
+#        include <charconv>
+#    endif
+#endif
+
+// Floating point std::to_chars is only in newer standard libraries
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+#    define QXLSX_HAS_FLOAT_TO_CHARS
+#endif
+
+QT_BEGIN_NAMESPACE_XLSX
+
+namespace {
+
+const int BufferSize = 64 * 1024;
+const int ColumnMax  = 16384;
+
+// Letters of a column number, at most three
+struct ColumnName {
+    char letters[3];
+    quint8 size;
+};
+
+const ColumnName *columnNames()
+{
+    static const std::vector<ColumnName> names = [] {
+        std::vector<ColumnName> table(ColumnMax + 1);
+        for (int column = 1; column <= ColumnMax; ++column) {
+            char reversed[3];
+            int size = 0;
+            for (int n = column; n > 0; n = (n - 1) / 26)
+                reversed[size++] = char('A' + (n - 1) % 26);
+            ColumnName &name = table[size_t(column)];
+            for (int i = 0; i < size; ++i)
+                name.letters[i] = reversed[size - 1 - i];
+            name.size = quint8(size);
+        }
+        return table;
+    }();
+    return names.data();
+}
+
+inline bool needsEscape(char c)
+{
+    return c == '<' || c == '>' || c == '&' || c == '"' || uchar(c) < 0x20;
+}
+
+} // namespace
+
+SheetDataWriter::SheetDataWriter(QXmlStreamWriter &writer)
+    : m_writer(writer)
+    , m_device(writer.device())
+    , m_buffer(BufferSize, Qt::Uninitialized)
+{
+    m_writer.writeCharacters(QString());
+}
+
+SheetDataWriter::~SheetDataWriter()
+{
+    flush();
+}
+
+void SheetDataWriter::append(const char *data, int size)
+{
+    if (m_size + size > m_buffer.size()) {
+        flush();
+        if (size > m_buffer.size()) {
+            if (!m_error && m_device->write(data, size) != size)
+                m_error = true;
+            return;
+        }
+    }
+    std::memcpy(m_buffer.data() + m_size, data, size_t(size));
+    m_size += size;
+}
+
+void SheetDataWriter::appendInteger(qint64 value)
+{
+    char digits[24];
+    char *end = digits + sizeof(digits);
+    char *p   = end;
+    quint64 n = value < 0 ? 0 - quint64(value) : quint64(value);
+    do {
+        *--p = char('0' + n % 10);
+        n /= 10;
+    } while (n);
+    if (value < 0)
+        *--p = '-';
+    append(p, int(end - p));
+}
+
+void SheetDataWriter::appendNumber(double value)
+{
+    // Whole numbers, the bulk of most sheets, need no float formatting
+    if (value > -1e15 && value < 1e15 && value == double(qint64(value))) {
+        appendInteger(qint64(value));
+        return;
+    }
+
+    // Plain notation where 'g' with 15 digits would use it
+    const double magnitude = value < 0 ? -value : value;
+    const bool fixed       = magnitude >= 1e-4 && magnitude < 1e15;
+#ifdef QXLSX_HAS_FLOAT_TO_CHARS
+    char text[64];
+    const std::to_chars_result result =
+        std::to_chars(text,
+                      text + sizeof(text),
+                      value,
+                      fixed ? std::chars_format::fixed : std::chars_format::general);
+    append(text, int(result.ptr - text));
+#else
+    const QByteArray text =
+        QByteArray::number(value, fixed ? 'f' : 'g', QLocale::FloatingPointShortest);
+    append(text.constData(), text.size());
+#endif
+}
+
+void SheetDataWriter::appendCellReference(int row, int column)
+{
+    if (column < 1 || column > ColumnMax) {
+        const QByteArray text = CellReference(row, column).toString().toLatin1();
+        append(text.constData(), text.size());
+        return;
+    }
+    const ColumnName &name = columnNames()[column];
+    append(name.letters, name.size);
+    appendInteger(row);
+}
+
+void SheetDataWriter::appendEscaped(const QString &text)
+{
+    const QByteArray utf8 = text.toUtf8();
+    const char *p         = utf8.constData();
+    const char *end       = p + utf8.size();
+    while (p < end) {
+        const char *run = p;
+        while (p < end && !needsEscape(*p))
+            ++p;
+        append(run, int(p - run));
+        if (p == end)
+            break;
+
+        switch (*p) {
+        case '<':
+            append("&lt;");
+            break;
+        case '>':
+            append("&gt;");
+            break;
+        case '&':
+            append("&amp;");
+            break;
+        case '"':
+            append("&quot;");
+            break;
+        case '\r':
+            append("&#13;");
+            break;
+        case '\t':
+        case '\n':
+            append(p, 1);
+            break;
+        default: // not allowed in XML 1.0
+            break;
+        }
+        ++p;
+    }
+}
+
+QXmlStreamWriter &SheetDataWriter::xmlWriter()
+{
+    flush();
+    return m_writer;
+}
+
+void SheetDataWriter::flush()
+{
+    if (m_size > 0 && !m_error && m_device->write(m_buffer.constData(), m_size) != m_size)
+        m_error = true;
+    m_size = 0;
+}
+
+bool SheetDataWriter::hasError() const
+{
+    return m_error || m_writer.hasError();
+}
+
+QT_END_NAMESPACE_XLSX
@@ -64,7 +64,7 @@ Styles::Styles(CreateFlag flag)
         Format fillFmt;
         fillFmt.setFillPattern(Format::PatternGray125);
         m_fillsList.append(fillFmt);
-        m_fillsHash.insert(fillFmt.fillKey(), fillFmt);
+        m_fillsHash.insert(key(fillFmt, FormatPrivate::FillKey), fillFmt);
     }
 }
 
@@ -195,6 +195,14 @@ void Styles::fixNumFmt(const Format &format)
     }
 }
 
+const FormatKey &Styles::key(const Format &format, FormatPrivate::KeyGroup group)
+{
+    static const FormatKey emptyKey;
+    if (!format.d)
+        return emptyKey;
+    return format.d->key(group);
+}
+
 /*
    Assign index to Font/Fill/Border and Format
 
@@ -204,6 +212,11 @@ void Styles::fixNumFmt(const Format &format)
 */
 void Styles::addXfFormat(const Format &format, bool force)
 {
+    // Added already, as when every cell of a sheet is written with one Format
+    if (!force && format.xfIndexValid() && format.xfIndex() < m_xf_formatsList.size() &&
+        m_xf_formatsList[format.xfIndex()].d == format.d)
+        return;
+
     if (format.isEmpty()) {
         // Try do something for empty Format.
         if (m_emptyFormatAdded && !force)
@@ -218,7 +231,7 @@ void Styles::addXfFormat(const Format &format, bool force)
     }
 
     // Font
-    const auto &fontIt = m_fontsHash.constFind(format.fontKey());
+    const auto &fontIt = m_fontsHash.constFind(key(format, FormatPrivate::FontKey));
     if (format.hasFontData() && !format.fontIndexValid()) {
         // Assign proper font index, if has font data.
         if (fontIt == m_fontsHash.constEnd())
@@ -229,11 +242,11 @@ void Styles::addXfFormat(const Format &format, bool force)
     if (fontIt == m_fontsHash.constEnd()) {
         // Still a valid font if the format has no fontData. (All font properties are default)
         m_fontsList.append(format);
-        m_fontsHash[format.fontKey()] = format;
+        m_fontsHash[key(format, FormatPrivate::FontKey)] = format;
     }
 
     // Fill
-    const auto &fillIt = m_fillsHash.constFind(format.fillKey());
+    const auto &fillIt = m_fillsHash.constFind(key(format, FormatPrivate::FillKey));
     if (format.hasFillData() && !format.fillIndexValid()) {
         // Assign proper fill index, if has fill data.
         if (fillIt == m_fillsHash.constEnd())
@@ -244,11 +257,11 @@ void Styles::addXfFormat(const Format &format, bool force)
     if (fillIt == m_fillsHash.constEnd()) {
         // Still a valid fill if the format has no fillData. (All fill properties are default)
         m_fillsList.append(format);
-        m_fillsHash[format.fillKey()] = format;
+        m_fillsHash[key(format, FormatPrivate::FillKey)] = format;
     }
 
     // Border
-    const auto &borderIt = m_bordersHash.constFind(format.borderKey());
+    const auto &borderIt = m_bordersHash.constFind(key(format, FormatPrivate::BorderKey));
     if (format.hasBorderData() && !format.borderIndexValid()) {
         // Assign proper border index, if has border data.
         if (borderIt == m_bordersHash.constEnd())
@@ -259,11 +272,11 @@ void Styles::addXfFormat(const Format &format, bool force)
     if (borderIt == m_bordersHash.constEnd()) {
         // Still a valid border if the format has no borderData. (All border properties are default)
         m_bordersList.append(format);
-        m_bordersHash[format.borderKey()] = format;
+        m_bordersHash[key(format, FormatPrivate::BorderKey)] = format;
     }
 
     // Format
-    const auto &formatIt = m_xf_formatsHash.constFind(format.formatKey());
+    const auto &formatIt = m_xf_formatsHash.constFind(key(format, FormatPrivate::XfKey));
     if (!format.isEmpty() && !format.xfIndexValid()) {
         if (formatIt == m_xf_formatsHash.constEnd())
             const_cast<Format *>(&format)->setXfIndex(m_xf_formatsList.size());
@@ -273,7 +286,7 @@ void Styles::addXfFormat(const Format &format, bool force)
 
     if (formatIt == m_xf_formatsHash.constEnd() || force) {
         m_xf_formatsList.append(format);
-        m_xf_formatsHash[format.formatKey()] = format;
+        m_xf_formatsHash[key(format, FormatPrivate::XfKey)] = format;
     }
 }
 
@@ -284,7 +297,7 @@ void Styles::addDxfFormat(const Format &format, bool force)
         fixNumFmt(format);
     }
 
-    const auto &formatIt = m_dxf_formatsHash.constFind(format.formatKey());
+    const auto &formatIt = m_dxf_formatsHash.constFind(key(format, FormatPrivate::XfKey));
     if (!format.isEmpty() && !format.dxfIndexValid()) {
         if (formatIt == m_dxf_formatsHash.constEnd()) // m_xf_formatsHash.constEnd()) // issue #108
         {
@@ -296,7 +309,7 @@ void Styles::addDxfFormat(const Format &format, bool force)
 
     if (formatIt == m_dxf_formatsHash.constEnd() || force) {
         m_dxf_formatsList.append(format);
-        m_dxf_formatsHash[format.formatKey()] = format;
+        m_dxf_formatsHash[key(format, FormatPrivate::XfKey)] = format;
     }
 }
 
@@ -835,7 +848,7 @@ bool Styles::readFonts(QXmlStreamReader &reader)
                 Format format;
                 readFont(reader, format);
                 m_fontsList.append(format);
-                m_fontsHash.insert(format.fontKey(), format);
+                m_fontsHash.insert(key(format, FormatPrivate::FontKey), format);
                 if (format.isValid())
                     format.setFontIndex(m_fontsList.size() - 1);
             }
@@ -961,7 +974,7 @@ bool Styles::readFills(QXmlStreamReader &reader)
                 Format fill;
                 readFill(reader, fill);
                 m_fillsList.append(fill);
-                m_fillsHash.insert(fill.fillKey(), fill);
+                m_fillsHash.insert(key(fill, FormatPrivate::FillKey), fill);
                 if (fill.isValid())
                     fill.setFillIndex(m_fillsList.size() - 1);
             }
@@ -1060,7 +1073,7 @@ bool Styles::readBorders(QXmlStreamReader &reader)
                 Format border;
                 readBorder(reader, border);
                 m_bordersList.append(border);
-                m_bordersHash.insert(border.borderKey(), border);
+                m_bordersHash.insert(key(border, FormatPrivate::BorderKey), border);
                 if (border.isValid())
                     border.setBorderIndex(m_bordersList.size() - 1);
             }
@@ -17,6 +17,8 @@
 #include "xlsxformat_p.h"
 #include "xlsxrichstring.h"
 #include "xlsxsharedstrings_p.h"
+#include "xlsxsheetdatareader_p.h"
+#include "xlsxsheetdatawriter_p.h"
 #include "xlsxstyles_p.h"
 #include "xlsxutility_p.h"
 #include "xlsxworkbook.h"
@@ -52,8 +54,81 @@ namespace {
 const int XLSX_ROW_MAX    = 1048576;
 const int XLSX_COLUMN_MAX = 16384;
 const int XLSX_STRING_MAX = 32767;
+
+// Error values a compact cell can refer to by index
+const char *const XLSX_ERROR_CODES[] = {
+    "#NULL!", "#DIV/0!", "#VALUE!", "#REF!", "#NAME?", "#NUM!", "#N/A", "#GETTING_DATA"};
+const int XLSX_ERROR_CODE_COUNT = int(sizeof(XLSX_ERROR_CODES) / sizeof(XLSX_ERROR_CODES[0]));
+
+// Parses an A1 style reference ("$" allowed) without copying it
+template<typename View>
+bool parseCellReference(const View &r, int *row, int *col)
+{
+    int i = 0;
+    if (i < r.size() && r.at(i) == QLatin1Char('$'))
+        ++i;
+    int column = 0;
+    int letters = 0;
+    while (i < r.size() && r.at(i) >= QLatin1Char('A') && r.at(i) <= QLatin1Char('Z')) {
+        column = column * 26 + (r.at(i).unicode() - 'A' + 1);
+        ++letters;
+        ++i;
+    }
+    if (letters < 1 || letters > 3)
+        return false;
+    if (i < r.size() && r.at(i) == QLatin1Char('$'))
+        ++i;
+    if (i == r.size())
+        return false;
+    int number = 0;
+    for (; i < r.size(); ++i) {
+        const ushort digit = r.at(i).unicode() - '0';
+        if (digit > 9)
+            return false;
+        number = number * 10 + digit;
+    }
+    *row = number;
+    *col = column;
+    return true;
+}
+
+// Number of columns in a row's spans attribute ("1:7"), 0 if unknown
+template<typename View>
+int spanColumns(const View &spans)
+{
+    const int colon = int(spans.indexOf(QLatin1Char(':')));
+    if (colon <= 0)
+        return 0;
+    const int first = spans.left(colon).toInt();
+    const int last  = spans.mid(colon + 1).toInt();
+    return last >= first && first > 0 ? last - first + 1 : 0;
+}
 } // namespace
 
+QString CompactCell::errorCode(int index)
+{
+    Q_ASSERT(index >= 0 && index < XLSX_ERROR_CODE_COUNT);
+    return QString::fromLatin1(XLSX_ERROR_CODES[index]);
+}
+
+int CompactCell::errorCodeIndex(const QString &text)
+{
+    for (int i = 0; i < XLSX_ERROR_CODE_COUNT; ++i) {
+        if (text == QLatin1String(XLSX_ERROR_CODES[i]))
+            return i;
+    }
+    return -1;
+}
+
+int CompactCell::errorCodeIndex(const char *text, int size)
+{
+    for (int i = 0; i < XLSX_ERROR_CODE_COUNT; ++i) {
+        if (QLatin1String(text, size) == QLatin1String(XLSX_ERROR_CODES[i]))
+            return i;
+    }
+    return -1;
+}
+
 WorksheetPrivate::WorksheetPrivate(Worksheet *p, Worksheet::CreateFlag flag)
     : AbstractSheetPrivate(p, flag)
     , windowProtection(false)
@@ -78,55 +153,42 @@ WorksheetPrivate::~WorksheetPrivate()
   Calculate the "spans" attribute of the <row> tag. This is an
   XLSX optimisation and isn't strictly required. However, it
   makes comparing files easier. The span is the same for each
-  block of 16 rows.
+  block of 16 rows, rows 1-16 being block 0. Only the rows of the
+  block are looked at, and only their cells and comments, so this
+  costs the same for a sparse sheet as for a dense one.
+  Returns false if the block has neither.
  */
-void WorksheetPrivate::calculateSpans() const
+bool WorksheetPrivate::calculateSpan(int block, int *first, int *last) const
 {
-    row_spans.clear();
     int span_min = XLSX_COLUMN_MAX + 1;
     int span_max = -1;
 
-    for (int row_num = dimension.firstRow(); row_num <= dimension.lastRow(); row_num++) {
-        for (int col_num = dimension.firstColumn(); col_num <= dimension.lastColumn(); col_num++) {
-            if (cellTable.contains(row_num, col_num)) {
-                if (span_max == -1) {
-                    span_min = col_num;
-                    span_max = col_num;
-                } else {
-                    if (col_num < span_min)
-                        span_min = col_num;
-                    else if (col_num > span_max)
-                        span_max = col_num;
-                }
-            }
+    const int firstRow = qMax(block * 16 + 1, dimension.firstRow());
+    const int lastRow  = qMin(block * 16 + 16, dimension.lastRow());
+    for (int row_num = firstRow; row_num <= lastRow; row_num++) {
+        // Cells are in column order
+        if (const CellTable::Row *cells = cellTable.findRow(row_num)) {
+            span_min = qMin(span_min, int(cells->front().column));
+            span_max = qMax(span_max, int(cells->back().column));
         }
 
         auto cIt = comments.constFind(row_num);
         if (cIt != comments.constEnd()) {
-            for (int col_num = dimension.firstColumn(); col_num <= dimension.lastColumn();
-                 col_num++) {
-                if (cIt->contains(col_num)) {
-                    if (span_max == -1) {
-                        span_min = col_num;
-                        span_max = col_num;
-                    } else {
-                        if (col_num < span_min)
-                            span_min = col_num;
-                        else if (col_num > span_max)
-                            span_max = col_num;
-                    }
-                }
-            }
-        }
-
-        if (row_num % 16 == 0 || row_num == dimension.lastRow()) {
-            if (span_max != -1) {
-                row_spans[row_num / 16] = QStringLiteral("%1:%2").arg(span_min).arg(span_max);
-                span_min                = XLSX_COLUMN_MAX + 1;
-                span_max                = -1;
+            for (auto it = cIt->constBegin(); it != cIt->constEnd(); ++it) {
+                span_min = qMin(span_min, it.key());
+                span_max = qMax(span_max, it.key());
             }
         }
     }
+
+    // Within the dimension, like the cells written
+    span_min = qMax(span_min, dimension.firstColumn());
+    span_max = qMin(span_max, dimension.lastColumn());
+    if (span_max < span_min)
+        return false;
+    *first = span_min;
+    *last  = span_max;
+    return true;
 }
 
 QString WorksheetPrivate::generateDimensionString() const
@@ -198,20 +260,24 @@ Worksheet *Worksheet::copy(const QString &distName, int distId) const
 
     sheet_d->dimension = d->dimension;
 
-    for (auto it = d->cellTable.cells.begin(); it != d->cellTable.cells.end(); ++it) {
-        int row = it.key();
-        for (auto it2 = it.value().begin(); it2 != it.value().end(); ++it2) {
-            int col = it2.key();
+    d->cellTable.forEachRow([&](int row, const CellTable::Row &cells) {
+        for (const CellTable::Entry &entry : cells) {
+            if (entry.kind != CompactCell::Full) {
+                if (entry.kind == CompactCell::SharedString)
+                    d->workbook->sharedStrings()->incRefByStringIndex(entry.index);
+                sheet_d->cellTable.setCompact(row, entry.column, entry);
+                continue;
+            }
 
-            auto cell           = std::make_shared<Cell>(it2.value().get());
+            auto cell           = std::make_shared<Cell>(d->cellTable.fullCell(entry).get());
             cell->d_ptr->parent = sheet;
 
             if (cell->cellType() == Cell::SharedStringType)
                 d->workbook->sharedStrings()->addSharedString(cell->d_ptr->richString);
 
-            sheet_d->cellTable.setValue(row, col, cell);
+            sheet_d->cellTable.setValue(row, entry.column, cell);
         }
-    }
+    });
 
     // for (auto it = d->cellTable.cells.begin(); it != d->cellTable.cells.end(); ++it) {
     //     auto cell           = std::make_shared<Cell>(it.value().get());
@@ -503,6 +569,128 @@ bool Worksheet::write(const CellReference &row_column, const QVariant &value, co
     return write(row_column.row(), row_column.column(), value, format);
 }
 
+/*!
+ * Writes \a values to the row below the last one holding data, starting at
+ * column 1, all with the \a format. Null values leave their cell empty.
+ *
+ * On a sheet of a document in write-only mode (see
+ * Document::beginWriteOnly()) the row is written to the package right away
+ * and isn't kept, so it can't be read back afterwards.
+ *
+ * Returns true on success.
+ */
+bool Worksheet::appendRow(const QList<QVariant> &values, const Format &format)
+{
+    Q_D(Worksheet);
+
+    const int row = qMax(d->dimension.lastRow(), d->appendedRow) + 1;
+    if (row > XLSX_ROW_MAX)
+        return false;
+    d->appendedRow = row;
+
+    bool ret = true;
+    for (int i = 0; i < values.size(); ++i) {
+        if (!values[i].isNull() || !format.isEmpty())
+            ret = write(row, i + 1, values[i], format) && ret;
+    }
+
+    if (d->streamWriter)
+        ret = d->streamRows(row) && ret;
+    return ret;
+}
+
+/*!
+ * Writes \a count \a values to row \a row, from column \a column on, all with
+ * the \a format; without a valid format cells keep the one they had.
+ *
+ * Unlike write(), there is no dispatch on the type of each value: strings
+ * are stored as they are, as shared strings, and never taken for formulas,
+ * hyperlinks, numbers or rich text. The bounds, the dimension and the
+ * format are checked once for the whole row, and cells are stored without
+ * a Cell object, so this is the way to fill large sheets.
+ *
+ * Returns true on success, false if any of the cells is out of range, in
+ * which case nothing is written.
+ *
+ * \sa CellValue
+ */
+bool Worksheet::writeRow(int row,
+                         int column,
+                         const CellValue *values,
+                         int count,
+                         const Format &format)
+{
+    Q_D(Worksheet);
+    if (count < 1)
+        return count == 0;
+    if (row < 1 || row > XLSX_ROW_MAX || column < 1 || count > XLSX_COLUMN_MAX ||
+        column > XLSX_COLUMN_MAX - count + 1)
+        return false;
+    d->checkDimensions(row, column);
+    d->checkDimensions(row, column + count - 1);
+
+    qint32 styleIndex = -1;
+    if (format.isValid()) {
+        Format fmt = format;
+        d->workbook->styles()->addXfFormat(fmt);
+        styleIndex = fmt.xfIndex();
+    }
+
+    SharedStrings *sharedStrings = d->sharedStrings();
+    for (int i = 0; i < count; ++i) {
+        const int col = column + i;
+
+        CompactCell cell;
+        cell.number     = 0;
+        cell.styleIndex = styleIndex;
+        if (!format.isValid()) {
+            const CompactCell *entry = d->cellTable.find(row, col);
+            if (entry && entry->kind == CompactCell::Full) {
+                Format fmt = d->cellTable.fullCell(*entry)->format();
+                d->workbook->styles()->addXfFormat(fmt);
+                cell.styleIndex = fmt.xfIndex();
+            } else if (entry) {
+                cell.styleIndex = entry->styleIndex;
+            }
+        }
+
+        const CellValue &value = values[i];
+        switch (value.type()) {
+        case CellValue::Number:
+            cell.kind     = CompactCell::Number;
+            cell.number   = value.number();
+            cell.cellType = Cell::NumberType;
+            break;
+        case CellValue::String:
+            cell.kind     = CompactCell::SharedString;
+            cell.index    = sharedStrings->addSharedString(value.string());
+            cell.cellType = Cell::SharedStringType;
+            break;
+        default:
+            // Like writeBlank(): a number cell without a value
+            cell.kind     = CompactCell::Blank;
+            cell.cellType = Cell::NumberType;
+            break;
+        }
+        d->cellTable.setCompact(row, col, cell);
+    }
+
+    return true;
+}
+
+/*!
+ * \overload
+ * Writes \a values to row \a row, from column \a column on, with the
+ * \a format.
+ */
+bool Worksheet::writeRow(int row,
+                         int column,
+                         const QVector<CellValue> &values,
+                         const Format &format)
+{
+    return writeRow(row, column, values.constData(), int(values.size()), format);
+}
+
 /*!
         \overload
         Return the contents of the cell \a row_column.
@@ -571,19 +759,101 @@ std::shared_ptr<Cell> Worksheet::cellAt(const CellReference &row_column) const
 std::shared_ptr<Cell> Worksheet::cellAt(int row, int col) const
 {
     Q_D(const Worksheet);
-    return d->cellTable.cellAt(row, col);
+    return d->cellAt(row, col);
 }
 
 Format WorksheetPrivate::cellFormat(int row, int col) const
 {
-    auto cell = cellTable.cellAt(row, col);
-    if (cell) {
-        return cell->format();
-    }
+    const CompactCell *entry = cellTable.find(row, col);
+    if (!entry)
+        return {};
 
+    if (entry->kind == CompactCell::Full)
+        return cellTable.fullCell(*entry)->format();
+    if (entry->styleIndex >= 0)
+        return workbook->styles()->xfFormat(entry->styleIndex);
     return {};
 }
 
+/*!
+ * \internal
+ * Cells loaded with a plain value are stored compactly; for those the
+ * returned Cell is built on demand and changing it does not change the
+ * sheet. Use mutableCellAt() to modify a cell in place.
+ */
+std::shared_ptr<Cell> WorksheetPrivate::cellAt(int row, int col) const
+{
+    const CompactCell *entry = cellTable.find(row, col);
+    if (!entry)
+        return {};
+    return materializeCell(*entry);
+}
+
+/*!
+ * \internal
+ * Returns the cell stored at (\a row, \a col), turning a compact cell into
+ * a full one so that changes made through the pointer are kept.
+ */
+std::shared_ptr<Cell> WorksheetPrivate::mutableCellAt(int row, int col)
+{
+    const CompactCell *entry = cellTable.find(row, col);
+    if (!entry)
+        return {};
+    if (entry->kind == CompactCell::Full)
+        return cellTable.fullCell(*entry);
+
+    auto cell = materializeCell(*entry);
+    cellTable.setValue(row, col, cell);
+    return cell;
+}
+
+std::shared_ptr<Cell> WorksheetPrivate::materializeCell(const CompactCell &entry) const
+{
+    if (entry.kind == CompactCell::Full)
+        return cellTable.fullCell(entry);
+
+    Q_Q(const Worksheet);
+
+    Format format;
+    if (entry.styleIndex >= 0)
+        format = workbook->styles()->xfFormat(entry.styleIndex);
+
+    auto cell = std::make_shared<Cell>(QVariant{},
+                                       Cell::CellType(entry.cellType),
+                                       format,
+                                       const_cast<Worksheet *>(q),
+                                       entry.styleIndex);
+    CellPrivate *cd = cell->d_ptr;
+
+    switch (entry.kind) {
+    case CompactCell::Number:
+        // Untyped cells keep their value as text; the loader only stores
+        // them compactly when this gives back the text it read
+        if (entry.cellType == Cell::CustomType)
+            cd->value = QString::number(entry.number, 'g', 15);
+        else
+            cd->value = entry.number;
+        break;
+    case CompactCell::SharedString: {
+        RichString rs = sharedStrings()->getSharedString(entry.index);
+        cd->value     = rs.toPlainString();
+        if (rs.isRichString())
+            cd->richString = rs;
+        break;
+    }
+    case CompactCell::Boolean:
+        cd->value = entry.boolean;
+        break;
+    case CompactCell::Error:
+        cd->value = CompactCell::errorCode(entry.index);
+        break;
+    default:
+        break;
+    }
+
+    return cell;
+}
+
 /*!
   \overload
   Write string \a value to the cell \a row_column with the \a format.
@@ -789,7 +1059,7 @@ bool Worksheet::writeFormula(int row,
         for (int r = range.firstRow(); r <= range.lastRow(); ++r) {
             for (int c = range.firstColumn(); c <= range.lastColumn(); ++c) {
                 if (!(r == row && c == column)) {
-                    if (auto cell = cellAt(r, c)) {
+                    if (auto cell = d->mutableCellAt(r, c)) {
                         cell->d_ptr->formula = sf;
                     } else {
                         auto newCell = std::make_shared<Cell>(result, Cell::NumberType, fmt, this);
@@ -1228,7 +1498,7 @@ bool Worksheet::mergeCells(const CellRange &range, const Format &format)
     for (int row = range.firstRow(); row <= range.lastRow(); ++row) {
         for (int col = range.firstColumn(); col <= range.lastColumn(); ++col) {
             if (row == range.firstRow() && col == range.firstColumn()) {
-                auto cell = cellAt(row, col);
+                auto cell = d->mutableCellAt(row, col);
                 if (cell) {
                     if (format.isValid())
                         cell->d_ptr->format = format;
@@ -1287,6 +1557,23 @@ void Worksheet::saveToXmlFile(QIODevice *device) const
 
     QXmlStreamWriter writer(device);
 
+    d->saveXmlSheetHead(writer, true);
+
+    writer.writeStartElement(QStringLiteral("sheetData"));
+    if (d->dimension.isValid())
+        d->saveXmlSheetData(writer);
+    writer.writeEndElement(); // sheetData
+
+    d->saveXmlSheetTail(writer);
+}
+
+/*!
+ * \internal
+ * Writes the worksheet up to <sheetData>. Write-only sheets leave out the
+ * dimension, which isn't known before their rows have been written.
+ */
+void WorksheetPrivate::saveXmlSheetHead(QXmlStreamWriter &writer, bool withDimension) const
+{
     writer.writeStartDocument(QStringLiteral("1.0"), true);
     writer.writeStartElement(QStringLiteral("worksheet"));
     writer.writeAttribute(
@@ -1303,31 +1590,33 @@ void Worksheet::saveToXmlFile(QIODevice *device) const
     //     "http://schemas.microsoft.com/office/spreadsheetml/2009/9/ac");
     //     writer.writeAttribute("mc:Ignorable", "x14ac");
 
-    writer.writeStartElement(QStringLiteral("dimension"));
-    writer.writeAttribute(QStringLiteral("ref"), d->generateDimensionString());
-    writer.writeEndElement(); // dimension
+    if (withDimension) {
+        writer.writeStartElement(QStringLiteral("dimension"));
+        writer.writeAttribute(QStringLiteral("ref"), generateDimensionString());
+        writer.writeEndElement(); // dimension
+    }
 
     writer.writeStartElement(QStringLiteral("sheetViews"));
     writer.writeStartElement(QStringLiteral("sheetView"));
-    if (d->windowProtection)
+    if (windowProtection)
         writer.writeAttribute(QStringLiteral("windowProtection"), QStringLiteral("1"));
-    if (d->showFormulas)
+    if (showFormulas)
         writer.writeAttribute(QStringLiteral("showFormulas"), QStringLiteral("1"));
-    if (!d->showGridLines)
+    if (!showGridLines)
         writer.writeAttribute(QStringLiteral("showGridLines"), QStringLiteral("0"));
-    if (!d->showRowColHeaders)
+    if (!showRowColHeaders)
         writer.writeAttribute(QStringLiteral("showRowColHeaders"), QStringLiteral("0"));
-    if (!d->showZeros)
+    if (!showZeros)
         writer.writeAttribute(QStringLiteral("showZeros"), QStringLiteral("0"));
-    if (d->rightToLeft)
+    if (rightToLeft)
         writer.writeAttribute(QStringLiteral("rightToLeft"), QStringLiteral("1"));
-    if (d->tabSelected)
+    if (tabSelected)
         writer.writeAttribute(QStringLiteral("tabSelected"), QStringLiteral("1"));
-    if (!d->showRuler)
+    if (!showRuler)
         writer.writeAttribute(QStringLiteral("showRuler"), QStringLiteral("0"));
-    if (!d->showOutlineSymbols)
+    if (!showOutlineSymbols)
         writer.writeAttribute(QStringLiteral("showOutlineSymbols"), QStringLiteral("0"));
-    if (!d->showWhiteSpace)
+    if (!showWhiteSpace)
         writer.writeAttribute(QStringLiteral("showWhiteSpace"), QStringLiteral("0"));
     writer.writeAttribute(QStringLiteral("workbookViewId"), QStringLiteral("0"));
     writer.writeEndElement(); // sheetView
@@ -1335,22 +1624,22 @@ void Worksheet::saveToXmlFile(QIODevice *device) const
 
     writer.writeStartElement(QStringLiteral("sheetFormatPr"));
     writer.writeAttribute(QStringLiteral("defaultRowHeight"),
-                          QString::number(d->sheetFormatProps.defaultRowHeight));
+                          QString::number(sheetFormatProps.defaultRowHeight));
     writer.writeAttribute(QStringLiteral("customHeight"),
-                          xsdBoolean(d->sheetFormatProps.customHeight));
-    writer.writeAttribute(QStringLiteral("zeroHeight"), xsdBoolean(d->sheetFormatProps.zeroHeight));
+                          xsdBoolean(sheetFormatProps.customHeight));
+    writer.writeAttribute(QStringLiteral("zeroHeight"), xsdBoolean(sheetFormatProps.zeroHeight));
     writer.writeAttribute(QStringLiteral("outlineLevelRow"),
-                          QString::number(d->sheetFormatProps.outlineLevelRow));
+                          QString::number(sheetFormatProps.outlineLevelRow));
     writer.writeAttribute(QStringLiteral("outlineLevelCol"),
-                          QString::number(d->sheetFormatProps.outlineLevelCol));
+                          QString::number(sheetFormatProps.outlineLevelCol));
     // for Excel 2010
     //     writer.writeAttribute("x14ac:dyDescent", "0.25");
     writer.writeEndElement(); // sheetFormatPr
 
-    if (!d->colsInfo.isEmpty()) {
+    if (!colsInfo.isEmpty()) {
         writer.writeStartElement(QStringLiteral("cols"));
 
-        for (auto it = d->colsInfo.begin(); it != d->colsInfo.end(); ++it) {
+        for (auto it = colsInfo.begin(); it != colsInfo.end(); ++it) {
             std::shared_ptr<XlsxColumnInfo> col_info = it.value();
             writer.writeStartElement(QStringLiteral("col"));
             writer.writeAttribute(QStringLiteral("min"), QString::number(col_info->firstColumn));
@@ -1374,16 +1663,18 @@ void Worksheet::saveToXmlFile(QIODevice *device) const
         }
         writer.writeEndElement(); // cols
     }
+}
 
-    writer.writeStartElement(QStringLiteral("sheetData"));
-    if (d->dimension.isValid())
-        d->saveXmlSheetData(writer);
-    writer.writeEndElement(); // sheetData
-
-    d->saveXmlMergeCells(writer);
-    for (const ConditionalFormatting &cf : d->conditionalFormattingList)
+/*!
+ * \internal
+ * Writes what follows </sheetData>, to the end of the worksheet.
+ */
+void WorksheetPrivate::saveXmlSheetTail(QXmlStreamWriter &writer) const
+{
+    saveXmlMergeCells(writer);
+    for (const ConditionalFormatting &cf : conditionalFormattingList)
         cf.saveToXml(writer);
-    d->saveXmlDataValidations(writer);
+    saveXmlDataValidations(writer);
 
     //{{ liufeijin :  write  pagesettings  add by liufeijin 20181028
 
@@ -1391,86 +1682,86 @@ void Worksheet::saveToXmlFile(QIODevice *device) const
     // NOTE: empty element is not problem. but, empty structure of element is not parsed by Excel.
 
     // pageMargins
-    if (false == d->PMleft.isEmpty() && false == d->PMright.isEmpty() &&
-        false == d->PMtop.isEmpty() && false == d->PMbotton.isEmpty() &&
-        false == d->PMheader.isEmpty() && false == d->PMfooter.isEmpty()) {
+    if (false == PMleft.isEmpty() && false == PMright.isEmpty() &&
+        false == PMtop.isEmpty() && false == PMbotton.isEmpty() &&
+        false == PMheader.isEmpty() && false == PMfooter.isEmpty()) {
         writer.writeStartElement(QStringLiteral("pageMargins"));
 
-        writer.writeAttribute(QStringLiteral("left"), d->PMleft);
-        writer.writeAttribute(QStringLiteral("right"), d->PMright);
-        writer.writeAttribute(QStringLiteral("top"), d->PMtop);
-        writer.writeAttribute(QStringLiteral("bottom"), d->PMbotton);
-        writer.writeAttribute(QStringLiteral("header"), d->PMheader);
-        writer.writeAttribute(QStringLiteral("footer"), d->PMfooter);
+        writer.writeAttribute(QStringLiteral("left"), PMleft);
+        writer.writeAttribute(QStringLiteral("right"), PMright);
+        writer.writeAttribute(QStringLiteral("top"), PMtop);
+        writer.writeAttribute(QStringLiteral("bottom"), PMbotton);
+        writer.writeAttribute(QStringLiteral("header"), PMheader);
+        writer.writeAttribute(QStringLiteral("footer"), PMfooter);
 
         writer.writeEndElement(); // pageMargins
     }
 
     // dev57
-    if (!d->Prid.isEmpty()) {
+    if (!Prid.isEmpty()) {
         writer.writeStartElement(QStringLiteral("pageSetup")); // pageSetup
 
-        writer.writeAttribute(QStringLiteral("r:id"), d->Prid);
+        writer.writeAttribute(QStringLiteral("r:id"), Prid);
 
-        if (!d->PverticalDpi.isEmpty()) {
-            writer.writeAttribute(QStringLiteral("verticalDpi"), d->PverticalDpi);
+        if (!PverticalDpi.isEmpty()) {
+            writer.writeAttribute(QStringLiteral("verticalDpi"), PverticalDpi);
         }
 
-        if (!d->PhorizontalDpi.isEmpty()) {
-            writer.writeAttribute(QStringLiteral("horizontalDpi"), d->PhorizontalDpi);
+        if (!PhorizontalDpi.isEmpty()) {
+            writer.writeAttribute(QStringLiteral("horizontalDpi"), PhorizontalDpi);
         }
 
-        if (!d->PuseFirstPageNumber.isEmpty()) {
-            writer.writeAttribute(QStringLiteral("useFirstPageNumber"), d->PuseFirstPageNumber);
+        if (!PuseFirstPageNumber.isEmpty()) {
+            writer.writeAttribute(QStringLiteral("useFirstPageNumber"), PuseFirstPageNumber);
         }
 
-        if (!d->PfirstPageNumber.isEmpty()) {
-            writer.writeAttribute(QStringLiteral("firstPageNumber"), d->PfirstPageNumber);
+        if (!PfirstPageNumber.isEmpty()) {
+            writer.writeAttribute(QStringLiteral("firstPageNumber"), PfirstPageNumber);
         }
 
-        if (!d->Pscale.isEmpty()) {
-            writer.writeAttribute(QStringLiteral("scale"), d->Pscale);
+        if (!Pscale.isEmpty()) {
+            writer.writeAttribute(QStringLiteral("scale"), Pscale);
         }
 
-        if (!d->PpaperSize.isEmpty()) {
-            writer.writeAttribute(QStringLiteral("paperSize"), d->PpaperSize);
+        if (!PpaperSize.isEmpty()) {
+            writer.writeAttribute(QStringLiteral("paperSize"), PpaperSize);
         }
 
-        if (!d->Porientation.isEmpty()) {
-            writer.writeAttribute(QStringLiteral("orientation"), d->Porientation);
+        if (!Porientation.isEmpty()) {
+            writer.writeAttribute(QStringLiteral("orientation"), Porientation);
         }
 
-        if (!d->Pcopies.isEmpty()) {
-            writer.writeAttribute(QStringLiteral("copies"), d->Pcopies);
+        if (!Pcopies.isEmpty()) {
+            writer.writeAttribute(QStringLiteral("copies"), Pcopies);
         }
 
         writer.writeEndElement(); // pageSetup
 
-    } // if ( !d->Prid.isEmpty() )
+    } // if ( !Prid.isEmpty() )
 
     // headerFooter
-    if (!(d->ModdHeader.isNull()) || !(d->MoodFooter.isNull())) {
+    if (!(ModdHeader.isNull()) || !(MoodFooter.isNull())) {
         writer.writeStartElement(QStringLiteral("headerFooter")); // headerFooter
 
-        if (!d->MoodalignWithMargins.isEmpty()) {
-            writer.writeAttribute(QStringLiteral("alignWithMargins"), d->MoodalignWithMargins);
+        if (!MoodalignWithMargins.isEmpty()) {
+            writer.writeAttribute(QStringLiteral("alignWithMargins"), MoodalignWithMargins);
         }
 
-        if (!d->ModdHeader.isNull()) {
+        if (!ModdHeader.isNull()) {
             writer.writeStartElement(QStringLiteral("oddHeader"));
-            writer.writeCharacters(d->ModdHeader);
+            writer.writeCharacters(ModdHeader);
             writer.writeEndElement(); // oddHeader
         }
 
-        if (!d->MoodFooter.isNull()) {
-            writer.writeTextElement(QStringLiteral("oddFooter"), d->MoodFooter);
+        if (!MoodFooter.isNull()) {
+            writer.writeTextElement(QStringLiteral("oddFooter"), MoodFooter);
         }
 
         writer.writeEndElement(); // headerFooter
     }
 
-    d->saveXmlHyperlinks(writer);
-    d->saveXmlDrawings(writer);
+    saveXmlHyperlinks(writer);
+    saveXmlDrawings(writer);
 
     writer.writeEndElement(); // worksheet
     writer.writeEndDocument();
@@ -1489,95 +1780,251 @@ bool Worksheet::setStartPage(int spagen)
 
 void WorksheetPrivate::saveXmlSheetData(QXmlStreamWriter &writer) const
 {
-    calculateSpans();
+    // Rows with cells, formatting or comments, in order; the rows of the
+    // dimension between them have nothing to write
+    std::vector<int> rows;
+    cellTable.forEachRow([&rows](int row, const CellTable::Row &) { rows.push_back(row); });
+    if (!rowsInfo.isEmpty() || !comments.isEmpty()) {
+        for (auto it = rowsInfo.constBegin(); it != rowsInfo.constEnd(); ++it)
+            rows.push_back(it.key());
+        for (auto it = comments.constBegin(); it != comments.constEnd(); ++it)
+            rows.push_back(it.key());
+        std::sort(rows.begin(), rows.end());
+        rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    }
 
-    for (int row_num = dimension.firstRow(); row_num <= dimension.lastRow(); row_num++) {
-        auto ctIt = cellTable.cells.constFind(row_num);
-        auto riIt = rowsInfo.constFind(row_num);
-        if (ctIt == cellTable.cells.constEnd() && riIt == rowsInfo.constEnd() &&
-            !comments.contains(row_num)) {
-            // Only process rows with cell data / comments / formatting
+    SheetDataWriter out(writer);
+    int block     = -1;
+    int spanFirst = -1;
+    int spanLast  = -1;
+    for (int row_num : rows) {
+        if (row_num < dimension.firstRow() || row_num > dimension.lastRow())
             continue;
+        if ((row_num - 1) / 16 != block) {
+            block = (row_num - 1) / 16;
+            if (!calculateSpan(block, &spanFirst, &spanLast))
+                spanFirst = spanLast = -1;
         }
+        saveXmlRow(out, row_num, spanFirst, spanLast);
+    }
+}
 
-        int span_index = (row_num - 1) / 16;
-        QString span;
-        auto rsIt = row_spans.constFind(span_index);
-        if (rsIt != row_spans.constEnd())
-            span = rsIt.value();
-
-        writer.writeStartElement(QStringLiteral("row"));
-        writer.writeAttribute(QStringLiteral("r"), QString::number(row_num));
+// Writes one <row>, if it has cell data, comments or formatting; the
+// spans attribute is left out if spanFirst is -1
+void WorksheetPrivate::saveXmlRow(SheetDataWriter &out,
+                                  int row_num,
+                                  int spanFirst,
+                                  int spanLast) const
+{
+    const CellTable::Row *cells = cellTable.findRow(row_num);
+    auto riIt                   = rowsInfo.constFind(row_num);
+    if (!cells && riIt == rowsInfo.constEnd() && !comments.contains(row_num))
+        return;
 
-        if (!span.isEmpty())
-            writer.writeAttribute(QStringLiteral("spans"), span);
+    out.append("<row r=\"");
+    out.appendInteger(row_num);
+    out.append("\"");
 
-        if (riIt != rowsInfo.constEnd()) {
-            std::shared_ptr<XlsxRowInfo> rowInfo = riIt.value();
-            if (!rowInfo->format.isEmpty()) {
-                writer.writeAttribute(QStringLiteral("s"),
-                                      QString::number(rowInfo->format.xfIndex()));
-                writer.writeAttribute(QStringLiteral("customFormat"), QStringLiteral("1"));
-            }
+    if (spanFirst >= 0) {
+        out.append(" spans=\"");
+        out.appendInteger(spanFirst);
+        out.append(":");
+        out.appendInteger(spanLast);
+        out.append("\"");
+    }
 
-            //! Todo: support customHeight from info struct
-            //! Todo: where does this magic number '15' come from?
-            if (rowInfo->customHeight) {
-                writer.writeAttribute(QStringLiteral("ht"), QString::number(rowInfo->height));
-                writer.writeAttribute(QStringLiteral("customHeight"), QStringLiteral("1"));
-            } else {
-                writer.writeAttribute(QStringLiteral("customHeight"), QStringLiteral("0"));
-            }
+    if (riIt != rowsInfo.constEnd()) {
+        std::shared_ptr<XlsxRowInfo> rowInfo = riIt.value();
+        if (!rowInfo->format.isEmpty()) {
+            out.append(" s=\"");
+            out.appendInteger(rowInfo->format.xfIndex());
+            out.append("\" customFormat=\"1\"");
+        }
 
-            if (rowInfo->hidden)
-                writer.writeAttribute(QStringLiteral("hidden"), QStringLiteral("1"));
-            if (rowInfo->outlineLevel > 0)
-                writer.writeAttribute(QStringLiteral("outlineLevel"),
-                                      QString::number(rowInfo->outlineLevel));
-            if (rowInfo->collapsed)
-                writer.writeAttribute(QStringLiteral("collapsed"), QStringLiteral("1"));
+        //! Todo: support customHeight from info struct
+        //! Todo: where does this magic number '15' come from?
+        if (rowInfo->customHeight) {
+            out.append(" ht=\"");
+            out.appendEscaped(QString::number(rowInfo->height));
+            out.append("\" customHeight=\"1\"");
+        } else {
+            out.append(" customHeight=\"0\"");
         }
 
-        // Write cell data if row contains filled cells
-        if (ctIt != cellTable.cells.constEnd()) {
-            for (int col_num = dimension.firstColumn(); col_num <= dimension.lastColumn();
-                 col_num++) {
-                auto cellIt = ctIt->find(col_num);
-                if (cellIt != ctIt->end()) {
-                    saveXmlCellData(writer, row_num, col_num, *cellIt);
-                }
-            }
+        if (rowInfo->hidden)
+            out.append(" hidden=\"1\"");
+        if (rowInfo->outlineLevel > 0) {
+            out.append(" outlineLevel=\"");
+            out.appendInteger(rowInfo->outlineLevel);
+            out.append("\"");
         }
-        writer.writeEndElement(); // row
+        if (rowInfo->collapsed)
+            out.append(" collapsed=\"1\"");
+    }
+
+    // Write cell data if row contains filled cells; they are already in
+    // column order
+    CellTable::Row::const_iterator begin;
+    CellTable::Row::const_iterator end;
+    if (cells) {
+        begin = cells->begin();
+        while (begin != cells->end() && begin->column < dimension.firstColumn())
+            ++begin;
+        end = begin;
+        while (end != cells->end() && end->column <= dimension.lastColumn())
+            ++end;
     }
+    if (!cells || begin == end) {
+        out.append("/>");
+        return;
+    }
+
+    out.append(">");
+    for (auto it = begin; it != end; ++it) {
+        if (!saveXmlCompactCellData(out, row_num, *it))
+            saveXmlCellData(out, row_num, it->column, materializeCell(*it));
+    }
+    out.append("</row>");
 }
 
-void WorksheetPrivate::saveXmlCellData(QXmlStreamWriter &writer,
-                                       int row,
-                                       int col,
-                                       std::shared_ptr<Cell> cell) const
+namespace {
+
+void saveXmlStyleIndex(SheetDataWriter &out, int xfIndex)
 {
-    // This is the innermost loop so efficiency is important.
-    QString cell_pos = CellReference(row, col).toString();
+    out.append(" s=\"");
+    out.appendInteger(xfIndex);
+    out.append("\"");
+}
+
+// Writes <v> with a number in it
+void saveXmlNumberValue(SheetDataWriter &out, double value)
+{
+    out.append("<v>");
+    out.appendNumber(value);
+    out.append("</v>");
+}
+
+void saveXmlTextValue(SheetDataWriter &out, const QString &text)
+{
+    out.append("<v>");
+    out.appendEscaped(text);
+    out.append("</v>");
+}
 
-    writer.writeStartElement(QStringLiteral("c"));
-    writer.writeAttribute(QStringLiteral("r"), cell_pos);
+// Writes a <t> element of an inline string
+void saveXmlInlineText(SheetDataWriter &out, const QString &text)
+{
+    if (isSpaceReserveNeeded(text))
+        out.append("<t xml:space=\"preserve\">");
+    else
+        out.append("<t>");
+    out.appendEscaped(text);
+    out.append("</t>");
+}
 
+// Ends the <c> start tag and writes the cell's formula, if it has one
+void saveXmlCellFormula(SheetDataWriter &out, const Cell &cell)
+{
+    out.append(">");
+    if (cell.hasFormula())
+        cell.formula().saveToXml(out.xmlWriter());
+}
+
+} // namespace
+
+void WorksheetPrivate::saveXmlCellStyle(SheetDataWriter &out,
+                                        int row,
+                                        int col,
+                                        const Format &format) const
+{
     // Style used by the cell, row or col
-    if (!cell->format().isEmpty()) {
-        writer.writeAttribute(QStringLiteral("s"), QString::number(cell->format().xfIndex()));
+    if (!format.isEmpty()) {
+        saveXmlStyleIndex(out, format.xfIndex());
     } else {
         auto rIt = rowsInfo.constFind(row);
         if (rIt != rowsInfo.constEnd() && !(*rIt)->format.isEmpty()) {
-            writer.writeAttribute(QStringLiteral("s"), QString::number((*rIt)->format.xfIndex()));
+            saveXmlStyleIndex(out, (*rIt)->format.xfIndex());
         } else {
             auto cIt = colsInfoHelper.constFind(col);
-            if (cIt != colsInfoHelper.constEnd() && !(*cIt)->format.isEmpty()) {
-                writer.writeAttribute(QStringLiteral("s"),
-                                      QString::number((*cIt)->format.xfIndex()));
-            }
+            if (cIt != colsInfoHelper.constEnd() && !(*cIt)->format.isEmpty())
+                saveXmlStyleIndex(out, (*cIt)->format.xfIndex());
         }
     }
+}
+
+/*!
+ * \internal
+ * Writes a compact cell without building a Cell for it. Returns false for
+ * the kinds saveXmlCellData() has to handle.
+ */
+bool WorksheetPrivate::saveXmlCompactCellData(SheetDataWriter &out,
+                                              int row,
+                                              const CompactCell &cell) const
+{
+    const bool untyped = cell.cellType == Cell::CustomType;
+    switch (cell.kind) {
+    case CompactCell::Blank:
+    case CompactCell::Number:
+        if (!untyped && cell.cellType != Cell::NumberType)
+            return false;
+        break;
+    case CompactCell::SharedString:
+    case CompactCell::Boolean:
+    case CompactCell::Error:
+        break;
+    default:
+        return false;
+    }
+
+    out.append("<c r=\"");
+    out.appendCellReference(row, cell.column);
+    out.append("\"");
+
+    Format format;
+    if (cell.styleIndex >= 0)
+        format = workbook->styles()->xfFormat(cell.styleIndex);
+    saveXmlCellStyle(out, row, cell.column, format);
+
+    switch (cell.kind) {
+    case CompactCell::Blank:
+        out.append(untyped ? "/>" : " t=\"n\"/>");
+        break;
+    case CompactCell::Number:
+        out.append(untyped ? ">" : " t=\"n\">");
+        saveXmlNumberValue(out, cell.number);
+        out.append("</c>");
+        break;
+    case CompactCell::SharedString:
+        // Shared string indexes never move once assigned
+        out.append(" t=\"s\"><v>");
+        out.appendInteger(cell.index);
+        out.append("</v></c>");
+        break;
+    case CompactCell::Boolean:
+        out.append(cell.boolean ? " t=\"b\"><v>1</v></c>" : " t=\"b\"><v>0</v></c>");
+        break;
+    case CompactCell::Error:
+        out.append(" t=\"e\">");
+        saveXmlTextValue(out, CompactCell::errorCode(cell.index));
+        out.append("</c>");
+        break;
+    default:
+        break;
+    }
+    return true;
+}
+
+void WorksheetPrivate::saveXmlCellData(SheetDataWriter &out,
+                                       int row,
+                                       int col,
+                                       std::shared_ptr<Cell> cell) const
+{
+    // This is the innermost loop so efficiency is important.
+    out.append("<c r=\"");
+    out.appendCellReference(row, col);
+    out.append("\"");
+
+    saveXmlCellStyle(out, row, col, cell->format());
 
     if (cell->cellType() == Cell::SharedStringType) // 's'
     {
@@ -1587,123 +2034,105 @@ void WorksheetPrivate::saveXmlCellData(QXmlStreamWriter &writer,
         else
             sst_idx = sharedStrings()->getSharedStringIndex(cell->value().toString());
 
-        writer.writeAttribute(QStringLiteral("t"), QStringLiteral("s"));
-        writer.writeTextElement(QStringLiteral("v"), QString::number(sst_idx));
+        out.append(" t=\"s\"><v>");
+        out.appendInteger(sst_idx);
+        out.append("</v>");
     } else if (cell->cellType() == Cell::InlineStringType) // 'inlineStr'
     {
-        writer.writeAttribute(QStringLiteral("t"), QStringLiteral("inlineStr"));
-        writer.writeStartElement(QStringLiteral("is"));
+        out.append(" t=\"inlineStr\"><is>");
         if (cell->isRichString()) {
             // Rich text string
             RichString string = cell->d_ptr->richString;
             for (int i = 0; i < string.fragmentCount(); ++i) {
-                writer.writeStartElement(QStringLiteral("r"));
+                out.append("<r>");
                 if (string.fragmentFormat(i).hasFontData()) {
-                    writer.writeStartElement(QStringLiteral("rPr"));
                     //: Todo
-                    writer.writeEndElement(); // rPr
+                    out.append("<rPr/>");
                 }
-                writer.writeStartElement(QStringLiteral("t"));
-                if (isSpaceReserveNeeded(string.fragmentText(i)))
-                    writer.writeAttribute(QStringLiteral("xml:space"), QStringLiteral("preserve"));
-                writer.writeCharacters(string.fragmentText(i));
-                writer.writeEndElement(); // t
-                writer.writeEndElement(); // r
+                saveXmlInlineText(out, string.fragmentText(i));
+                out.append("</r>");
             }
         } else {
-            writer.writeStartElement(QStringLiteral("t"));
-            QString string = cell->value().toString();
-            if (isSpaceReserveNeeded(string))
-                writer.writeAttribute(QStringLiteral("xml:space"), QStringLiteral("preserve"));
-            writer.writeCharacters(string);
-            writer.writeEndElement(); // t
+            saveXmlInlineText(out, cell->value().toString());
         }
-        writer.writeEndElement();                    // is
+        out.append("</is>");
     } else if (cell->cellType() == Cell::NumberType) // 'n'
     {
-        writer.writeAttribute(QStringLiteral("t"), QStringLiteral("n")); // dev67
-
-        if (cell->hasFormula()) {
-            QString strFormula = cell->formula().d->formula;
-            Q_UNUSED(strFormula);
-            cell->formula().saveToXml(writer);
-        }
+        out.append(" t=\"n\""); // dev67
 
-        if (cell->value().isValid()) { // note that, invalid value means 'v' is blank
-            double value = cell->value().toDouble();
-            writer.writeTextElement(QStringLiteral("v"), QString::number(value, 'g', 15));
+        // note that, invalid value means 'v' is blank
+        if (!cell->hasFormula() && !cell->value().isValid()) {
+            out.append("/>");
+            return;
         }
+        saveXmlCellFormula(out, *cell);
+        if (cell->value().isValid())
+            saveXmlNumberValue(out, cell->value().toDouble());
     } else if (cell->cellType() == Cell::StringType) // 'str'
     {
-        writer.writeAttribute(QStringLiteral("t"), QStringLiteral("str"));
-        if (cell->hasFormula())
-            cell->formula().saveToXml(writer);
-
-        writer.writeTextElement(QStringLiteral("v"), cell->value().toString());
+        out.append(" t=\"str\"");
+        saveXmlCellFormula(out, *cell);
+        saveXmlTextValue(out, cell->value().toString());
     } else if (cell->cellType() == Cell::BooleanType) // 'b'
     {
-        writer.writeAttribute(QStringLiteral("t"), QStringLiteral("b"));
+        out.append(" t=\"b\"");
 
         // dev34
 
-        if (cell->hasFormula()) {
-            QString strFormula = cell->formula().d->formula;
-            Q_UNUSED(strFormula);
-            cell->formula().saveToXml(writer);
-        }
-
-        writer.writeTextElement(QStringLiteral("v"),
-                                cell->value().toBool() ? QStringLiteral("1") : QStringLiteral("0"));
+        saveXmlCellFormula(out, *cell);
+        out.append(cell->value().toBool() ? "<v>1</v>" : "<v>0</v>");
     } else if (cell->cellType() == Cell::DateType) // 'd'
     {
         // number type. see for 18.18.11 ST_CellType (Cell Type) more information.
-        writer.writeAttribute(QStringLiteral("t"), QStringLiteral("n"));
+        out.append(" t=\"n\"");
 
         // Legacy mode: write date as text (old behavior)
         if (workbook && workbook->writeDatesAsText()) {
-            writer.writeTextElement(QStringLiteral("v"), cell->value().toString());
+            out.append(">");
+            saveXmlTextValue(out, cell->value().toString());
         } else {
-            if (cell->value().isValid()) {
-                double serial = 0.0;
-
-                if (SAME_METATYPE_ID(cell->value(), QMetaType::QDateTime)) {
-                    const QDateTime dt = cell->value().toDateTime();
-                    serial = datetimeToNumber(dt, workbook ? workbook->isDate1904() : false);
-                } else if (SAME_METATYPE_ID(cell->value(), QMetaType::QDate)) {
-                    const QDate d = cell->value().toDate();
-                    const QDateTime dt(d, QTime(0, 0));
-                    serial = datetimeToNumber(dt, workbook ? workbook->isDate1904() : false);
-                } else if (SAME_METATYPE_ID(cell->value(), QMetaType::QTime)) {
-                    serial = timeToNumber(cell->value().toTime());
-                } else {
-                    // Already a serial (e.g., from earlier pipeline stage).
-                    serial = cell->value().toDouble();
-                }
-
-                writer.writeTextElement(QStringLiteral("v"), QString::number(serial, 'g', 15));
+            if (!cell->value().isValid()) {
+                out.append("/>");
+                return;
+            }
+            double serial = 0.0;
+
+            if (SAME_METATYPE_ID(cell->value(), QMetaType::QDateTime)) {
+                const QDateTime dt = cell->value().toDateTime();
+                serial = datetimeToNumber(dt, workbook ? workbook->isDate1904() : false);
+            } else if (SAME_METATYPE_ID(cell->value(), QMetaType::QDate)) {
+                const QDate d = cell->value().toDate();
+                const QDateTime dt(d, QTime(0, 0));
+                serial = datetimeToNumber(dt, workbook ? workbook->isDate1904() : false);
+            } else if (SAME_METATYPE_ID(cell->value(), QMetaType::QTime)) {
+                serial = timeToNumber(cell->value().toTime());
+            } else {
+                // Already a serial (e.g., from earlier pipeline stage).
+                serial = cell->value().toDouble();
             }
+
+            out.append(">");
+            saveXmlNumberValue(out, serial);
         }
     } else if (cell->cellType() == Cell::ErrorType) // 'e'
     {
-        writer.writeAttribute(QStringLiteral("t"), QStringLiteral("e"));
-        writer.writeTextElement(QStringLiteral("v"), cell->value().toString());
+        out.append(" t=\"e\">");
+        saveXmlTextValue(out, cell->value().toString());
     } else // if (cell->cellType() == Cell::CustomType)
     {
         // custom type
 
-        if (cell->hasFormula()) {
-            QString strFormula = cell->formula().d->formula;
-            Q_UNUSED(strFormula);
-            cell->formula().saveToXml(writer);
-        }
-
-        if (cell->value().isValid()) { // note that, invalid value means 'v' is blank
-            double value = cell->value().toDouble();
-            writer.writeTextElement(QStringLiteral("v"), QString::number(value, 'g', 15));
+        // note that, invalid value means 'v' is blank
+        if (!cell->hasFormula() && !cell->value().isValid()) {
+            out.append("/>");
+            return;
         }
+        saveXmlCellFormula(out, *cell);
+        if (cell->value().isValid())
+            saveXmlNumberValue(out, cell->value().toDouble());
     }
 
-    writer.writeEndElement(); // c
+    out.append("</c>");
 }
 
 void WorksheetPrivate::saveXmlMergeCells(QXmlStreamWriter &writer) const
@@ -2274,13 +2703,14 @@ int WorksheetPrivate::colPixelsSize(int col) const
 
 void WorksheetPrivate::loadXmlSheetData(QXmlStreamReader &reader)
 {
-    Q_Q(Worksheet);
-
     Q_ASSERT(reader.name() == QLatin1String("sheetData"));
 
     int row_num = 0;
     int col_num = 0;
 
+    if (!loadArena)
+        loadArena = std::make_shared<Arena>();
+
     while (!reader.atEnd() && !(reader.name() == QLatin1String("sheetData") &&
                                 reader.tokenType() == QXmlStreamReader::EndElement)) {
         if (reader.readNextStartElement()) {
@@ -2293,7 +2723,8 @@ void WorksheetPrivate::loadXmlSheetData(QXmlStreamReader &reader)
                     attributes.hasAttribute(QLatin1String("outlineLevel")) ||
                     attributes.hasAttribute(QLatin1String("collapsed"))) {
 
-                    std::shared_ptr<XlsxRowInfo> info(new XlsxRowInfo);
+                    auto info = std::allocate_shared<XlsxRowInfo>(
+                        ArenaAllocator<XlsxRowInfo>(loadArena));
                     if (attributes.hasAttribute(QLatin1String("customFormat")) &&
                         attributes.hasAttribute(QLatin1String("s"))) {
                         int idx      = attributes.value(QLatin1String("s")).toInt();
@@ -2335,16 +2766,27 @@ void WorksheetPrivate::loadXmlSheetData(QXmlStreamReader &reader)
                     ++row_num;
                 col_num = 0;
 
+                if (attributes.hasAttribute(QLatin1String("spans")))
+                    cellTable.reserveRow(row_num,
+                                         spanColumns(attributes.value(QLatin1String("spans"))));
+
             } else if (reader.name() == QLatin1String("c")) // Cell
             {
 
                 // Cell
                 QXmlStreamAttributes attributes = reader.attributes();
-                QString r                       = attributes.value(QLatin1String("r")).toString();
-                CellReference pos(r);
+                const auto r                    = attributes.value(QLatin1String("r"));
+                CellReference pos;
                 if (r.isEmpty()) {
                     pos.setRow(row_num);
                     pos.setColumn(++col_num);
+                } else {
+                    int row = 0;
+                    int col = 0;
+                    if (parseCellReference(r, &row, &col)) {
+                        pos.setRow(row);
+                        pos.setColumn(col);
+                    }
                 }
 
                 // get format
@@ -2396,15 +2838,19 @@ void WorksheetPrivate::loadXmlSheetData(QXmlStreamReader &reader)
                     cellType = Cell::DateType;
                 }
 
-                // create a heap of new cell
-                auto cell = std::make_shared<Cell>(QVariant{}, cellType, format, q, styleIndex);
+                bool hasFormula = false;
+                bool hasValue   = false;
+                bool hasInline  = false;
+                CellFormula formula;
+                QString value;
+                QString inlineText;
 
                 while (!reader.atEnd() && !(reader.name() == QLatin1String("c") &&
                                             reader.tokenType() == QXmlStreamReader::EndElement)) {
                     if (reader.readNextStartElement()) {
                         if (reader.name() == QLatin1String("f")) // formula
                         {
-                            CellFormula &formula = cell->d_func()->formula;
+                            hasFormula = true;
                             formula.loadFromXml(reader);
                             if (formula.formulaType() == CellFormula::SharedType &&
                                 !formula.formulaText().isEmpty()) {
@@ -2413,34 +2859,8 @@ void WorksheetPrivate::loadXmlSheetData(QXmlStreamReader &reader)
                             }
                         } else if (reader.name() == QLatin1String("v")) // Value
                         {
-                            QString value = reader.readElementText();
-                            if (cellType == Cell::SharedStringType) {
-                                int sst_idx = value.toInt();
-                                sharedStrings()->incRefByStringIndex(sst_idx);
-                                RichString rs          = sharedStrings()->getSharedString(sst_idx);
-                                QString strPlainString = rs.toPlainString();
-                                cell->d_func()->value  = strPlainString;
-                                if (rs.isRichString())
-                                    cell->d_func()->richString = rs;
-                            } else if (cellType == Cell::NumberType) {
-                                cell->d_func()->value = value.toDouble();
-                            } else if (cellType == Cell::BooleanType) {
-                                cell->d_func()->value = value.toInt() ? true : false;
-                            } else if (cellType == Cell::DateType) {
-                                // [dev54] DateType
-
-                                double dValue    = value.toDouble(); // days from 1900(or 1904)
-                                bool bIsDate1904 = q->workbook()->isDate1904();
-
-                                QVariant vDatetimeValue = datetimeFromNumber(dValue, bIsDate1904);
-                                Q_UNUSED(vDatetimeValue);
-                                // cell->d_func()->value = vDatetimeValue;
-                                cell->d_func()->value = dValue; // dev67
-                            } else {
-                                // ELSE type
-                                cell->d_func()->value = value;
-                            }
-
+                            hasValue = true;
+                            value    = reader.readElementText();
                         } else if (reader.name() == QLatin1String("is")) {
                             while (!reader.atEnd() &&
                                    !(reader.name() == QLatin1String("is") &&
@@ -2448,7 +2868,8 @@ void WorksheetPrivate::loadXmlSheetData(QXmlStreamReader &reader)
                                 if (reader.readNextStartElement()) {
                                     //: Todo, add rich text read support
                                     if (reader.name() == QLatin1String("t")) {
-                                        cell->d_func()->value = reader.readElementText();
+                                        hasInline  = true;
+                                        inlineText = reader.readElementText();
                                     }
                                 }
                             }
@@ -2463,7 +2884,56 @@ void WorksheetPrivate::loadXmlSheetData(QXmlStreamReader &reader)
                     }
                 }
 
-                cellTable.setValue(pos.row(), pos.column(), cell);
+                // Plain values are stored inline; everything else gets a Cell
+                if (!hasFormula && !hasInline) {
+                    CompactCell compact;
+                    compact.index      = 0;
+                    compact.styleIndex = styleIndex;
+                    compact.cellType   = quint8(cellType);
+                    compact.kind       = CompactCell::Full;
+
+                    if (!hasValue) {
+                        compact.kind = CompactCell::Blank;
+                    } else if (cellType == Cell::SharedStringType) {
+                        int sst_idx = value.toInt();
+                        sharedStrings()->incRefByStringIndex(sst_idx);
+                        compact.kind  = CompactCell::SharedString;
+                        compact.index = sst_idx;
+                    } else if (cellType == Cell::NumberType || cellType == Cell::DateType) {
+                        compact.kind   = CompactCell::Number;
+                        compact.number = value.toDouble();
+                    } else if (cellType == Cell::BooleanType) {
+                        compact.kind    = CompactCell::Boolean;
+                        compact.boolean = value.toInt() ? true : false;
+                    } else if (cellType == Cell::ErrorType) {
+                        int code = CompactCell::errorCodeIndex(value);
+                        if (code >= 0) {
+                            compact.kind  = CompactCell::Error;
+                            compact.index = code;
+                        }
+                    } else if (cellType == Cell::CustomType) {
+                        // Only if the text comes back unchanged when read
+                        if (isPlainDecimal(value.constData(), int(value.size()))) {
+                            compact.kind   = CompactCell::Number;
+                            compact.number = value.toDouble();
+                        }
+                    }
+
+                    if (compact.kind != CompactCell::Full) {
+                        cellTable.setCompact(pos.row(), pos.column(), compact);
+                        continue;
+                    }
+                }
+
+                if (hasValue && cellType == Cell::SharedStringType)
+                    sharedStrings()->incRefByStringIndex(value.toInt());
+                storeLoadedCell(pos.row(),
+                                pos.column(),
+                                cellType,
+                                styleIndex,
+                                formula,
+                                hasValue ? &value : nullptr,
+                                hasInline ? &inlineText : nullptr);
             }
         }
     }
@@ -2475,6 +2945,68 @@ void WorksheetPrivate::loadXmlSheetData(QXmlStreamReader &reader)
         dimension.setLastColumn(col_num);
 }
 
+/*!
+ * \internal
+ * Creates the full Cell for a loaded cell that cannot be stored compactly.
+ * \a value is the text of its <v> element and \a inlineText that of its
+ * inline string, either may be nullptr if absent. The caller counts the
+ * reference to a shared string.
+ */
+void WorksheetPrivate::storeLoadedCell(int row,
+                                       int col,
+                                       Cell::CellType cellType,
+                                       qint32 styleIndex,
+                                       const CellFormula &formula,
+                                       const QString *value,
+                                       const QString *inlineText)
+{
+    Q_Q(Worksheet);
+
+    if (!loadArena)
+        loadArena = std::make_shared<Arena>();
+
+    Format format;
+    if (styleIndex >= 0)
+        format = workbook->styles()->xfFormat(styleIndex);
+
+    // create a heap of new cell
+    auto cell = std::allocate_shared<Cell>(
+        ArenaAllocator<Cell>(loadArena), QVariant{}, cellType, format, q, styleIndex);
+    cell->d_func()->formula = formula;
+
+    if (value) {
+        if (cellType == Cell::SharedStringType) {
+            int sst_idx = value->toInt();
+            RichString rs          = sharedStrings()->getSharedString(sst_idx);
+            QString strPlainString = rs.toPlainString();
+            cell->d_func()->value  = strPlainString;
+            if (rs.isRichString())
+                cell->d_func()->richString = rs;
+        } else if (cellType == Cell::NumberType) {
+            cell->d_func()->value = value->toDouble();
+        } else if (cellType == Cell::BooleanType) {
+            cell->d_func()->value = value->toInt() ? true : false;
+        } else if (cellType == Cell::DateType) {
+            // [dev54] DateType
+
+            double dValue    = value->toDouble(); // days from 1900(or 1904)
+            bool bIsDate1904 = q->workbook()->isDate1904();
+
+            QVariant vDatetimeValue = datetimeFromNumber(dValue, bIsDate1904);
+            Q_UNUSED(vDatetimeValue);
+            // cell->d_func()->value = vDatetimeValue;
+            cell->d_func()->value = dValue; // dev67
+        } else {
+            // ELSE type
+            cell->d_func()->value = *value;
+        }
+    }
+    if (inlineText)
+        cell->d_func()->value = *inlineText;
+
+    cellTable.setValue(row, col, cell);
+}
+
 void WorksheetPrivate::loadXmlColumnsInfo(QXmlStreamReader &reader)
 {
     Q_ASSERT(reader.name() == QLatin1String("cols"));
@@ -2749,7 +3281,55 @@ bool Worksheet::loadFromXmlFile(QIODevice *device)
 {
     Q_D(Worksheet);
 
-    QXmlStreamReader reader(device);
+    // Cell data is read straight from the UTF-8 bytes; the rest of the part
+    // goes through QXmlStreamReader with an empty <sheetData/> in its place
+    QByteArray xml;
+    bool sheetDataLoaded = false;
+    int sheetDataRow     = 0;
+    int sheetDataColumn  = 0;
+    auto buffer          = qobject_cast<QBuffer *>(device);
+    if (buffer && buffer->pos() == 0) {
+        // Parts loaded through loadFromXmlData() are already in memory
+        xml = buffer->data();
+        SheetDataReader::Location location;
+        if (SheetDataReader::locate(xml, &location)) {
+            SheetDataReader sheetData(d);
+            if (sheetData.read(xml.constData() + location.contentBegin,
+                               xml.constData() + location.contentEnd)) {
+                sheetDataLoaded = true;
+                sheetDataRow    = sheetData.lastRow();
+                sheetDataColumn = sheetData.lastColumn();
+                xml = xml.left(location.elementBegin) + QByteArrayLiteral("<sheetData/>") +
+                      xml.mid(location.elementEnd);
+            } else {
+                d->cellTable = CellTable();
+                d->rowsInfo.clear();
+                d->sharedFormulaMap.clear();
+            }
+        }
+    } else {
+        // Streamed parts (ZipReader::openFile()) are parsed a window at a time
+        SheetDataReader sheetData(d);
+        switch (sheetData.readStream(device, &xml)) {
+        case SheetDataReader::StreamLoaded:
+            sheetDataLoaded = true;
+            sheetDataRow    = sheetData.lastRow();
+            sheetDataColumn = sheetData.lastColumn();
+            break;
+        case SheetDataReader::StreamNoData:
+            break;
+        case SheetDataReader::StreamUnsupported:
+            d->cellTable = CellTable();
+            d->rowsInfo.clear();
+            d->sharedFormulaMap.clear();
+            if (!device->reset())
+                return false;
+            xml = device->readAll();
+            break;
+        }
+    }
+
+    QXmlStreamReader reader(xml);
     while (!reader.atEnd()) {
         reader.readNextStartElement();
         if (reader.tokenType() == QXmlStreamReader::StartElement) {
@@ -2764,7 +3344,8 @@ bool Worksheet::loadFromXmlFile(QIODevice *device)
             } else if (reader.name() == QLatin1String("cols")) {
                 d->loadXmlColumnsInfo(reader);
             } else if (reader.name() == QLatin1String("sheetData")) {
-                d->loadXmlSheetData(reader);
+                if (!sheetDataLoaded)
+                    d->loadXmlSheetData(reader);
             } else if (reader.name() == QLatin1String("mergeCells")) {
                 d->loadXmlMergeCells(reader);
             } else if (reader.name() == QLatin1String("dataValidations")) {
@@ -2829,6 +3410,13 @@ bool Worksheet::loadFromXmlFile(QIODevice *device)
         }
     }
 
+    // As loadXmlSheetData() does after reading <sheetData>
+    if (d->dimension.lastRow() < sheetDataRow)
+        d->dimension.setLastRow(sheetDataRow);
+
+    if (d->dimension.lastColumn() < sheetDataColumn)
+        d->dimension.setLastColumn(sheetDataColumn);
+
     d->validateDimension();
     return true;
 }
@@ -2848,6 +3436,70 @@ void WorksheetPrivate::validateDimension()
         dimension = cr;
 }
 
+/*!
+ * \internal
+ * Starts write-only mode: the sheet is written to \a device, the archive
+ * entry of the part \a path, and from here on its rows are written and
+ * dropped from the cell table as soon as appendRow() moves past them.
+ */
+void WorksheetPrivate::beginStream(std::unique_ptr<QIODevice> device, const QString &path)
+{
+    relationships->clear();
+    streamDevice = std::move(device);
+    streamWriter.reset(new QXmlStreamWriter(streamDevice.get()));
+    streamPath   = path;
+    streamedRows = 0;
+
+    saveXmlSheetHead(*streamWriter, false);
+    streamWriter->writeStartElement(QStringLiteral("sheetData"));
+    streamOut.reset(new SheetDataWriter(*streamWriter));
+}
+
+// Writes the rows up to lastRow not written yet; false if writing failed
+bool WorksheetPrivate::streamRows(int lastRow)
+{
+    for (int row = streamedRows + 1; row <= lastRow; ++row) {
+        // Rows are written as they come, so spans only cover the row itself
+        const CellTable::Row *cells = cellTable.findRow(row);
+        if (cells)
+            saveXmlRow(*streamOut, row, cells->front().column, cells->back().column);
+        else
+            saveXmlRow(*streamOut, row, -1, -1);
+        cellTable.removeRow(row);
+    }
+    streamedRows = qMax(streamedRows, lastRow);
+    return !streamOut->hasError();
+}
+
+/*!
+ * \internal
+ * Writes the rows still held and the rest of the sheet, merged cells,
+ * hyperlinks and so on, and closes its entry. Returns false if writing
+ * failed.
+ */
+bool WorksheetPrivate::endStream()
+{
+    if (!streamWriter)
+        return true;
+
+    bool ok = streamRows(dimension.lastRow());
+    if (!cellTable.isEmpty()) {
+        qWarning("Worksheet: cells written above rows already streamed are dropped");
+        cellTable = CellTable();
+    }
+    streamOut->flush();
+    ok = ok && !streamOut->hasError();
+    streamOut.reset();
+    streamWriter->writeEndElement(); // sheetData
+    saveXmlSheetTail(*streamWriter);
+
+    ok = ok && !streamWriter->hasError();
+    streamWriter.reset();
+    streamDevice->close();
+    streamDevice.reset();
+    return ok;
+}
+
 /*!
  * \internal
  *  Unit test can use this member to get sharedString object.
@@ -2879,14 +3531,11 @@ QVector<CellLocation> Worksheet::getFullCells(int *maxRow, int *maxCol) const
         return ret;
     }
 
-    const auto sortedRows = d->cellTable.sortedRows();
-    for (const auto row : sortedRows) {
-        const auto &columns      = d->cellTable.cells[row];
-        const auto columnsSorted = CellTable::sorteIntList(columns.keys());
-        for (const auto &col : columnsSorted) {
-            // It's faster to iterate but cellTable is unordered which might not
-            // be what callers want?
-            auto cell = std::make_shared<Cell>(columns.value(col).get());
+    ret.reserve(d->cellTable.count());
+    d->cellTable.forEachRow([&](int row, const CellTable::Row &cells) {
+        for (const CellTable::Entry &entry : cells) {
+            const int col = entry.column;
+            auto cell     = std::make_shared<Cell>(d->materializeCell(entry).get());
 
             CellLocation cl;
 
@@ -2904,7 +3553,7 @@ QVector<CellLocation> Worksheet::getFullCells(int *maxRow, int *maxCol) const
 
             ret.push_back(cl);
         }
-    }
+    });
 
     return ret;
 }
@@ -2,18 +2,238 @@
 
 #include "xlsxzipreader_p.h"
 
+#include <QBuffer>
+#include <QFile>
+#include <QMutex>
+#include <QtEndian>
+
 #include <private/qzipreader_p.h>
 
+#include <climits>
+#include <cstring>
+
+#ifdef QXLSX_HAVE_ZLIB
+#    ifdef QXLSX_HAVE_QT_ZLIB
+#        include <QtZlib/zlib.h>
+#    else
+#        include <zlib.h>
+#    endif
+#endif
+
 QT_BEGIN_NAMESPACE_XLSX
 
+namespace {
+
+const quint32 LocalHeaderSignature    = 0x04034b50;
+const quint32 CentralHeaderSignature  = 0x02014b50;
+const quint32 EndOfDirectorySignature = 0x06054b50;
+
+const int LocalHeaderSize    = 30;
+const int CentralHeaderSize  = 46;
+const int EndOfDirectorySize = 22;
+
+const quint16 MethodStored   = 0;
+const quint16 MethodDeflated = 8;
+
+quint16 readUInt16(const QByteArray &data, int pos)
+{
+    return qFromLittleEndian<quint16>(data.constData() + pos);
+}
+
+quint32 readUInt32(const QByteArray &data, int pos)
+{
+    return qFromLittleEndian<quint32>(data.constData() + pos);
+}
+
+// Reads one archive entry straight from the package device, inflating
+// deflated data through a small input buffer as it is read. Going back
+// (seek to an earlier position, reset()) restarts from the entry's start.
+class ZipEntryDevice : public QIODevice
+{
+public:
+    ZipEntryDevice(QIODevice *source, QMutex *sourceMutex, qint64 dataOffset, quint16 method,
+                   quint32 crc, qint64 compressedSize, qint64 size)
+        : m_source(source)
+        , m_sourceMutex(sourceMutex)
+        , m_dataOffset(dataOffset)
+        , m_method(method)
+        , m_crc(crc)
+        , m_compressedSize(compressedSize)
+        , m_size(size)
+    {
+    }
+
+    ~ZipEntryDevice() override { close(); }
+
+    bool open(OpenMode mode) override
+    {
+        if ((mode & ReadWrite) != ReadOnly)
+            return false;
+        if (!restart())
+            return false;
+        // Unbuffered, so that pos() is always the inflate position: with
+        // QIODevice's read buffer a seek() within already buffered data
+        // would end somewhere else than where produce() left off
+        return QIODevice::open(mode | Unbuffered);
+    }
+
+    void close() override
+    {
+#ifdef QXLSX_HAVE_ZLIB
+        if (m_inflating) {
+            inflateEnd(&m_stream);
+            m_inflating = false;
+        }
+#endif
+        QIODevice::close();
+    }
+
+    qint64 size() const override { return m_size; }
+
+    bool seek(qint64 pos) override
+    {
+        if (pos < 0 || pos > m_size)
+            return false;
+        if (pos < m_outPos && !restart())
+            return false;
+        char scratch[16 * 1024];
+        while (m_outPos < pos) {
+            const qint64 n = produce(scratch, qMin<qint64>(sizeof(scratch), pos - m_outPos));
+            if (n <= 0)
+                return false;
+        }
+        return QIODevice::seek(pos);
+    }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override { return produce(data, maxSize); }
+
+    qint64 writeData(const char *, qint64) override { return -1; }
+
+private:
+    bool restart()
+    {
+        m_inPos    = 0;
+        m_outPos   = 0;
+        m_crcSoFar = 0;
+        m_input.clear();
+#ifdef QXLSX_HAVE_ZLIB
+        if (m_method == MethodDeflated) {
+            if (m_inflating)
+                inflateEnd(&m_stream);
+            m_stream    = z_stream();
+            m_inflating = inflateInit2(&m_stream, -MAX_WBITS) == Z_OK;
+            if (!m_inflating) {
+                setErrorString(QStringLiteral("Cannot initialize inflate"));
+                return false;
+            }
+        }
+#endif
+        return m_method == MethodStored || m_method == MethodDeflated;
+    }
+
+    // Reads the next compressed bytes of the entry from the package. Entries
+    // of one archive may be read from several threads, each seek and read
+    // of the shared package device is done under its mutex.
+    bool fill(qint64 maxSize)
+    {
+        const qint64 remaining = m_compressedSize - m_inPos;
+        QMutexLocker locker(m_sourceMutex);
+        if (remaining <= 0 || !m_source->seek(m_dataOffset + m_inPos))
+            return false;
+        m_input = m_source->read(qMin(remaining, maxSize));
+        m_inPos += m_input.size();
+        return !m_input.isEmpty();
+    }
+
+    qint64 produce(char *data, qint64 maxSize)
+    {
+        maxSize = qMin(maxSize, m_size - m_outPos);
+        if (maxSize <= 0)
+            return 0;
+
+        qint64 produced = 0;
+        if (m_method == MethodStored) {
+            if (!fill(maxSize)) {
+                setErrorString(QStringLiteral("Unexpected end of archive entry"));
+                return -1;
+            }
+            std::memcpy(data, m_input.constData(), size_t(m_input.size()));
+            produced = m_input.size();
+            m_input.clear();
+        } else {
+#ifdef QXLSX_HAVE_ZLIB
+            m_stream.next_out  = reinterpret_cast<Bytef *>(data);
+            m_stream.avail_out = uInt(qMin<qint64>(maxSize, INT_MAX));
+            while (m_stream.avail_out > 0) {
+                if (m_stream.avail_in == 0) {
+                    if (!fill(64 * 1024))
+                        break;
+                    m_stream.next_in  = reinterpret_cast<Bytef *>(m_input.data());
+                    m_stream.avail_in = uInt(m_input.size());
+                }
+                const int status = inflate(&m_stream, Z_NO_FLUSH);
+                if (status == Z_STREAM_END)
+                    break;
+                if (status != Z_OK) {
+                    setErrorString(QStringLiteral("Corrupt deflate data in archive entry"));
+                    return -1;
+                }
+            }
+            produced = qint64(reinterpret_cast<char *>(m_stream.next_out) - data);
+            if (produced == 0) {
+                setErrorString(QStringLiteral("Unexpected end of archive entry"));
+                return -1;
+            }
+#else
+            return -1;
+#endif
+        }
+
+        m_outPos += produced;
+#ifdef QXLSX_HAVE_ZLIB
+        m_crcSoFar =
+            quint32(crc32(m_crcSoFar, reinterpret_cast<const Bytef *>(data), uInt(produced)));
+        if (m_outPos == m_size && m_crcSoFar != m_crc) {
+            setErrorString(QStringLiteral("CRC mismatch in archive entry"));
+            return -1;
+        }
+#endif
+        return produced;
+    }
+
+    QIODevice *m_source;
+    QMutex *m_sourceMutex;
+    qint64 m_dataOffset;
+    quint16 m_method;
+    quint32 m_crc;
+    qint64 m_compressedSize;
+    qint64 m_size;
+
+    QByteArray m_input;
+    qint64 m_inPos     = 0; // compressed bytes read
+    qint64 m_outPos    = 0; // uncompressed bytes produced
+    quint32 m_crcSoFar = 0;
+#ifdef QXLSX_HAVE_ZLIB
+    z_stream m_stream = z_stream();
+    bool m_inflating  = false;
+#endif
+};
+
+} // namespace
+
 ZipReader::ZipReader(const QString &filePath)
-    : m_reader(new QZipReader(filePath))
+    : m_file(new QFile(filePath))
 {
+    m_file->open(QIODevice::ReadOnly);
+    m_device = m_file.data();
+    m_reader.reset(new QZipReader(m_device));
     init();
 }
 
 ZipReader::ZipReader(QIODevice *device)
-    : m_reader(new QZipReader(device))
+    : m_device(device)
+    , m_reader(new QZipReader(device))
 {
     init();
 }
@@ -46,4 +266,117 @@ QByteArray ZipReader::fileData(const QString &fileName) const
     return m_reader->fileData(fileName);
 }
 
+std::unique_ptr<QIODevice> ZipReader::openFile(const QString &fileName) const
+{
+    if (!m_filePaths.contains(fileName))
+        return nullptr;
+
+    if (readDirectory()) {
+        auto it = m_entries.constFind(fileName);
+        if (it != m_entries.constEnd()) {
+            const Entry &entry = it.value();
+            QByteArray header;
+            {
+                QMutexLocker locker(&m_deviceMutex);
+                if (m_device->seek(entry.localHeaderOffset))
+                    header = m_device->read(LocalHeaderSize);
+            }
+            if (header.size() == LocalHeaderSize &&
+                readUInt32(header, 0) == LocalHeaderSignature) {
+                const qint64 dataOffset = entry.localHeaderOffset + LocalHeaderSize +
+                                          readUInt16(header, 26) + readUInt16(header, 28);
+                std::unique_ptr<QIODevice> device(new ZipEntryDevice(m_device,
+                                                                     &m_deviceMutex,
+                                                                     dataOffset,
+                                                                     entry.method,
+                                                                     entry.crc,
+                                                                     entry.compressedSize,
+                                                                     entry.size));
+                if (device->open(QIODevice::ReadOnly))
+                    return device;
+            }
+        }
+    }
+
+    std::unique_ptr<QBuffer> buffer(new QBuffer);
+    buffer->setData(fileData(fileName));
+    buffer->open(QIODevice::ReadOnly);
+    return std::move(buffer);
+}
+
+// Indexes the central directory for openFile(). Entries that can't be
+// streamed are left out, which makes openFile() use fileData() for them.
+bool ZipReader::readDirectory() const
+{
+    if (m_directoryRead)
+        return !m_entries.isEmpty();
+    m_directoryRead = true;
+
+    if (!m_device || !m_device->isOpen() || m_device->isSequential())
+        return false;
+
+    const qint64 archiveSize = m_device->size();
+    const qint64 tailSize    = qMin<qint64>(archiveSize, EndOfDirectorySize + 0xFFFF);
+    if (tailSize < EndOfDirectorySize || !m_device->seek(archiveSize - tailSize))
+        return false;
+    const QByteArray tail = m_device->read(tailSize);
+
+    int end = -1;
+    for (int i = tail.size() - EndOfDirectorySize; i >= 0; --i) {
+        if (readUInt32(tail, i) == EndOfDirectorySignature) {
+            end = i;
+            break;
+        }
+    }
+    if (end < 0)
+        return false;
+
+    const quint16 entryCount      = readUInt16(tail, end + 10);
+    const quint32 directorySize   = readUInt32(tail, end + 12);
+    const quint32 directoryOffset = readUInt32(tail, end + 16);
+    if (entryCount == 0xFFFF || directorySize == 0xFFFFFFFF || directoryOffset == 0xFFFFFFFF)
+        return false; // Zip64
+    if (!m_device->seek(directoryOffset))
+        return false;
+    const QByteArray directory = m_device->read(directorySize);
+    if (directory.size() != int(directorySize))
+        return false;
+
+    int pos = 0;
+    for (int i = 0; i < entryCount; ++i) {
+        if (pos + CentralHeaderSize > directory.size() ||
+            readUInt32(directory, pos) != CentralHeaderSignature)
+            break;
+        const int nameLength    = readUInt16(directory, pos + 28);
+        const int extraLength   = readUInt16(directory, pos + 30);
+        const int commentLength = readUInt16(directory, pos + 32);
+        if (pos + CentralHeaderSize + nameLength > directory.size())
+            break;
+
+        Entry entry;
+        entry.method            = readUInt16(directory, pos + 10);
+        entry.crc               = readUInt32(directory, pos + 16);
+        entry.compressedSize    = readUInt32(directory, pos + 20);
+        entry.size              = readUInt32(directory, pos + 24);
+        entry.localHeaderOffset = readUInt32(directory, pos + 42);
+
+        const bool encrypted = (readUInt16(directory, pos + 8) & 0x1) != 0;
+        bool streamable      = !encrypted && entry.compressedSize != 0xFFFFFFFF &&
+                          entry.size != 0xFFFFFFFF && entry.localHeaderOffset != 0xFFFFFFFF;
+#ifdef QXLSX_HAVE_ZLIB
+        streamable = streamable &&
+                     (entry.method == MethodStored || entry.method == MethodDeflated);
+#else
+        streamable = streamable && entry.method == MethodStored;
+#endif
+        if (streamable) {
+            const QString name =
+                QString::fromUtf8(directory.constData() + pos + CentralHeaderSize, nameLength);
+            m_entries.insert(name, entry);
+        }
+        pos += CentralHeaderSize + nameLength + extraLength + commentLength;
+    }
+    return !m_entries.isEmpty();
+}
+
 QT_END_NAMESPACE_XLSX
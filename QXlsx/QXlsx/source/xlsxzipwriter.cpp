@@ -2,12 +2,485 @@
 
 #include "xlsxzipwriter_p.h"
 
-#include <private/qzipwriter_p.h>
-
+#include <QDateTime>
 #include <QDebug>
+#include <QFile>
+#include <QtEndian>
+
+#ifdef QXLSX_HAVE_ZLIB
+#    ifdef QXLSX_HAVE_QT_ZLIB
+#        include <QtZlib/zlib.h>
+#    else
+#        include <zlib.h>
+#    endif
+#else
+#    include <private/qzipwriter_p.h>
+#endif
 
 QT_BEGIN_NAMESPACE_XLSX
 
+#ifdef QXLSX_HAVE_ZLIB
+
+namespace {
+
+const quint32 LocalHeaderSignature    = 0x04034b50;
+const quint32 CentralHeaderSignature  = 0x02014b50;
+const quint32 EndOfDirectorySignature = 0x06054b50;
+const quint32 DataDescriptorSignature = 0x08074b50;
+
+const quint16 VersionNeeded  = 20;
+const quint16 VersionMadeBy  = (3 << 8) | 20; // Unix, so the file mode below is used
+const quint32 FileAttributes = quint32(0100644) << 16;
+const quint16 FlagDescriptor = 0x0008; // sizes and CRC follow the data
+const quint16 FlagUtf8Name   = 0x0800;
+
+void appendUInt16(QByteArray &out, quint16 value)
+{
+    char bytes[2];
+    qToLittleEndian(value, bytes);
+    out.append(bytes, 2);
+}
+
+void appendUInt32(QByteArray &out, quint32 value)
+{
+    char bytes[4];
+    qToLittleEndian(value, bytes);
+    out.append(bytes, 4);
+}
+
+// Every entry gets the time the archive was written
+void toDosDateTime(const QDateTime &dateTime, quint16 *dosDate, quint16 *dosTime)
+{
+    const QDate date = dateTime.date();
+    const QTime time = dateTime.time();
+    *dosDate = quint16(((date.year() - 1980) << 9) | (date.month() << 5) | date.day());
+    *dosTime = quint16((time.hour() << 11) | (time.minute() << 5) | (time.second() / 2));
+}
+
+} // namespace
+
+// Compresses what is written to it, straight into the archive (see
+// openEntry()) or into an Entry (see compressTo()). In the archive the sizes
+// and CRC aren't known up front. For deflated data the local header leaves
+// them zero and a data descriptor after the data has them. Readers find the
+// end of stored data from the header alone, so stored entries get no
+// descriptor: the header is filled in afterwards on a seekable device, and on
+// others the entry is held back until it is closed.
+class ZipWriter::EntryDevice : public QIODevice
+{
+public:
+    EntryDevice(ZipWriter *writer, const QString &filePath, int level)
+        : m_writer(writer)
+        , m_buffer(64 * 1024, Qt::Uninitialized)
+    {
+        m_record.name   = filePath.toUtf8();
+        m_record.flags  = m_record.name == filePath.toLatin1() ? 0 : FlagUtf8Name;
+        m_record.offset = quint32(m_writer->m_offset);
+        init(level);
+        if (m_deflating)
+            m_record.flags |= FlagDescriptor;
+
+        m_holdBack = !m_deflating && m_writer->m_device->isSequential();
+        if (!m_holdBack)
+            m_writer->writeLocalHeader(m_record);
+        m_writer->m_openEntry = this;
+        QIODevice::open(QIODevice::WriteOnly);
+    }
+
+    EntryDevice(Entry *entry, int level)
+        : m_entry(entry)
+        , m_buffer(64 * 1024, Qt::Uninitialized)
+    {
+        *m_entry = Entry();
+        init(level);
+        QIODevice::open(QIODevice::WriteOnly);
+    }
+
+    ~EntryDevice() override { close(); }
+
+    void close() override
+    {
+        if (!isOpen())
+            return;
+        if (m_deflating) {
+            deflateData(nullptr, 0, Z_FINISH);
+            deflateEnd(&m_stream);
+            m_deflating = false;
+        }
+
+        if (m_entry) {
+            m_entry->method = m_record.method;
+            m_entry->crc    = m_crc;
+            m_entry->size   = m_size;
+            QIODevice::close();
+            return;
+        }
+
+        const qint64 limit = 0xFFFFFFFFLL;
+        if (m_size > limit || m_compressedSize > limit) {
+            qWarning("ZipWriter: archive too large without Zip64");
+            m_writer->m_error = true;
+        }
+        m_record.crc            = m_crc;
+        m_record.compressedSize = quint32(m_compressedSize);
+        m_record.size           = quint32(m_size);
+
+        if (m_record.flags & FlagDescriptor) {
+            QByteArray descriptor;
+            appendUInt32(descriptor, DataDescriptorSignature);
+            appendUInt32(descriptor, m_record.crc);
+            appendUInt32(descriptor, m_record.compressedSize);
+            appendUInt32(descriptor, m_record.size);
+            m_writer->write(descriptor);
+        } else if (m_holdBack) {
+            m_writer->writeLocalHeader(m_record);
+            m_writer->write(m_held);
+            m_held.clear();
+        } else {
+            m_writer->patchLocalHeader(m_record);
+        }
+        m_writer->m_records.append(m_record);
+        m_writer->m_openEntry = nullptr;
+        QIODevice::close();
+    }
+
+protected:
+    qint64 readData(char *, qint64) override { return -1; }
+
+    qint64 writeData(const char *data, qint64 size) override
+    {
+        m_crc = quint32(crc32(m_crc, reinterpret_cast<const Bytef *>(data), uInt(size)));
+        m_size += size;
+        if (m_deflating)
+            deflateData(data, size, Z_NO_FLUSH);
+        else
+            output(data, int(size));
+        return m_writer && m_writer->m_error ? -1 : size;
+    }
+
+private:
+    void init(int level)
+    {
+        if (level != 0)
+            m_deflating = deflateInit2(&m_stream, qBound(-1, level, 9), Z_DEFLATED, -MAX_WBITS,
+                                       8, Z_DEFAULT_STRATEGY) == Z_OK;
+        m_record.method = m_deflating ? 8 : 0;
+    }
+
+    void deflateData(const char *data, qint64 size, int flush)
+    {
+        m_stream.next_in  = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+        m_stream.avail_in = uInt(size);
+        do {
+            m_stream.next_out  = reinterpret_cast<Bytef *>(m_buffer.data());
+            m_stream.avail_out = uInt(m_buffer.size());
+            deflate(&m_stream, flush);
+            output(m_buffer.constData(), m_buffer.size() - int(m_stream.avail_out));
+        } while (m_stream.avail_out == 0);
+    }
+
+    void output(const char *data, int size)
+    {
+        if (m_entry)
+            m_entry->data.append(data, size);
+        else if (m_holdBack)
+            m_held.append(data, size);
+        else
+            m_writer->write(QByteArray::fromRawData(data, size));
+        m_compressedSize += size;
+    }
+
+    ZipWriter *m_writer = nullptr; // the archive written to, or
+    Entry *m_entry      = nullptr; // the entry filled in
+    Record m_record;
+    QByteArray m_buffer;
+    z_stream m_stream       = z_stream();
+    bool m_deflating        = false;
+    bool m_holdBack         = false; // stored, on a sequential device
+    QByteArray m_held;               // the held back data
+    quint32 m_crc           = 0;
+    qint64 m_size           = 0;
+    qint64 m_compressedSize = 0;
+};
+
+ZipWriter::ZipWriter(const QString &filePath)
+    : m_file(new QFile(filePath))
+{
+    m_device = m_file.data();
+    m_error  = !m_file->open(QIODevice::WriteOnly);
+
+    toDosDateTime(QDateTime::currentDateTime(), &m_dosDate, &m_dosTime);
+}
+
+ZipWriter::ZipWriter(QIODevice *device)
+    : m_device(device)
+{
+    if (!m_device->isOpen())
+        m_device->open(QIODevice::WriteOnly);
+    m_error = !m_device->isWritable();
+
+    toDosDateTime(QDateTime::currentDateTime(), &m_dosDate, &m_dosTime);
+}
+
+ZipWriter::~ZipWriter()
+{
+    if (!m_closed)
+        close();
+}
+
+bool ZipWriter::error() const
+{
+    return m_error;
+}
+
+void ZipWriter::addFile(const QString &filePath, QIODevice *device)
+{
+    const bool opened = !device->isOpen();
+    if (opened && !device->open(QIODevice::ReadOnly)) {
+        m_error = true;
+        return;
+    }
+    addFile(filePath, device->readAll());
+    if (opened)
+        device->close();
+}
+
+void ZipWriter::addFile(const QString &filePath, const QByteArray &data)
+{
+    if (m_error)
+        return;
+    addEntry(filePath, compress(data, compressionLevel(filePath, data.size())));
+}
+
+void ZipWriter::addEntry(const QString &filePath, const Entry &entry)
+{
+    if (m_error || m_closed)
+        return;
+    if (m_openEntry) {
+        qWarning("ZipWriter: an entry is still being written");
+        m_error = true;
+        return;
+    }
+    const qint64 limit = 0xFFFFFFFFLL;
+    if (entry.size > limit || entry.data.size() > limit || m_offset > limit ||
+        m_records.size() >= 0xFFFF) {
+        qWarning("ZipWriter: archive too large without Zip64");
+        m_error = true;
+        return;
+    }
+
+    Record record;
+    record.name           = filePath.toUtf8();
+    record.flags          = record.name == filePath.toLatin1() ? 0 : FlagUtf8Name;
+    record.method         = entry.method;
+    record.crc            = entry.crc;
+    record.compressedSize = quint32(entry.data.size());
+    record.size           = quint32(entry.size);
+    record.offset         = quint32(m_offset);
+
+    writeLocalHeader(record);
+    write(entry.data);
+    m_records.append(record);
+}
+
+std::unique_ptr<QIODevice> ZipWriter::openEntry(const QString &filePath)
+{
+    if (m_error || m_closed)
+        return nullptr;
+    if (m_openEntry || m_offset > 0xFFFFFFFFLL || m_records.size() >= 0xFFFF) {
+        qWarning("ZipWriter: cannot open another entry");
+        m_error = true;
+        return nullptr;
+    }
+    return std::unique_ptr<QIODevice>(
+        new EntryDevice(this, filePath, compressionLevel(filePath, -1)));
+}
+
+void ZipWriter::writeLocalHeader(const Record &record)
+{
+    QByteArray header;
+    header.reserve(30 + record.name.size());
+    appendUInt32(header, LocalHeaderSignature);
+    appendUInt16(header, VersionNeeded);
+    appendUInt16(header, record.flags);
+    appendUInt16(header, record.method);
+    appendUInt16(header, m_dosTime);
+    appendUInt16(header, m_dosDate);
+    appendUInt32(header, record.crc);
+    appendUInt32(header, record.compressedSize);
+    appendUInt32(header, record.size);
+    appendUInt16(header, quint16(record.name.size()));
+    appendUInt16(header, 0); // extra field length
+    header.append(record.name);
+    write(header);
+}
+
+void ZipWriter::patchLocalHeader(const Record &record)
+{
+    if (m_error)
+        return;
+
+    QByteArray fields;
+    appendUInt32(fields, record.crc);
+    appendUInt32(fields, record.compressedSize);
+    appendUInt32(fields, record.size);
+
+    // The device may not have started at position 0
+    const qint64 end    = m_device->pos();
+    const qint64 header = end - (m_offset - record.offset);
+    if (!m_device->seek(header + 14) || m_device->write(fields) != fields.size() ||
+        !m_device->seek(end))
+        m_error = true;
+}
+
+void ZipWriter::close()
+{
+    if (m_openEntry)
+        m_openEntry->close();
+    if (m_closed)
+        return;
+    m_closed = true;
+
+    const qint64 directoryOffset = m_offset;
+    QByteArray directory;
+    for (int i = 0; i < m_records.size(); ++i) {
+        const Record &record = m_records.at(i);
+        appendUInt32(directory, CentralHeaderSignature);
+        appendUInt16(directory, VersionMadeBy);
+        appendUInt16(directory, VersionNeeded);
+        appendUInt16(directory, record.flags);
+        appendUInt16(directory, record.method);
+        appendUInt16(directory, m_dosTime);
+        appendUInt16(directory, m_dosDate);
+        appendUInt32(directory, record.crc);
+        appendUInt32(directory, record.compressedSize);
+        appendUInt32(directory, record.size);
+        appendUInt16(directory, quint16(record.name.size()));
+        appendUInt16(directory, 0); // extra field length
+        appendUInt16(directory, 0); // comment length
+        appendUInt16(directory, 0); // disk number
+        appendUInt16(directory, 0); // internal attributes
+        appendUInt32(directory, FileAttributes);
+        appendUInt32(directory, record.offset);
+        directory.append(record.name);
+    }
+    write(directory);
+
+    QByteArray end;
+    appendUInt32(end, EndOfDirectorySignature);
+    appendUInt16(end, 0); // this disk
+    appendUInt16(end, 0); // disk with the central directory
+    appendUInt16(end, quint16(m_records.size()));
+    appendUInt16(end, quint16(m_records.size()));
+    appendUInt32(end, quint32(directory.size()));
+    appendUInt32(end, quint32(directoryOffset));
+    appendUInt16(end, 0); // comment length
+    write(end);
+
+    if (m_file)
+        m_file->close();
+}
+
+void ZipWriter::write(const QByteArray &bytes)
+{
+    if (m_error)
+        return;
+    if (m_device->write(bytes) != bytes.size())
+        m_error = true;
+    m_offset += bytes.size();
+}
+
+ZipWriter::Entry ZipWriter::compress(const QByteArray &data, int level)
+{
+    Entry entry;
+    entry.size = data.size();
+    entry.crc  = quint32(crc32(0L, reinterpret_cast<const Bytef *>(data.constData()),
+                              uInt(data.size())));
+
+    z_stream stream = z_stream();
+    if (level != 0 &&
+        deflateInit2(&stream, qBound(-1, level, 9), Z_DEFLATED, -MAX_WBITS, 8,
+                     Z_DEFAULT_STRATEGY) == Z_OK) {
+        QByteArray deflated;
+        deflated.resize(int(deflateBound(&stream, uLong(data.size()))));
+        stream.next_in   = reinterpret_cast<Bytef *>(const_cast<char *>(data.constData()));
+        stream.avail_in  = uInt(data.size());
+        stream.next_out  = reinterpret_cast<Bytef *>(deflated.data());
+        stream.avail_out = uInt(deflated.size());
+        const bool done  = deflate(&stream, Z_FINISH) == Z_STREAM_END;
+        deflated.resize(int(stream.total_out));
+        deflateEnd(&stream);
+
+        if (done && deflated.size() < data.size()) {
+            entry.method = 8;
+            entry.data   = deflated;
+            return entry;
+        }
+    }
+
+    entry.data = data;
+    return entry;
+}
+
+std::unique_ptr<QIODevice> ZipWriter::compressTo(Entry *entry, int level)
+{
+    return std::unique_ptr<QIODevice>(new EntryDevice(entry, level));
+}
+
+#else // QXLSX_HAVE_ZLIB
+
+// Without zlib the part is collected, and handed to QZipWriter or put in
+// the Entry when closed
+class ZipWriter::EntryDevice : public QIODevice
+{
+public:
+    EntryDevice(ZipWriter *writer, const QString &filePath)
+        : m_writer(writer)
+        , m_filePath(filePath)
+    {
+        m_writer->m_openEntry = this;
+        QIODevice::open(QIODevice::WriteOnly);
+    }
+
+    EntryDevice(Entry *entry, int level)
+        : m_entry(entry)
+        , m_level(level)
+    {
+        QIODevice::open(QIODevice::WriteOnly);
+    }
+
+    ~EntryDevice() override { close(); }
+
+    void close() override
+    {
+        if (!isOpen())
+            return;
+        if (m_entry) {
+            *m_entry = compress(m_data, m_level);
+        } else {
+            m_writer->m_openEntry = nullptr;
+            m_writer->addFile(m_filePath, m_data);
+        }
+        QIODevice::close();
+    }
+
+protected:
+    qint64 readData(char *, qint64) override { return -1; }
+
+    qint64 writeData(const char *data, qint64 size) override
+    {
+        m_data.append(data, int(size));
+        return size;
+    }
+
+private:
+    ZipWriter *m_writer = nullptr;
+    QString m_filePath;
+    Entry *m_entry = nullptr;
+    int m_level    = -1;
+    QByteArray m_data;
+};
+
 ZipWriter::ZipWriter(const QString &filePath)
 {
     m_writer = new QZipWriter(filePath, QIODevice::WriteOnly);
@@ -22,6 +495,8 @@ ZipWriter::ZipWriter(QIODevice *device)
 
 ZipWriter::~ZipWriter()
 {
+    if (m_openEntry)
+        m_openEntry->close();
     delete m_writer;
 }
 
@@ -32,17 +507,71 @@ bool ZipWriter::error() const
 
 void ZipWriter::addFile(const QString &filePath, QIODevice *device)
 {
+    m_writer->setCompressionPolicy(compressionLevel(filePath, device->size()) == 0
+                                       ? QZipWriter::NeverCompress
+                                       : QZipWriter::AutoCompress);
     m_writer->addFile(filePath, device);
 }
 
 void ZipWriter::addFile(const QString &filePath, const QByteArray &data)
 {
-    m_writer->addFile(filePath, data);
+    addEntry(filePath, compress(data, compressionLevel(filePath, data.size())));
+}
+
+// Without zlib the entry holds the part itself and QZipWriter deflates it
+// here, unless compress() was asked to store it
+void ZipWriter::addEntry(const QString &filePath, const Entry &entry)
+{
+    m_writer->setCompressionPolicy(entry.method == 0 ? QZipWriter::NeverCompress
+                                                     : QZipWriter::AutoCompress);
+    m_writer->addFile(filePath, entry.data);
+}
+
+std::unique_ptr<QIODevice> ZipWriter::openEntry(const QString &filePath)
+{
+    if (m_openEntry) {
+        qWarning("ZipWriter: cannot open another entry");
+        return nullptr;
+    }
+    return std::unique_ptr<QIODevice>(new EntryDevice(this, filePath));
 }
 
 void ZipWriter::close()
 {
+    if (m_openEntry)
+        m_openEntry->close();
     m_writer->close();
 }
 
+ZipWriter::Entry ZipWriter::compress(const QByteArray &data, int level)
+{
+    Entry entry;
+    entry.data   = data;
+    entry.method = level == 0 ? 0 : 8;
+    entry.size   = data.size();
+    return entry;
+}
+
+std::unique_ptr<QIODevice> ZipWriter::compressTo(Entry *entry, int level)
+{
+    return std::unique_ptr<QIODevice>(new EntryDevice(entry, level));
+}
+
+#endif // QXLSX_HAVE_ZLIB
+
+void ZipWriter::setCompressionLevel(int level)
+{
+    m_level = [level](const QString &, qint64) { return level; };
+}
+
+void ZipWriter::setCompressionLevel(const LevelFunction &level)
+{
+    m_level = level;
+}
+
+int ZipWriter::compressionLevel(const QString &filePath, qint64 size) const
+{
+    return m_level ? m_level(filePath, size) : -1;
+}
+
 QT_END_NAMESPACE_XLSX
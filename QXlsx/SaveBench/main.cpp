@@ -0,0 +1,105 @@
+#include <QBuffer>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QDebug>
+
+#include "xlsxdocument.h"
+
+using namespace QXlsx;
+
+// Same deterministic content as the LargeData example
+static QVariant make_cell_value(int row, int col)
+{
+    // Even columns → integer, odd columns → string
+    if (col % 2 == 0) {
+        return row * 1000 + col;
+    } else {
+        return QStringLiteral("R%1C%2").arg(row).arg(col);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        QStringLiteral("Save time and file size for each compression policy"));
+    parser.addHelpOption();
+    QCommandLineOption rowsOpt(QStringList() << QStringLiteral("r") << QStringLiteral("rows"),
+                               QStringLiteral("Number of rows"),
+                               QStringLiteral("rows"),
+                               QStringLiteral("100000"));
+    QCommandLineOption colsOpt(QStringList() << QStringLiteral("c") << QStringLiteral("cols"),
+                               QStringLiteral("Number of columns"),
+                               QStringLiteral("cols"),
+                               QStringLiteral("10"));
+    QCommandLineOption passesOpt(QStringList() << QStringLiteral("p") << QStringLiteral("passes"),
+                                 QStringLiteral("Saves per policy; the fastest is reported"),
+                                 QStringLiteral("passes"),
+                                 QStringLiteral("3"));
+    parser.addOption(rowsOpt);
+    parser.addOption(colsOpt);
+    parser.addOption(passesOpt);
+    parser.process(app);
+
+    const int rows   = parser.value(rowsOpt).toInt();
+    const int cols   = parser.value(colsOpt).toInt();
+    const int passes = qMax(1, parser.value(passesOpt).toInt());
+
+    Document xlsx;
+    for (int row = 1; row <= rows; ++row) {
+        for (int col = 1; col <= cols; ++col)
+            xlsx.write(row, col, make_cell_value(row, col));
+    }
+
+    typedef Document::SaveOptions Options;
+    struct Policy {
+        const char *name;
+        Options options;
+    };
+    QList<Policy> policies;
+    Options options;
+    options.compression = Options::NoCompression;
+    policies.append({"store", options});
+    options.compression = Options::FastCompression;
+    policies.append({"fast", options});
+    options.compression = Options::DefaultCompression;
+    policies.append({"default", options});
+    options.compression = Options::BestCompression;
+    policies.append({"best", options});
+    // Sheet XML deflated quickly, the small parts around it stored
+    options.compression = Options::FastCompression;
+    options.storeBelow  = 4096;
+    policies.append({"fast+store<4K", options});
+
+    qDebug() << "Workload:" << rows << "rows x" << cols << "cols," << passes << "passes";
+
+    for (const Policy &policy : policies) {
+        qint64 best = -1;
+        qint64 size = 0;
+        for (int i = 0; i < passes; ++i) {
+            // Save to memory, so disk speed doesn't blur the comparison
+            QBuffer buffer;
+            buffer.open(QIODevice::WriteOnly);
+            QElapsedTimer timer;
+            timer.start();
+            if (!xlsx.saveAs(&buffer, policy.options)) {
+                qCritical() << "Failed to save with policy" << policy.name;
+                return 1;
+            }
+            const qint64 elapsed = timer.elapsed();
+            if (best < 0 || elapsed < best)
+                best = elapsed;
+            size = buffer.data().size();
+        }
+
+        qDebug().noquote() << QStringLiteral("%1  %2 ms  %3 KB")
+                                  .arg(QLatin1String(policy.name), -14)
+                                  .arg(best, 6)
+                                  .arg(size / 1024, 8);
+    }
+
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QDebug>
+
+#include "xlsxscan_p.h"
+
+using namespace QXlsx;
+
+// Build a <sheetData> like buffer: mostly ASCII markup with some UTF-8 text
+static QByteArray make_sheet_xml(int rows)
+{
+    QByteArray xml;
+    xml.reserve(rows * 160);
+    for (int r = 1; r <= rows; ++r) {
+        xml += "<row r=\"" + QByteArray::number(r) + "\" spans=\"1:3\">";
+        xml += "<c r=\"A" + QByteArray::number(r) + "\"><v>" + QByteArray::number(r * 3) + "</v></c>";
+        xml += "<c r=\"B" + QByteArray::number(r) + "\" t=\"s\"><v>" + QByteArray::number(r % 97)
+             + "</v></c>";
+        xml += "<c r=\"C" + QByteArray::number(r) + "\" t=\"inlineStr\"><is><t>";
+        xml += (r % 8 == 0) ? QStringLiteral("Größe %1 — Ω").arg(r).toUtf8()
+                            : QByteArray("plain text ") + QByteArray::number(r);
+        xml += "</t></is></c></row>";
+    }
+    return xml;
+}
+
+template<typename F>
+static double measure(const QByteArray &xml, int passes, F scan)
+{
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < passes; ++i)
+        scan();
+    const double seconds = timer.nsecsElapsed() / 1e9;
+    return (double(xml.size()) * passes) / (1024.0 * 1024.0) / seconds;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Throughput of the XML scanning kernels"));
+    parser.addHelpOption();
+    QCommandLineOption rowsOpt(QStringList() << QStringLiteral("r") << QStringLiteral("rows"),
+                               QStringLiteral("Number of generated rows"),
+                               QStringLiteral("rows"),
+                               QStringLiteral("200000"));
+    QCommandLineOption passesOpt(QStringList() << QStringLiteral("p") << QStringLiteral("passes"),
+                                 QStringLiteral("Passes over the buffer per kernel"),
+                                 QStringLiteral("passes"),
+                                 QStringLiteral("20"));
+    parser.addOption(rowsOpt);
+    parser.addOption(passesOpt);
+    parser.process(app);
+
+    const int rows   = parser.value(rowsOpt).toInt();
+    const int passes = parser.value(passesOpt).toInt();
+
+    const QByteArray xml = make_sheet_xml(rows);
+    const char *begin    = xml.constData();
+    const char *end      = begin + xml.size();
+
+    qDebug() << "Buffer size:" << xml.size() / 1024 << "KB," << passes << "passes";
+    qDebug() << "Selected kernels:" << Scan::kernels().name;
+
+    for (const Scan::Kernels *k : Scan::availableKernels()) {
+        // Each pass walks the whole buffer the way the readers do; the counts
+        // keep the loops from being optimized away and must agree
+        qint64 tags   = 0;
+        qint64 quotes = 0;
+        bool valid    = true;
+
+        const double findByteRate = measure(xml, passes, [&] {
+            for (const char *p = k->findByte(begin, end, '<'); p != end;
+                 p = k->findByte(p + 1, end, '<'))
+                ++tags;
+        });
+        const double findEitherRate = measure(xml, passes, [&] {
+            for (const char *p = k->findEither(begin, end, '"', '&'); p != end;
+                 p = k->findEither(p + 1, end, '"', '&'))
+                ++quotes;
+        });
+        const double utf8Rate = measure(xml, passes, [&] { valid &= k->isValidUtf8(begin, end); });
+
+        qDebug().noquote() << QStringLiteral("%1  findByte %2 MB/s  findEither %3 MB/s  "
+                                             "isValidUtf8 %4 MB/s  (%5 tags, %6 quotes, %7)")
+                                  .arg(QLatin1String(k->name), -6)
+                                  .arg(findByteRate, 0, 'f', 0)
+                                  .arg(findEitherRate, 0, 'f', 0)
+                                  .arg(utf8Rate, 0, 'f', 0)
+                                  .arg(tags / passes)
+                                  .arg(quotes / passes)
+                                  .arg(valid ? QStringLiteral("valid") : QStringLiteral("INVALID"));
+    }
+
+    return 0;
+}
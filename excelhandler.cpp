@@ -1,5 +1,602 @@
 #include "excelhandler.h"
 
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QJsonDocument>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// ==================== ExcelSheetStore Implementation ====================
+
+namespace {
+// Markers for typed columns; real ints equal to them go to the overflow map
+const qint32 kNullCell = std::numeric_limits<qint32>::min();
+const qint32 kOverflowCell = kNullCell + 1;
+
+qint32 encodeInt(const QVariant &value)
+{
+  bool ok = false;
+  qint64 number = 0;
+
+  switch (value.userType()) {
+  case QMetaType::Int:
+  case QMetaType::UInt:
+  case QMetaType::LongLong:
+  case QMetaType::ULongLong:
+    number = value.toLongLong(&ok);
+    break;
+  case QMetaType::Double: {
+    // xlsx numbers arrive as double
+    double d = value.toDouble();
+    if (std::floor(d) == d && d > kOverflowCell && d <= std::numeric_limits<qint32>::max()) {
+      number = static_cast<qint64>(d);
+      ok = true;
+    }
+    break;
+  }
+  default:
+    // Text, even "007", stays text in the overflow map so it saves as it came
+    break;
+  }
+
+  if (!ok || number <= kOverflowCell || number > std::numeric_limits<qint32>::max())
+    return kOverflowCell;
+  return static_cast<qint32>(number);
+}
+}
+
+ExcelSheetStore::ColumnType ExcelSheetStore::columnType(int column)
+{
+  // 0=Part Name, 1=Part No, 2=Stock/Purchase, 3=Department, 4=Prepared, 5=Approved, 6=Vendor
+  switch (column) {
+  case 0:
+  case 3:
+  case 6:
+    return StringColumn;
+  case 2:
+    return IntColumn;
+  default:
+    return VariantColumn;
+  }
+}
+
+void ExcelSheetStore::reset(int columns)
+{
+  clear();
+  m_columns.resize(columns);
+  for (int col = 0; col < columns; ++col)
+    m_columns[col].type = columnType(col);
+}
+
+void ExcelSheetStore::reserve(int rows)
+{
+  for (Column &column : m_columns) {
+    if (column.type == VariantColumn)
+      column.variants.reserve(rows);
+    else
+      column.cells.reserve(rows);
+  }
+}
+
+void ExcelSheetStore::clear()
+{
+  m_columns.clear();
+  m_strings.clear();
+  m_stringIds.clear();
+  m_rowCount = 0;
+}
+
+void ExcelSheetStore::appendRow(const QVector<QVariant> &row)
+{
+  appendEmptyRow();
+
+  int last = m_rowCount - 1;
+  int cols = qMin(int(row.size()), int(m_columns.size()));
+  for (int col = 0; col < cols; ++col)
+    setValue(last, col, row[col]);
+}
+
+void ExcelSheetStore::appendEmptyRow()
+{
+  for (Column &column : m_columns) {
+    if (column.type == VariantColumn)
+      column.variants.append(QVariant());
+    else
+      column.cells.append(kNullCell);
+  }
+  ++m_rowCount;
+}
+
+void ExcelSheetStore::appendColumn()
+{
+  Column column;
+  column.type = columnType(m_columns.size());
+  if (column.type == VariantColumn)
+    column.variants.resize(m_rowCount);
+  else
+    column.cells.fill(kNullCell, m_rowCount);
+  m_columns.append(column);
+}
+
+QVariant ExcelSheetStore::value(int row, int column) const
+{
+  const Column &col = m_columns[column];
+  if (col.type == VariantColumn)
+    return col.variants[row];
+
+  qint32 cell = col.cells[row];
+  if (cell == kNullCell)
+    return QVariant();
+  if (cell == kOverflowCell)
+    return col.overflow.value(row);
+  if (col.type == IntColumn)
+    return cell;
+  return m_strings[cell];
+}
+
+QString ExcelSheetStore::text(int row, int column) const
+{
+  const Column &col = m_columns[column];
+  if (col.type == StringColumn && col.cells[row] >= 0)
+    return m_strings[col.cells[row]];
+  return value(row, column).toString();
+}
+
+int ExcelSheetStore::intValue(int row, int column) const
+{
+  const Column &col = m_columns[column];
+  if (col.type == IntColumn) {
+    qint32 cell = col.cells[row];
+    if (cell == kNullCell)
+      return 0;
+    if (cell != kOverflowCell)
+      return cell;
+  }
+  return value(row, column).toInt();
+}
+
+void ExcelSheetStore::setValue(int row, int column, const QVariant &value)
+{
+  Column &col = m_columns[column];
+  if (col.type == VariantColumn) {
+    col.variants[row] = value;
+    return;
+  }
+
+  qint32 cell = kOverflowCell;
+  if (!value.isValid())
+    cell = kNullCell;
+  else if (col.type == IntColumn)
+    cell = encodeInt(value);
+  else if (value.userType() == QMetaType::QString)
+    cell = intern(value.toString());
+
+  if (col.cells[row] == kOverflowCell)
+    col.overflow.remove(row);
+  if (cell == kOverflowCell)
+    col.overflow.insert(row, value);
+  col.cells[row] = cell;
+}
+
+QVector<QVector<QVariant>> ExcelSheetStore::toRows() const
+{
+  QVector<QVector<QVariant>> rows;
+  rows.reserve(m_rowCount);
+
+  for (int row = 0; row < m_rowCount; ++row) {
+    QVector<QVariant> rowData;
+    rowData.reserve(m_columns.size());
+    for (int col = 0; col < m_columns.size(); ++col)
+      rowData.append(value(row, col));
+    rows.append(rowData);
+  }
+
+  return rows;
+}
+
+qint32 ExcelSheetStore::intern(const QString &text)
+{
+  auto it = m_stringIds.constFind(text);
+  if (it != m_stringIds.constEnd())
+    return it.value();
+
+  qint32 id = m_strings.size();
+  m_strings.append(text);
+  m_stringIds.insert(text, id);
+  return id;
+}
+
+// ==================== ExcelSearchIndex Implementation ====================
+
+QVector<ExcelSearchIndex::Trigram> ExcelSearchIndex::trigrams(const QStringList &fields)
+{
+  QVector<Trigram> grams;
+  for (const QString &field : fields) {
+    for (int i = 0; i + GRAM <= field.size(); ++i) {
+      grams.append(Trigram(field[i].toCaseFolded().unicode()) << 32
+                   | Trigram(field[i + 1].toCaseFolded().unicode()) << 16
+                   | Trigram(field[i + 2].toCaseFolded().unicode()));
+    }
+  }
+
+  std::sort(grams.begin(), grams.end());
+  grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+  return grams;
+}
+
+void ExcelSearchIndex::updateRow(int row, const QStringList &before, const QStringList &after)
+{
+  const QVector<Trigram> oldGrams = trigrams(before);
+  const QVector<Trigram> newGrams = trigrams(after);
+
+  QVector<Trigram> removed;
+  std::set_difference(oldGrams.begin(), oldGrams.end(), newGrams.begin(), newGrams.end(),
+                      std::back_inserter(removed));
+  for (Trigram gram : removed) {
+    auto it = m_postings.find(gram);
+    if (it == m_postings.end())
+      continue;
+    auto pos = std::lower_bound(it->begin(), it->end(), row);
+    if (pos != it->end() && *pos == row)
+      it->erase(pos);
+    if (it->isEmpty())
+      m_postings.erase(it);
+  }
+
+  QVector<Trigram> added;
+  std::set_difference(newGrams.begin(), newGrams.end(), oldGrams.begin(), oldGrams.end(),
+                      std::back_inserter(added));
+  for (Trigram gram : added) {
+    QVector<int> &rows = m_postings[gram];
+    // Rows mostly arrive in order, which makes this an append
+    if (rows.isEmpty() || rows.last() < row) {
+      rows.append(row);
+      continue;
+    }
+    auto pos = std::lower_bound(rows.begin(), rows.end(), row);
+    if (*pos != row)
+      rows.insert(pos, row);
+  }
+}
+
+QVector<int> ExcelSearchIndex::candidates(const QString &query) const
+{
+  QVector<const QVector<int> *> lists;
+  for (Trigram gram : trigrams({query})) {
+    auto it = m_postings.constFind(gram);
+    if (it == m_postings.constEnd())
+      return QVector<int>();
+    lists.append(&it.value());
+  }
+  if (lists.isEmpty())
+    return QVector<int>();
+
+  // Intersect from the rarest trigram up so the working set only shrinks
+  std::sort(lists.begin(), lists.end(), [](const QVector<int> *a, const QVector<int> *b) {
+    return a->size() < b->size();
+  });
+
+  QVector<int> rows = *lists.first();
+  for (int i = 1; i < lists.size() && !rows.isEmpty(); ++i) {
+    QVector<int> next;
+    std::set_intersection(rows.begin(), rows.end(), lists[i]->begin(), lists[i]->end(),
+                          std::back_inserter(next));
+    rows.swap(next);
+  }
+  return rows;
+}
+
+// ==================== ExcelJournal Implementation ====================
+
+namespace {
+// Push the file's written data to the disk, not just to the OS cache
+bool syncToDisk(QFile &file)
+{
+  if (!file.flush())
+    return false;
+#ifdef Q_OS_WIN
+  return _commit(file.handle()) == 0;
+#else
+  return ::fsync(file.handle()) == 0;
+#endif
+}
+
+QJsonValue journalValue(const QVariant &value)
+{
+  return value.isValid() ? QJsonValue::fromVariant(value) : QJsonValue();
+}
+
+QVariant journalVariant(const QJsonValue &value)
+{
+  return value.isNull() || value.isUndefined() ? QVariant() : value.toVariant();
+}
+
+QByteArray journalLine(const QJsonObject &record)
+{
+  return QJsonDocument(record).toJson(QJsonDocument::Compact) + '\n';
+}
+
+// Same test as SheetRowCollector: the loader drops rows like these
+bool isEmptyRow(const ExcelSheetStore &store, int row)
+{
+  for (int col = 0; col < store.columnCount(); ++col) {
+    if (!store.value(row, col).toString().trimmed().isEmpty())
+      return false;
+  }
+  return true;
+}
+
+QString nameChecksum(const ExcelSheetStore &store)
+{
+  QCryptographicHash hash(QCryptographicHash::Md5);
+  for (int row = 0; row < store.rowCount(); ++row) {
+    if (isEmptyRow(store, row))
+      continue;
+    QByteArray name = store.text(row, 0).toUtf8();
+    name += '\n';
+    hash.addData(name);
+  }
+  return QString::fromLatin1(hash.result().toHex());
+}
+}
+
+bool ExcelJournal::open(const QString &workbookPath, const QJsonObject &base)
+{
+  close();
+
+  QString path = journalPath(workbookPath);
+  QString tempPath = path + ".tmp";
+
+  // A crash during discardThrough() can leave only the rewritten copy behind
+  if (!QFile::exists(path) && QFile::exists(tempPath))
+    QFile::rename(tempPath, path);
+
+  m_file.setFileName(path);
+  if (!m_file.open(QIODevice::ReadWrite | QIODevice::Append)) {
+    qDebug() << "⚠ Could not open journal:" << path;
+    return false;
+  }
+
+  m_workbookPath = workbookPath;
+  if (m_file.size() == 0 && !append(base)) {
+    close();
+    return false;
+  }
+
+  // Records start after the header line
+  m_file.seek(0);
+  m_baseSize = m_file.readLine().size();
+  return true;
+}
+
+void ExcelJournal::close()
+{
+  if (m_file.isOpen())
+    m_file.close();
+  m_workbookPath.clear();
+  m_baseSize = 0;
+}
+
+bool ExcelJournal::append(const QJsonObject &record)
+{
+  if (!m_file.isOpen())
+    return false;
+
+  QByteArray line = journalLine(record);
+  if (m_file.write(line) != line.size() || !syncToDisk(m_file)) {
+    qDebug() << "⚠ Journal write failed:" << m_file.errorString();
+    return false;
+  }
+  return true;
+}
+
+bool ExcelJournal::discardThrough(qint64 offset, const QJsonObject &base)
+{
+  if (!m_file.isOpen() || offset <= 0)
+    return true;
+
+  // Keep the records written after the workbook snapshot was taken, behind
+  // the snapshot's header. They go through a temp copy so a crash never
+  // leaves a half-written journal
+  m_file.seek(offset);
+  QByteArray tail = journalLine(base) + m_file.readAll();
+
+  QString path = m_file.fileName();
+  QFile temp(path + ".tmp");
+  if (!temp.open(QIODevice::WriteOnly | QIODevice::Truncate)
+      || temp.write(tail) != tail.size() || !syncToDisk(temp)) {
+    return false;
+  }
+  temp.close();
+
+  QString workbookPath = m_workbookPath;
+  close();
+  QFile::remove(path);
+  QFile::rename(temp.fileName(), path);
+  return open(workbookPath, base);
+}
+
+bool ExcelJournal::replay(const QString &workbookPath, ExcelTableModel *model, int *applied)
+{
+  *applied = 0;
+
+  QFile file(journalPath(workbookPath));
+  if (!file.open(QIODevice::ReadOnly))
+    return true;
+
+  // A torn header means the process died creating the journal
+  QJsonParseError error;
+  QJsonDocument header = QJsonDocument::fromJson(file.readLine().trimmed(), &error);
+  if (error.error != QJsonParseError::NoError && file.atEnd())
+    return true;
+
+  if (!rebase(header.object(), model)) {
+    qDebug() << "⚠ Journal was written for another state of the workbook";
+    return false;
+  }
+
+  bool ok = true;
+  model->beginBatch();
+  while (!file.atEnd()) {
+    QByteArray line = file.readLine().trimmed();
+    if (line.isEmpty())
+      continue;
+
+    // A torn last line means the process died mid-append; stop there
+    QJsonDocument doc = QJsonDocument::fromJson(line, &error);
+    if (error.error != QJsonParseError::NoError || !doc.isObject()) {
+      qDebug() << "⚠ Journal truncated after" << *applied << "records";
+      break;
+    }
+
+    if (!apply(doc.object(), model)) {
+      qDebug() << "⚠ Journal does not match the workbook - stopped after" << *applied << "records";
+      ok = false;
+      break;
+    }
+    ++*applied;
+  }
+  model->commitBatch();
+
+  return ok;
+}
+
+bool ExcelJournal::rebase(const QJsonObject &base, ExcelTableModel *model)
+{
+  const ExcelSheetStore &store = model->store();
+  QJsonArray emptyRows = base.value("empty").toArray();
+  int rows = base.value("rows").toInt();
+  int cols = base.value("cols").toInt();
+
+  if (base.value("op").toString() != "base" || rows != store.rowCount() + emptyRows.size()
+      || cols < store.columnCount() || base.value("sum").toString() != nameChecksum(store)) {
+    return false;
+  }
+
+  if (emptyRows.isEmpty() && cols == store.columnCount())
+    return true;
+
+  // Put back the empty rows (and header columns) the loader dropped, so the
+  // records' row indices point where they did when they were written
+  ExcelSheetStore rebuilt;
+  rebuilt.reset(cols);
+  rebuilt.reserve(rows);
+  int next = 0;
+  int nextEmpty = 0;
+  for (int row = 0; row < rows; ++row) {
+    if (nextEmpty < emptyRows.size() && emptyRows[nextEmpty].toInt() == row) {
+      rebuilt.appendEmptyRow();
+      ++nextEmpty;
+      continue;
+    }
+    if (next == store.rowCount())
+      return false;
+
+    QVector<QVariant> values;
+    values.reserve(store.columnCount());
+    for (int col = 0; col < store.columnCount(); ++col)
+      values.append(store.value(next, col));
+    rebuilt.appendRow(values);
+    ++next;
+  }
+
+  if (nextEmpty != emptyRows.size())
+    return false;
+
+  model->setStore(rebuilt);
+  return true;
+}
+
+bool ExcelJournal::apply(const QJsonObject &record, ExcelTableModel *model)
+{
+  QString op = record.value("op").toString();
+
+  // setDataAt() fails on rows and columns out of range
+  if (op == "set") {
+    return model->setDataAt(record.value("r").toInt(-1), record.value("c").toInt(-1),
+                            journalVariant(record.value("v")));
+  }
+
+  if (op == "rows") {
+    // Rows are always appended, so they must land where they were recorded
+    if (record.value("r").toInt() != model->store().rowCount())
+      return false;
+
+    QVector<QVector<QVariant>> rows;
+    for (const QJsonValue &rowValue : record.value("v").toArray()) {
+      QVector<QVariant> values;
+      for (const QJsonValue &value : rowValue.toArray())
+        values.append(journalVariant(value));
+      rows.append(values);
+    }
+    model->appendRows(rows);
+    return true;
+  }
+
+  if (op == "col") {
+    model->addColumn();
+    return true;
+  }
+
+  if (op == "batch") {
+    for (const QJsonValue &entry : record.value("ops").toArray()) {
+      if (!apply(entry.toObject(), model))
+        return false;
+    }
+    return true;
+  }
+
+  return false;
+}
+
+QJsonObject ExcelJournal::base(const ExcelSheetStore &store)
+{
+  QJsonArray emptyRows;
+  for (int row = 0; row < store.rowCount(); ++row) {
+    if (isEmptyRow(store, row))
+      emptyRows.append(row);
+  }
+
+  return QJsonObject{{"op", "base"}, {"rows", store.rowCount()}, {"cols", store.columnCount()},
+                     {"empty", emptyRows}, {"sum", nameChecksum(store)}};
+}
+
+QJsonObject ExcelJournal::setCell(int row, int column, const QVariant &value)
+{
+  return QJsonObject{{"op", "set"}, {"r", row}, {"c", column}, {"v", journalValue(value)}};
+}
+
+QJsonObject ExcelJournal::appendRows(int firstRow, const QVector<QVector<QVariant>> &rows)
+{
+  QJsonArray rowValues;
+  for (const QVector<QVariant> &row : rows) {
+    QJsonArray values;
+    for (const QVariant &value : row)
+      values.append(journalValue(value));
+    rowValues.append(values);
+  }
+  return QJsonObject{{"op", "rows"}, {"r", firstRow}, {"v", rowValues}};
+}
+
+QJsonObject ExcelJournal::appendColumn()
+{
+  return QJsonObject{{"op", "col"}};
+}
+
+QJsonObject ExcelJournal::batch(const QJsonArray &records)
+{
+  return QJsonObject{{"op", "batch"}, {"ops", records}};
+}
+
 // ==================== ExcelTableModel Implementation ====================
 
 ExcelTableModel::ExcelTableModel(QObject *parent)
@@ -11,38 +608,48 @@ int ExcelTableModel::rowCount(const QModelIndex &parent) const
 {
   if (parent.isValid())
     return 0;
-  return m_data.size();
+  // Rows appended inside a batch stay hidden until commitBatch() inserts them
+  return m_batchDepth > 0 ? m_batchRows : m_store.rowCount();
 }
 
 int ExcelTableModel::columnCount(const QModelIndex &parent) const
 {
-  if (parent.isValid() || m_data.isEmpty())
+  if (parent.isValid() || m_store.isEmpty())
     return 0;
-  return m_data.first().size();
+  return m_store.columnCount();
+}
+
+int ExcelTableModel::roleColumn(const QModelIndex &index, int role)
+{
+  if (role == Qt::DisplayRole || role == Qt::EditRole)
+    return index.column();
+  if (role >= PartNameRole && role <= VendorRole)
+    return role - PartNameRole;
+  return -1;
 }
 
 QVariant ExcelTableModel::data(const QModelIndex &index, int role) const
 {
-  if (!index.isValid() || role != Qt::DisplayRole)
+  if (!index.isValid())
     return QVariant();
 
-  if (index.row() >= m_data.size() || index.column() >= m_data[index.row()].size())
+  int column = roleColumn(index, role);
+  if (column < 0 || index.row() >= m_store.rowCount() || column >= m_store.columnCount())
     return QVariant();
 
-  return m_data[index.row()][index.column()];
+  return m_store.value(index.row(), column);
 }
 
 bool ExcelTableModel::setData(const QModelIndex &index, const QVariant &value, int role)
 {
-  if (!index.isValid() || role != Qt::EditRole)
+  if (!index.isValid())
     return false;
 
-  if (index.row() >= m_data.size() || index.column() >= m_data[index.row()].size())
+  int column = roleColumn(index, role);
+  if (column < 0)
     return false;
 
-  m_data[index.row()][index.column()] = value;
-  emit dataChanged(index, index, {role});
-  return true;
+  return setDataAt(index.row(), column, value);
 }
 
 Qt::ItemFlags ExcelTableModel::flags(const QModelIndex &index) const
@@ -56,70 +663,375 @@ QHash<int, QByteArray> ExcelTableModel::roleNames() const
 {
   QHash<int, QByteArray> roles;
   roles[Qt::DisplayRole] = "display";
+  roles[Qt::EditRole] = "edit";
+  roles[PartNameRole] = "partName";
+  roles[PartNoRole] = "partNo";
+  roles[StockRole] = "stock";
+  roles[DepartmentRole] = "department";
+  roles[PreparedRole] = "prepared";
+  roles[ApprovedRole] = "approved";
+  roles[VendorRole] = "vendor";
   return roles;
 }
 
+QVariant ExcelTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+  // Row numbers for the grid's vertical header; the sheet header is row 0
+  if (orientation == Qt::Vertical && role == Qt::DisplayRole)
+    return section + 1;
+  return QAbstractTableModel::headerData(section, orientation, role);
+}
+
 void ExcelTableModel::setExcelData(const QVector<QVector<QVariant>> &data)
 {
-  beginResetModel();
-  m_data = data;
-  endResetModel();
+  ExcelSheetStore store;
+  if (!data.isEmpty()) {
+    store.reset(data.first().size());
+    store.reserve(data.size());
+    for (const auto &row : data)
+      store.appendRow(row);
+  }
+  setStore(store);
 }
 
 QVector<QVector<QVariant>> ExcelTableModel::getExcelData() const
 {
-  return m_data;
+  return m_store.toRows();
+}
+
+void ExcelTableModel::setStore(const ExcelSheetStore &store)
+{
+  beginResetModel();
+  m_store = store;
+  rebuildNameIndex();
+  rebuildSearchIndex();
+  resetBatchState();
+  endResetModel();
 }
 
 QVariant ExcelTableModel::getData(int row, int column) const
 {
-  if (row < 0 || row >= m_data.size())
-    return QVariant();
-  if (column < 0 || column >= m_data[row].size())
-    return QVariant();
-  return m_data[row][column];
+  if (row < 0 || row >= m_store.rowCount())
+    return QVariant();
+  if (column < 0 || column >= m_store.columnCount())
+    return QVariant();
+  return m_store.value(row, column);
+}
+
+bool ExcelTableModel::setDataAt(int row, int column, const QVariant &value)
+{
+  if (row < 0 || row >= m_store.rowCount())
+    return false;
+  if (column < 0 || column >= m_store.columnCount())
+    return false;
+
+  if (column == 0 && row > 0) {
+    unindexName(row, m_store.value(row, 0));
+    indexName(row, value);
+  }
+
+  bool searched = row > 0 && (column == 0 || column == 1 || column == 6);
+  QStringList oldFields = searched ? searchFields(row) : QStringList();
+
+  m_store.setValue(row, column, value);
+  if (searched)
+    m_searchIndex.updateRow(row, oldFields, searchFields(row));
+  if (m_journal)
+    journal(ExcelJournal::setCell(row, column, value));
+
+  if (m_batchDepth > 0) {
+    markDirty(row, column);
+  } else {
+    emitCellsChanged(row, column, row, column);
+  }
+  return true;
+}
+
+int ExcelTableModel::addRow()
+{
+  int row = m_store.rowCount();
+  if (m_batchDepth == 0)
+    beginInsertRows(QModelIndex(), row, row);
+  if (m_store.isEmpty())
+    m_store.reset(7);
+  m_store.appendEmptyRow();
+  if (m_journal)
+    journal(ExcelJournal::appendRows(row, {QVector<QVariant>()}));
+  if (m_batchDepth == 0)
+    endInsertRows();
+  return row;
+}
+
+int ExcelTableModel::appendRows(const QVector<QVector<QVariant>> &rows)
+{
+  int first = m_store.rowCount();
+  if (rows.isEmpty())
+    return first;
+
+  if (m_batchDepth == 0)
+    beginInsertRows(QModelIndex(), first, first + int(rows.size()) - 1);
+
+  if (m_store.isEmpty())
+    m_store.reset(7);
+  m_store.reserve(first + int(rows.size()));
+
+  for (const QVector<QVariant> &values : rows) {
+    int row = m_store.rowCount();
+    m_store.appendRow(values);
+    if (row > 0) {
+      indexName(row, m_store.value(row, 0));
+      m_searchIndex.updateRow(row, QStringList(), searchFields(row));
+    }
+  }
+  if (m_journal)
+    journal(ExcelJournal::appendRows(first, rows));
+
+  if (m_batchDepth == 0)
+    endInsertRows();
+  return first;
+}
+
+void ExcelTableModel::addColumn()
+{
+  if (m_store.isEmpty())
+    return;
+
+  int cols = m_store.columnCount();
+  beginInsertColumns(QModelIndex(), cols, cols);
+  m_store.appendColumn();
+  if (m_journal)
+    journal(ExcelJournal::appendColumn());
+  endInsertColumns();
+}
+
+void ExcelTableModel::clear()
+{
+  beginResetModel();
+  m_store.clear();
+  m_nameIndex.clear();
+  m_searchIndex.clear();
+  resetBatchState();
+  endResetModel();
+}
+
+void ExcelTableModel::beginBatch()
+{
+  if (m_batchDepth++ == 0)
+    resetBatchState();
+}
+
+void ExcelTableModel::commitBatch()
+{
+  if (m_batchDepth == 0 || --m_batchDepth > 0)
+    return;
+
+  if (m_journal && !m_journalBatch.isEmpty())
+    m_journal->append(ExcelJournal::batch(m_journalBatch));
+
+  int rows = m_store.rowCount();
+  if (rows > m_batchRows) {
+    beginInsertRows(QModelIndex(), m_batchRows, rows - 1);
+    m_batchRows = rows;
+    endInsertRows();
+  }
+
+  if (m_dirtyTop <= m_dirtyBottom)
+    emitCellsChanged(m_dirtyTop, m_dirtyLeft, m_dirtyBottom, m_dirtyRight);
+
+  resetBatchState();
+}
+
+void ExcelTableModel::emitCellsChanged(int top, int left, int bottom, int right)
+{
+  // A column role (model.partName, ...) is readable from every cell of the
+  // row, so edits in those columns refresh whole rows with all roles
+  if (left <= VendorRole - PartNameRole)
+    emit dataChanged(index(top, 0), index(bottom, m_store.columnCount() - 1));
+  else
+    emit dataChanged(index(top, left), index(bottom, right), {Qt::DisplayRole, Qt::EditRole});
+}
+
+void ExcelTableModel::markDirty(int row, int column)
+{
+  // New rows are covered by the insert at commit time
+  if (row >= m_batchRows)
+    return;
+
+  if (m_dirtyTop > m_dirtyBottom) {
+    m_dirtyTop = m_dirtyBottom = row;
+    m_dirtyLeft = m_dirtyRight = column;
+    return;
+  }
+
+  m_dirtyTop = qMin(m_dirtyTop, row);
+  m_dirtyBottom = qMax(m_dirtyBottom, row);
+  m_dirtyLeft = qMin(m_dirtyLeft, column);
+  m_dirtyRight = qMax(m_dirtyRight, column);
+}
+
+void ExcelTableModel::journal(const QJsonObject &record)
+{
+  if (m_batchDepth > 0)
+    m_journalBatch.append(record);
+  else
+    m_journal->append(record);
+}
+
+void ExcelTableModel::resetBatchState()
+{
+  m_journalBatch = QJsonArray();
+  m_batchRows = m_store.rowCount();
+  m_dirtyTop = 0;
+  m_dirtyBottom = -1;
+  m_dirtyLeft = 0;
+  m_dirtyRight = -1;
+}
+
+QString ExcelTableModel::normalizeName(const QVariant &name)
+{
+  return name.toString().trimmed().toLower();
+}
+
+int ExcelTableModel::findRowByName(const QString &partName) const
+{
+  QString key = normalizeName(partName);
+  if (key.isEmpty())
+    return -1;
+
+  // Several rows may share a name; the first one wins, as with a top-down scan
+  int found = -1;
+  auto range = m_nameIndex.equal_range(key);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (found == -1 || it.value() < found)
+      found = it.value();
+  }
+  return found;
+}
+
+void ExcelTableModel::indexName(int row, const QVariant &name)
+{
+  QString key = normalizeName(name);
+  if (!key.isEmpty())
+    m_nameIndex.insert(key, row);
+}
+
+void ExcelTableModel::unindexName(int row, const QVariant &name)
+{
+  QString key = normalizeName(name);
+  if (!key.isEmpty())
+    m_nameIndex.remove(key, row);
+}
+
+void ExcelTableModel::rebuildNameIndex()
+{
+  m_nameIndex.clear();
+  if (m_store.columnCount() == 0)
+    return;
+
+  m_nameIndex.reserve(m_store.rowCount());
+  for (int row = 1; row < m_store.rowCount(); ++row) {  // Skip header
+    indexName(row, m_store.text(row, 0));
+  }
+}
+
+QStringList ExcelTableModel::searchFields(int row) const
+{
+  QStringList fields;
+  for (int column : {0, 1, 6}) {  // Part Name, Part No, Vendor
+    if (column < m_store.columnCount())
+      fields.append(m_store.text(row, column));
+  }
+  return fields;
+}
+
+void ExcelTableModel::rebuildSearchIndex()
+{
+  m_searchIndex.clear();
+  for (int row = 1; row < m_store.rowCount(); ++row) {  // Skip header
+    m_searchIndex.updateRow(row, QStringList(), searchFields(row));
+  }
 }
 
-bool ExcelTableModel::setDataAt(int row, int column, const QVariant &value)
+QVector<int> ExcelTableModel::searchRows(const QString &text, int limit) const
 {
-  if (row < 0 || row >= m_data.size())
-    return false;
-  if (column < 0 || column >= m_data[row].size())
-    return false;
+  QString query = text.trimmed();
+  int cols = m_store.columnCount();
+
+  auto contains = [&](int row, int col) {
+    return col < cols && m_store.text(row, col).contains(query, Qt::CaseInsensitive);
+  };
+
+  // Lower is better; -1 means the row does not match at all
+  auto rank = [&](int row) {
+    if (cols > 0) {
+      QString name = m_store.text(row, 0);
+      if (name.compare(query, Qt::CaseInsensitive) == 0)
+        return 0;
+      if (name.startsWith(query, Qt::CaseInsensitive))
+        return 1;
+      if (name.contains(query, Qt::CaseInsensitive))
+        return 2;
+    }
+    if (contains(row, 1))
+      return 3;
+    if (contains(row, 6))
+      return 4;
+    return -1;
+  };
+
+  QVector<QPair<int, int>> hits;  // (rank, row)
+  auto consider = [&](int row) {
+    int r = rank(row);
+    if (r >= 0)
+      hits.append(qMakePair(r, row));
+  };
+
+  // Trigrams narrow long queries down to a few candidates; shorter ones
+  // have no trigram to look up and fall back to a scan
+  if (query.size() >= ExcelSearchIndex::GRAM) {
+    for (int row : m_searchIndex.candidates(query))
+      consider(row);
+  } else {
+    for (int row = 1; row < m_store.rowCount(); ++row)
+      consider(row);
+  }
 
-  m_data[row][column] = value;
-  QModelIndex idx = index(row, column);
-  emit dataChanged(idx, idx, {Qt::DisplayRole});
-  return true;
+  if (limit > 0 && hits.size() > limit) {
+    std::partial_sort(hits.begin(), hits.begin() + limit, hits.end());
+    hits.resize(limit);
+  } else {
+    std::sort(hits.begin(), hits.end());
+  }
+
+  QVector<int> rows;
+  rows.reserve(hits.size());
+  for (const auto &hit : hits)
+    rows.append(hit.second);
+  return rows;
 }
 
-void ExcelTableModel::addRow()
+// ==================== ExcelTask Implementation ====================
+
+void ExcelTask::reportRows(int rows)
 {
-  int cols = m_data.isEmpty() ? 7 : m_data.first().size();
-  beginInsertRows(QModelIndex(), m_data.size(), m_data.size());
-  QVector<QVariant> newRow(cols);
-  m_data.append(newRow);
-  endInsertRows();
+  m_rows = rows;
+  if (m_rows - m_reportedRows >= ROW_STEP)
+    flush();
 }
 
-void ExcelTableModel::addColumn()
+void ExcelTask::reportBytes(qint64 bytes)
 {
-  if (m_data.isEmpty())
-    return;
-
-  int cols = m_data.first().size();
-  beginInsertColumns(QModelIndex(), cols, cols);
-  for (auto &row : m_data) {
-    row.append(QVariant());
-  }
-  endInsertColumns();
+  m_bytes = bytes;
+  if (m_bytes - m_reportedBytes >= BYTE_STEP)
+    flush();
 }
 
-void ExcelTableModel::clear()
+void ExcelTask::flush()
 {
-  beginResetModel();
-  m_data.clear();
-  endResetModel();
+  m_reportedRows = m_rows;
+  m_reportedBytes = m_bytes;
+  if (m_progress)
+    m_progress(m_rows, m_bytes);
 }
 
 // ==================== ExcelHandler Implementation ====================
@@ -128,6 +1040,7 @@ ExcelHandler::ExcelHandler(QObject *parent)
   : QObject(parent),
   m_model(new ExcelTableModel(this)),
   m_hasUnsavedChanges(false),
+  m_streamingLoad(true),
   m_syncEnabled(false),
   m_syncStatus("offline"),
   m_currentUser("User"),
@@ -135,6 +1048,26 @@ ExcelHandler::ExcelHandler(QObject *parent)
 {
   connect(m_model, &QAbstractItemModel::dataChanged,
           this, &ExcelHandler::onModelDataChanged);
+  connect(m_model, &QAbstractItemModel::rowsInserted,
+          this, &ExcelHandler::onModelDataChanged);
+
+  // File jobs are serialized; the pool only keeps them off the UI thread
+  m_workerPool.setMaxThreadCount(1);
+
+  // Journaled edits are folded into the workbook a while after the first
+  // one, and whatever is left when the app quits
+  m_compactTimer.setSingleShot(true);
+  m_compactTimer.setInterval(30000);
+  connect(&m_compactTimer, &QTimer::timeout, this, [this]() {
+    if (busy())
+      m_compactTimer.start();
+    else if (m_journal.isOpen() && !m_journal.isEmpty())
+      startSave(m_journal.workbookPath(), "save", nullptr, true);
+  });
+  if (QCoreApplication::instance()) {
+    connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit,
+            this, &ExcelHandler::compactJournal);
+  }
 
   initializeUploadsDirectory();
   loadPermanentFileSettings();
@@ -144,6 +1077,13 @@ ExcelHandler::ExcelHandler(QObject *parent)
   qDebug() << "Current user:" << m_currentUser << "(" << m_userRole << ")";
 }
 
+ExcelHandler::~ExcelHandler()
+{
+  if (m_task)
+    m_task->cancel();
+  m_workerPool.waitForDone();
+}
+
 void ExcelHandler::initializeUploadsDirectory()
 {
   QString appData = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
@@ -201,6 +1141,10 @@ bool ExcelHandler::hasSavedPermanentFile()
 
 bool ExcelHandler::setPermanentFile(const QString &filePath)
 {
+  // A background save could still land in the previous permanent file
+  if (!checkIdle())
+    return false;
+
   QString cleanPath = cleanFilePath(filePath);
 
   qDebug() << "========================================";
@@ -228,6 +1172,10 @@ bool ExcelHandler::setPermanentFile(const QString &filePath)
 
   m_permanentFile = cleanPath;
   m_currentFile = cleanPath;
+  // The model still holds the previous sheet; journaling starts once the
+  // permanent file is loaded
+  m_model->setJournal(nullptr);
+  m_journal.close();
   savePermanentFileSettings();
   emit permanentFileChanged();
   emit currentFileChanged();
@@ -240,6 +1188,9 @@ bool ExcelHandler::setPermanentFile(const QString &filePath)
 
 bool ExcelHandler::loadPermanentFile()
 {
+  if (!checkIdle())
+    return false;
+
   if (m_permanentFile.isEmpty()) {
     QString error = "No permanent file set. Please use 'Set Permanent' button first.";
     qDebug() << "ERROR:" << error;
@@ -277,109 +1228,204 @@ bool ExcelHandler::saveToPermanent()
 
 int ExcelHandler::findPartByName(const QString &partName)
 {
-  int rows = m_model->rowCount();
-  QString searchName = partName.trimmed().toLower();
+  // O(1) lookup through the model's Part Name index (column 0, header skipped)
+  return m_model->findRowByName(partName);
+}
 
-  for (int row = 1; row < rows; ++row) {  // Skip header
-    QString existingName = m_model->getData(row, 0).toString().trimmed().toLower();  // Column 0 = Part Name
-    if (existingName == searchName) {
-      return row;
-    }
+bool ExcelHandler::appendFromFile(const QString &filePath)
+{
+  if (!checkIdle())
+    return false;
+
+  QString cleanPath = cleanFilePath(filePath);
+
+  qDebug() << "========================================";
+  qDebug() << "🔄 Smart merging from:" << cleanPath;
+
+  QVector<QVector<QVariant>> purchaseRows;
+  QString error;
+  if (!readPurchaseFile(cleanPath, purchaseRows, nullptr, &error)) {
+    qDebug() << "ERROR:" << error;
+    emit errorOccurred(error);
+    return false;
   }
 
-  return -1;
+  PurchaseMerge merge = planPurchaseMerge(purchaseRows);
+  applyPurchaseMerge(merge);
+
+  if (!isJournaled(m_permanentFile) && !m_permanentFile.isEmpty()) {
+    qDebug() << "💾 Auto-saving to permanent file...";
+    saveToPermanent();
+  }
+
+  emit fileMerged(QFileInfo(cleanPath).fileName(), merge.rowsAdded(), merge.rowsUpdated());
+  return true;
 }
 
-bool ExcelHandler::updateExistingPart(int row, const QVector<QVariant> &mergeData)
+bool ExcelHandler::appendFromFileAsync(const QString &filePath)
 {
-  qDebug() << "  📝 Updating existing part at row:" << row;
+  QString cleanPath = cleanFilePath(filePath);
 
-  // COLUMN MAPPING (7 columns):
-  // Stock file: 0=Part Name, 1=Part No, 2=Stock, 3=Department, 4=Prepared, 5=Approved, 6=Vendor
-  // Purchase file: 0=Part Name, 1=Part No, 2=Purchase, 3=Department, 4=Prepared, 5=Approved, 6=Vendor
+  std::shared_ptr<ExcelTask> task = beginOperation("merge");
+  if (!task)
+    return false;
+
+  qDebug() << "========================================";
+  qDebug() << "🔄 Smart merging in background from:" << cleanPath;
+
+  m_workerPool.start([this, task, cleanPath]() {
+    QVector<QVector<QVariant>> purchaseRows;
+    QString error;
+    bool ok = readPurchaseFile(cleanPath, purchaseRows, task.get(), &error);
+    task->flush();
+
+    QMetaObject::invokeMethod(this, [this, task, cleanPath, purchaseRows, ok, error]() {
+      if (!ok) {
+        if (!task->isCanceled()) {
+          qDebug() << "ERROR:" << error;
+          emit errorOccurred(error);
+        }
+        endOperation(false);
+        return;
+      }
 
-  // Get current stock (column 2 in stock file)
-  int currentStock = m_model->getData(row, 2).toInt();
+      PurchaseMerge merge = planPurchaseMerge(purchaseRows);
+      applyPurchaseMerge(merge);
+      endOperation(true);
 
-  // Get purchase from merge file (column 2 in purchase file)
-  int purchaseQty = mergeData.size() > 2 ? mergeData[2].toInt() : 0;
+      emit fileMerged(QFileInfo(cleanPath).fileName(), merge.rowsAdded(), merge.rowsUpdated());
 
-  // Calculate new stock = current stock + purchase
-  int newStock = currentStock + purchaseQty;
+      // The workbook rewrite goes to the worker too
+      if (!isJournaled(m_permanentFile) && !m_permanentFile.isEmpty()) {
+        qDebug() << "💾 Auto-saving to permanent file...";
+        saveExcelAsync(m_permanentFile);
+      }
+    }, Qt::QueuedConnection);
+  });
 
-  qDebug() << "    📊 Current Stock:" << currentStock;
-  qDebug() << "    ➕ Adding Purchase:" << purchaseQty;
-  qDebug() << "    ✅ New Stock:" << newStock;
+  return true;
+}
 
-  // Update stock (column 2)
-  m_model->setDataAt(row, 2, newStock);
+namespace {
+QString purchaseMismatchMessage()
+{
+  return "❌ File structure mismatch!\n\n"
+         "You are trying to merge a STOCK file.\n"
+         "Only PURCHASE files can be merged.\n\n"
+         "📋 Purchase file should have:\n"
+         "Part Name | Part No | Purchase | Department | Prepared | Approved | Vendor | File\n\n"
+         "💡 Use '🛒 Create Purchase' button to make a purchase file.";
+}
+}
 
-  // Update other fields if provided in merge file
-  if (mergeData.size() > 1 && !mergeData[1].toString().trimmed().isEmpty()) {
-    m_model->setDataAt(row, 1, mergeData[1]); // Part No
-  }
+bool ExcelHandler::readPurchaseFile(const QString &filePath, QVector<QVector<QVariant>> &rows,
+                                    ExcelTask *task, QString *error)
+{
+  // One streaming pass: the header is checked as soon as the first data row
+  // shows up, then the 7 purchase columns are collected
+  // Columns: Part Name | Part No | Purchase | Department | Prepared | Approved | Vendor
+  QString purchaseHeader;
+  bool headerChecked = false;
+  bool mismatch = false;
+  bool canceled = false;
+  int currentRow = -1;
+  QVector<QVariant> rowData;
+
+  auto checkHeader = [&]() {
+    headerChecked = true;
+    qDebug() << "Column 3 header:" << purchaseHeader;
+    mismatch = purchaseHeader.toLower() != "purchase";
+    return !mismatch;
+  };
+
+  QXlsx::sax_options options;
+  bool ok = QXlsx::read_xlsx_sheet_sax(filePath, 0, options, [&](const QXlsx::sax_cell &cell) {
+    if (cell.col < 1 || cell.col > 7)
+      return true;
 
-  if (mergeData.size() > 3 && !mergeData[3].toString().trimmed().isEmpty()) {
-    m_model->setDataAt(row, 3, mergeData[3]); // Department
-  }
+    if (cell.row != currentRow) {
+      if (task && task->isCanceled()) {
+        canceled = true;
+        return false;
+      }
+      if (currentRow >= 2)
+        rows.append(rowData);
+      if (cell.row >= 2 && !headerChecked && !checkHeader())
+        return false;
+
+      currentRow = cell.row;
+      rowData = QVector<QVariant>(7);
+      if (task)
+        task->reportRows(rows.size());
+    }
+
+    // Blank styled cells come through as empty text
+    QVariant value = cell.value;
+    if (value.userType() == QMetaType::QString && value.toString().isEmpty())
+      value = QVariant();
+
+    if (cell.row == 1) {
+      if (cell.col == 3)
+        purchaseHeader = value.toString().trimmed();
+    } else {
+      rowData[cell.col - 1] = value;
+    }
+    return true;
+  });
 
-  if (mergeData.size() > 4 && !mergeData[4].toString().trimmed().isEmpty()) {
-    m_model->setDataAt(row, 4, mergeData[4]); // Prepared
+  if (canceled) {
+    *error = "Merge canceled";
+    return false;
   }
 
-  if (mergeData.size() > 5 && !mergeData[5].toString().trimmed().isEmpty()) {
-    m_model->setDataAt(row, 5, mergeData[5]); // Approved
+  if (!ok) {
+    qDebug() << "⚠ Streaming read failed, falling back to full document load";
+    rows.clear();
+    return readPurchaseDocument(filePath, rows, task, error);
   }
 
-  if (mergeData.size() > 6 && !mergeData[6].toString().trimmed().isEmpty()) {
-    m_model->setDataAt(row, 6, mergeData[6]); // Vendor Name
+  if (currentRow >= 2 && !mismatch)
+    rows.append(rowData);
+
+  if (mismatch || (!headerChecked && !checkHeader())) {
+    *error = purchaseMismatchMessage();
+    return false;
   }
 
   return true;
 }
 
-bool ExcelHandler::appendFromFile(const QString &filePath)
+bool ExcelHandler::readPurchaseDocument(const QString &filePath, QVector<QVector<QVariant>> &rows,
+                                        ExcelTask *task, QString *error)
 {
-  QString cleanPath = cleanFilePath(filePath);
-
-  qDebug() << "========================================";
-  qDebug() << "🔄 Smart merging from:" << cleanPath;
-
-  if (!validateFileStructure(cleanPath)) {
-    QString error = "❌ File structure mismatch!\n\n"
-                    "You are trying to merge a STOCK file.\n"
-                    "Only PURCHASE files can be merged.\n\n"
-                    "📋 Purchase file should have:\n"
-                    "Part Name | Part No | Purchase | Department | Prepared | Approved | Vendor | File\n\n"
-                    "💡 Use '🛒 Create Purchase' button to make a purchase file.";
-    qDebug() << "ERROR:" << error;
-    emit errorOccurred(error);
-    return false;
-  }
-
-  QXlsx::Document xlsx(cleanPath);
+  QXlsx::Document xlsx(filePath);
   if (!xlsx.load()) {
-    emit errorOccurred("Failed to load file");
+    *error = "Failed to load file";
     return false;
   }
 
   QXlsx::Worksheet *sheet = xlsx.currentWorksheet();
   if (!sheet) {
-    emit errorOccurred("No worksheet found");
+    *error = "No worksheet found";
     return false;
   }
 
-  QXlsx::CellRange range = sheet->dimension();
-
-  int rowsAdded = 0;
-  int rowsUpdated = 0;
-  QSet<QString> processedParts;
+  // Column 3 should be "Purchase" for merge files
+  auto col3Cell = sheet->cellAt(1, 3);
+  if (!col3Cell || col3Cell->value().toString().trimmed().toLower() != "purchase") {
+    *error = purchaseMismatchMessage();
+    return false;
+  }
 
-  qDebug() << "";
-  qDebug() << "🔍 Processing purchase file rows...";
+  QXlsx::CellRange range = sheet->dimension();
 
-  // Process merge file rows (skip header)
+  // Read merge file rows (skip header)
   for (int row = 2; row <= range.lastRow(); ++row) {
+    if (task && task->isCanceled()) {
+      *error = "Merge canceled";
+      return false;
+    }
+
     QVector<QVariant> rowData;
 
     // Read 7 columns from purchase file (removed File Upload)
@@ -389,84 +1435,91 @@ bool ExcelHandler::appendFromFile(const QString &filePath)
       rowData.append(cell ? cell->value() : QVariant());
     }
 
-    // Column 0 = Part Name (1st column in Excel)
-    QString partName = rowData.size() > 0 ? rowData[0].toString().trimmed() : "";
+    rows.append(rowData);
+    if (task)
+      task->reportRows(rows.size());
+  }
 
-    if (partName.isEmpty()) {
-      qDebug() << "  ⏭️ Row" << row << ": Skipping (empty part name)";
-      continue;
-    }
+  return true;
+}
 
-    qDebug() << "";
-    qDebug() << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━";
-    qDebug() << "📦 Row" << row << ":" << partName;
+ExcelHandler::PurchaseMerge ExcelHandler::planPurchaseMerge(const QVector<QVector<QVariant>> &rows) const
+{
+  // COLUMN MAPPING (7 columns):
+  // Stock file: 0=Part Name, 1=Part No, 2=Stock, 3=Department, 4=Prepared, 5=Approved, 6=Vendor
+  // Purchase file: 0=Part Name, 1=Part No, 2=Purchase, 3=Department, 4=Prepared, 5=Approved, 6=Vendor
+  PurchaseMerge merge;
+  const ExcelSheetStore &store = m_model->store();
+  int cols = store.columnCount();
+  QSet<QString> processedParts;
+  processedParts.reserve(rows.size());
+
+  auto field = [](const QVector<QVariant> &row, int col) {
+    return col < row.size() ? row[col] : QVariant();
+  };
+  auto provided = [&](const QVector<QVariant> &row, int col) {
+    return !field(row, col).toString().trimmed().isEmpty();
+  };
+
+  for (const QVector<QVariant> &rowData : rows) {
+    QString partName = field(rowData, 0).toString().trimmed();
+    if (partName.isEmpty())
+      continue;
 
-    // Skip duplicates within same merge file
-    QString partNameLower = partName.toLower();
-    if (processedParts.contains(partNameLower)) {
-      qDebug() << "  ⚠️  Duplicate in purchase file - SKIPPED";
+    // Only the first line for a part counts; later duplicates are skipped
+    QString key = ExcelTableModel::normalizeName(partName);
+    if (processedParts.contains(key)) {
+      ++merge.duplicatesSkipped;
       continue;
     }
+    processedParts.insert(key);
 
-    processedParts.insert(partNameLower);
-
-    // Show purchase data
-    qDebug() << "  📄 Purchase Data:";
-    qDebug() << "    Part Name:" << (rowData.size() > 0 ? rowData[0].toString() : "");
-    qDebug() << "    Part No:" << (rowData.size() > 1 ? rowData[1].toString() : "");
-    qDebug() << "    Purchase Qty:" << (rowData.size() > 2 ? rowData[2].toInt() : 0);
-    qDebug() << "    Department:" << (rowData.size() > 3 ? rowData[3].toString() : "");
-    qDebug() << "    Vendor:" << (rowData.size() > 6 ? rowData[6].toString() : "");
-
-    // Check if part already exists in permanent stock file
-    int existingRow = findPartByName(partName);
+    int purchaseQty = field(rowData, 2).toInt();
+    int existingRow = m_model->findRowByName(partName);
 
     if (existingRow != -1) {
-      // 📝 UPDATE EXISTING PART
-      qDebug() << "  ✓ Part EXISTS in stock (Row" << existingRow << ")";
-      updateExistingPart(existingRow, rowData);
-      rowsUpdated++;
-      qDebug() << "  ✅ Updated successfully";
+      // Existing part: Stock += Purchase, other fields overwritten when given
+      PurchaseMerge::Update update;
+      update.row = existingRow;
+      update.values.resize(cols);
+      if (cols > 2)
+        update.values[2] = store.intValue(existingRow, 2) + purchaseQty;
+      for (int col : {1, 3, 4, 5, 6}) {
+        if (col < cols && provided(rowData, col))
+          update.values[col] = rowData[col];
+      }
+      merge.updates.append(update);
     } else {
-      // ➕ ADD NEW PART
-      qDebug() << "  ✓ Part is NEW (not in stock)";
-      m_model->addRow();
-      int newRow = m_model->rowCount() - 1;
-
-      int purchaseQty = rowData.size() > 2 ? rowData[2].toInt() : 0;
-
-      qDebug() << "  📝 Adding to row" << newRow << "with initial stock:" << purchaseQty;
-
-      // For NEW parts: Stock = Purchase quantity from merge file
-      // COLUMN MAPPING: 0=Part Name, 1=Part No, 2=Stock, 3=Department, 4=Prepared, 5=Approved, 6=Vendor (7 columns total)
-      m_model->setDataAt(newRow, 0, partName);                                       // Part Name
-      m_model->setDataAt(newRow, 1, rowData.size() > 1 ? rowData[1] : QVariant());  // Part No
-      m_model->setDataAt(newRow, 2, purchaseQty);                                    // Stock = Purchase
-      m_model->setDataAt(newRow, 3, rowData.size() > 3 ? rowData[3] : QVariant());  // Department
-      m_model->setDataAt(newRow, 4, rowData.size() > 4 ? rowData[4] : QVariant());  // Prepared
-      m_model->setDataAt(newRow, 5, rowData.size() > 5 ? rowData[5] : QVariant());  // Approved
-      m_model->setDataAt(newRow, 6, rowData.size() > 6 ? rowData[6] : QVariant());  // Vendor Name
-
-      rowsAdded++;
-      qDebug() << "  ✅ Added successfully";
+      // New part: Stock = Purchase quantity from merge file
+      merge.inserts.append(QVector<QVariant>{partName, field(rowData, 1), purchaseQty, field(rowData, 3),
+                                             field(rowData, 4), field(rowData, 5), field(rowData, 6)});
+    }
+  }
+
+  return merge;
+}
+
+void ExcelHandler::applyPurchaseMerge(const PurchaseMerge &merge)
+{
+  // One insert and one dataChanged for the whole merge, and one grouped
+  // journal record, which compaction later folds into the workbook
+  m_model->beginBatch();
+  for (const PurchaseMerge::Update &update : merge.updates) {
+    for (int col = 0; col < update.values.size(); ++col) {
+      if (update.values[col].isValid())
+        m_model->setDataAt(update.row, col, update.values[col]);
     }
   }
+  m_model->appendRows(merge.inserts);
+  m_model->commitBatch();
 
   qDebug() << "========================================";
   qDebug() << "✅ Merge complete:";
-  qDebug() << "  📝 Updated:" << rowsUpdated << "parts";
-  qDebug() << "  ➕ Added:" << rowsAdded << "new parts";
+  qDebug() << "  📝 Updated:" << merge.rowsUpdated() << "parts";
+  qDebug() << "  ➕ Added:" << merge.rowsAdded() << "new parts";
+  qDebug() << "  ⏭️ Duplicates skipped:" << merge.duplicatesSkipped;
   qDebug() << "  📊 Total rows:" << m_model->rowCount();
   qDebug() << "========================================";
-
-  if (!m_permanentFile.isEmpty()) {
-    qDebug() << "💾 Auto-saving to permanent file...";
-    saveToPermanent();
-  }
-
-  emit fileMerged(QFileInfo(cleanPath).fileName(), rowsAdded, rowsUpdated);
-
-  return true;
 }
 
 int ExcelHandler::searchPartName(const QString &partName)
@@ -483,26 +1536,18 @@ int ExcelHandler::searchPartName(const QString &partName)
   return row;
 }
 
-QVariantList ExcelHandler::searchAllMatches(const QString &searchText)
+QVariantList ExcelHandler::searchAllMatches(const QString &searchText, int maxResults)
 {
   QVariantList results;
-  int rows = m_model->rowCount();
-  QString search = searchText.trimmed().toLower();
 
-  for (int row = 1; row < rows; ++row) {
-    QString partName = m_model->getData(row, 0).toString().toLower();  // Column 0
-    QString partNo = m_model->getData(row, 1).toString().toLower();    // Column 1
-    QString vendor = m_model->getData(row, 6).toString().toLower();    // Column 6
-
-    if (partName.contains(search) || partNo.contains(search) || vendor.contains(search)) {
-      QVariantMap result;
-      result["row"] = row;
-      result["partName"] = m_model->getData(row, 0);  // Column 0
-      result["partNo"] = m_model->getData(row, 1);    // Column 1
-      result["stock"] = m_model->getData(row, 2);     // Column 2
-      result["vendor"] = m_model->getData(row, 6);    // Column 6
-      results.append(result);
-    }
+  for (int row : m_model->searchRows(searchText, maxResults)) {
+    QVariantMap result;
+    result["row"] = row;
+    result["partName"] = m_model->getData(row, 0);  // Column 0
+    result["partNo"] = m_model->getData(row, 1);    // Column 1
+    result["stock"] = m_model->getData(row, 2);     // Column 2
+    result["vendor"] = m_model->getData(row, 6);    // Column 6
+    results.append(result);
   }
 
   qDebug() << "Search '" << searchText << "' found" << results.size() << "results";
@@ -541,6 +1586,9 @@ bool ExcelHandler::hasUploadedFile(int row)
 
 void ExcelHandler::createNew(int rows, int cols)
 {
+  if (!checkIdle())
+    return;
+
   qDebug() << "Creating new spreadsheet:" << rows << "x" << cols;
 
   QVector<QVector<QVariant>> data;
@@ -558,6 +1606,7 @@ void ExcelHandler::createNew(int rows, int cols)
 
   m_model->setExcelData(data);
   m_currentFile = "";
+  updateJournal();
   setUnsavedChanges(false);
 
   emit currentFileChanged();
@@ -567,6 +1616,9 @@ void ExcelHandler::createNew(int rows, int cols)
 
 void ExcelHandler::createStockFile(int rows)
 {
+  if (!checkIdle())
+    return;
+
   qDebug() << "========================================";
   qDebug() << "📦 Creating new STOCK file (Excel format)";
   qDebug() << "========================================";
@@ -589,6 +1641,7 @@ void ExcelHandler::createStockFile(int rows)
 
   m_model->setExcelData(data);
   m_currentFile = "";
+  updateJournal();
   setUnsavedChanges(false);
 
   emit currentFileChanged();
@@ -599,6 +1652,9 @@ void ExcelHandler::createStockFile(int rows)
 
 void ExcelHandler::createPurchaseFile(int rows)
 {
+  if (!checkIdle())
+    return;
+
   qDebug() << "========================================";
   qDebug() << "🛒 Creating new PURCHASE file (Excel format)";
   qDebug() << "========================================";
@@ -621,6 +1677,7 @@ void ExcelHandler::createPurchaseFile(int rows)
 
   m_model->setExcelData(data);
   m_currentFile = "";
+  updateJournal();
   setUnsavedChanges(false);
 
   emit currentFileChanged();
@@ -638,62 +1695,308 @@ QString ExcelHandler::getFileName() const
   return QFileInfo(m_currentFile).fileName();
 }
 
-QString ExcelHandler::getFileType() const
-{
-  // Check column 2 (index 2) header to determine file type
-  QVariant header = m_model->getData(0, 2);
-  QString headerText = header.toString().trimmed().toLower();
+QString ExcelHandler::getFileType() const
+{
+  // Check column 2 (index 2) header to determine file type
+  QVariant header = m_model->getData(0, 2);
+  QString headerText = header.toString().trimmed().toLower();
+
+  if (headerText == "purchase") {
+    return "purchase";
+  } else {
+    return "stock";  // default to stock
+  }
+}
+
+bool ExcelHandler::loadExcel(const QString &filePath)
+{
+  if (!checkIdle())
+    return false;
+
+  QString cleanPath = cleanFilePath(filePath);
+
+  qDebug() << "========================================";
+  qDebug() << "Loading Excel file:" << cleanPath;
+
+  if (!checkExcelPath(cleanPath))
+    return false;
+
+  ExcelSheetStore store;
+  QString error;
+  if (!readSheet(cleanPath, m_streamingLoad, store, nullptr, &error)) {
+    emit errorOccurred(error);
+    return false;
+  }
+
+  applyLoadedSheet(cleanPath, store);
+  return true;
+}
+
+bool ExcelHandler::loadExcelAsync(const QString &filePath)
+{
+  QString cleanPath = cleanFilePath(filePath);
+
+  qDebug() << "========================================";
+  qDebug() << "Loading Excel file in background:" << cleanPath;
+
+  if (!checkExcelPath(cleanPath))
+    return false;
+
+  std::shared_ptr<ExcelTask> task = beginOperation("load");
+  if (!task)
+    return false;
+
+  bool streaming = m_streamingLoad;
+  m_workerPool.start([this, task, cleanPath, streaming]() {
+    ExcelSheetStore store;
+    QString error;
+    bool ok = readSheet(cleanPath, streaming, store, task.get(), &error);
+    task->flush();
+
+    QMetaObject::invokeMethod(this, [this, task, cleanPath, store, ok, error]() {
+      if (ok)
+        applyLoadedSheet(cleanPath, store);
+      else if (!task->isCanceled())
+        emit errorOccurred(error);
+      endOperation(ok);
+    }, Qt::QueuedConnection);
+  });
+
+  return true;
+}
+
+bool ExcelHandler::checkExcelPath(const QString &cleanPath)
+{
+  QFileInfo fileInfo(cleanPath);
+  if (!fileInfo.exists()) {
+    emit errorOccurred("File does not exist: " + cleanPath);
+    return false;
+  }
+
+  // ✅ CHECK IF IT'S AN EXCEL FILE
+  QString suffix = fileInfo.suffix().toLower();
+  if (suffix != "xlsx" && suffix != "xls") {
+    QString error = "❌ Invalid file type!\n\n"
+                    "Expected: Excel file (.xlsx or .xls)\n"
+                    "Got: ." + suffix + " file\n\n"
+                               "💡 Please select an Excel file (.xlsx)\n"
+                               "💡 Use '📦 Create Stock' or '🛒 Create Purchase' to make new files";
+    qDebug() << "ERROR:" << error;
+    emit errorOccurred(error);
+
+    // Clear the invalid permanent file
+    if (cleanPath == m_permanentFile) {
+      m_permanentFile = "";
+      savePermanentFileSettings();
+      emit permanentFileChanged();
+    }
+
+    return false;
+  }
+
+  return true;
+}
+
+void ExcelHandler::applyLoadedSheet(const QString &cleanPath, const ExcelSheetStore &store)
+{
+  m_model->setJournal(nullptr);
+  m_journal.close();
+
+  m_model->setStore(store);
+
+  // Edits journaled since the last save are not in the workbook yet
+  int replayed = 0;
+  if (cleanPath == m_permanentFile && !ExcelJournal::replay(cleanPath, m_model, &replayed)) {
+    // Keep the records aside; the new journal starts from this workbook
+    QString journalPath = ExcelJournal::journalPath(cleanPath);
+    QString rejectedPath = journalPath + ".rejected";
+    QFile::remove(rejectedPath);
+    QFile::rename(journalPath, rejectedPath);
+    emit errorOccurred("Unsaved edits from the last session do not match the workbook"
+                       + QString(replayed > 0 ? " and were only partly restored" : " and were not restored")
+                       + ".\n\nThey were kept in:\n" + rejectedPath);
+  }
+
+  m_currentFile = cleanPath;
+  setUnsavedChanges(replayed > 0);
+  updateJournal();
+
+  if (replayed > 0) {
+    qDebug() << "↻ Replayed" << replayed << "journaled edits";
+    m_compactTimer.start();
+  }
+
+  emit currentFileChanged();
+  emit fileLoaded(QFileInfo(cleanPath).fileName());
+
+  qDebug() << "✓ Loaded:" << store.rowCount() << "rows x" << store.columnCount() << "columns";
+  qDebug() << "File type:" << getFileType();
+  qDebug() << "========================================";
+}
+
+bool ExcelHandler::readSheet(const QString &filePath, bool streaming, ExcelSheetStore &store,
+                             ExcelTask *task, QString *error)
+{
+  bool loaded = false;
+
+  if (streaming) {
+    loaded = readSheetStreaming(filePath, store, task);
+    if (!loaded && task && task->isCanceled()) {
+      *error = "Load canceled";
+      return false;
+    }
+    if (!loaded) {
+      qDebug() << "⚠ Streaming read failed, falling back to full document load";
+    } else if (store.isEmpty()) {
+      // Let the document loader have a go before calling the file empty
+      qDebug() << "⚠ Streaming read found no rows, falling back to full document load";
+      loaded = false;
+    }
+  }
+
+  if (!loaded && !readSheetDocument(filePath, store, task, error))
+    return false;
+
+  if (store.isEmpty()) {
+    *error = "No data found in Excel file. The file may be empty or corrupted.";
+    return false;
+  }
+
+  return true;
+}
+
+namespace {
+// Applies loadExcel's row rules while rows arrive one at a time: the first row
+// is the header and fixes the column count, empty rows are skipped and a run
+// of MAX_CONSECUTIVE_EMPTY empty rows ends the sheet.
+class SheetRowCollector
+{
+public:
+  explicit SheetRowCollector(ExcelSheetStore &store) : m_store(store) {}
+
+  // Returns false once the rest of the sheet should be ignored
+  bool addRow(int row, bool headerRow, QVector<QVariant> &rowData)
+  {
+    int actualColumns = 0;
+    for (int col = 0; col < rowData.size(); ++col) {
+      if (!rowData[col].toString().trimmed().isEmpty())
+        actualColumns = col + 1;
+    }
+
+    if (actualColumns == 0) {
+      if (!headerRow && ++m_consecutiveEmptyRows >= MAX_CONSECUTIVE_EMPTY) {
+        qDebug() << "⏹ Stopped at row" << row << "- found" << MAX_CONSECUTIVE_EMPTY << "consecutive empty rows";
+        return false;
+      }
+      return true;
+    }
+
+    m_consecutiveEmptyRows = 0;
 
-  if (headerText == "purchase") {
-    return "purchase";
-  } else {
-    return "stock";  // default to stock
+    if (m_store.columnCount() == 0) {
+      // Trim the header to its actual columns; data rows are matched to it
+      if (headerRow) {
+        qDebug() << "✓ Found header with" << actualColumns << "columns";
+        rowData.resize(actualColumns);
+      }
+      m_store.reset(rowData.size());
+    }
+
+    m_store.appendRow(rowData);
+    return true;
   }
+
+private:
+  static constexpr int MAX_CONSECUTIVE_EMPTY = 5;
+
+  ExcelSheetStore &m_store;
+  int m_consecutiveEmptyRows = 0;
+};
 }
 
-bool ExcelHandler::loadExcel(const QString &filePath)
+bool ExcelHandler::readSheetStreaming(const QString &filePath, ExcelSheetStore &store, ExcelTask *task)
 {
-  QString cleanPath = cleanFilePath(filePath);
+  store.clear();
+  SheetRowCollector collector(store);
+
+  // Rows arrive in order; a row number jump means the skipped rows are empty.
+  // The first row with cells plays the header, anchored at column A.
+  int headerRow = -1;
+  int currentRow = -1;
+  bool stopped = false;
+  bool canceled = false;
+  QVector<QVariant> rowData;
+
+  auto flushRow = [&](int nextRow) {
+    if (!collector.addRow(currentRow, currentRow == headerRow, rowData))
+      return false;
+    for (int row = currentRow + 1; row < nextRow; ++row) {
+      QVector<QVariant> emptyRow;
+      if (!collector.addRow(row, false, emptyRow))
+        return false;
+    }
+    rowData.clear();
+    return true;
+  };
 
-  qDebug() << "========================================";
-  qDebug() << "Loading Excel file:" << cleanPath;
+  QXlsx::sax_options options;
+  bool ok = QXlsx::read_xlsx_sheet_sax(filePath, 0, options, [&](const QXlsx::sax_cell &cell) {
+    if (cell.col < 1 || cell.col > 26)  // Read columns A-Z only
+      return true;
 
-  QFileInfo fileInfo(cleanPath);
-  if (!fileInfo.exists()) {
-    emit errorOccurred("File does not exist: " + cleanPath);
-    return false;
-  }
+    if (cell.row != currentRow) {
+      if (task && task->isCanceled()) {
+        canceled = true;
+        return false;
+      }
+      if (currentRow == -1) {
+        headerRow = cell.row;
+      } else if (!flushRow(cell.row)) {
+        stopped = true;
+        return false;
+      }
+      currentRow = cell.row;
+      if (task)
+        task->reportRows(store.rowCount());
+    }
 
-  // ✅ CHECK IF IT'S AN EXCEL FILE
-  QString suffix = fileInfo.suffix().toLower();
-  if (suffix != "xlsx" && suffix != "xls") {
-    QString error = "❌ Invalid file type!\n\n"
-                    "Expected: Excel file (.xlsx or .xls)\n"
-                    "Got: ." + suffix + " file\n\n"
-                               "💡 Please select an Excel file (.xlsx)\n"
-                               "💡 Use '📦 Create Stock' or '🛒 Create Purchase' to make new files";
-    qDebug() << "ERROR:" << error;
-    emit errorOccurred(error);
+    // Blank styled cells come through as empty text
+    QVariant value = cell.value;
+    if (value.userType() == QMetaType::QString && value.toString().isEmpty())
+      value = QVariant();
 
-    // Clear the invalid permanent file
-    if (cleanPath == m_permanentFile) {
-      m_permanentFile = "";
-      savePermanentFileSettings();
-      emit permanentFileChanged();
-    }
+    if (rowData.size() < cell.col)
+      rowData.resize(cell.col);
+    rowData[cell.col - 1] = value;
+    return true;
+  });
 
+  if (!ok || canceled)
     return false;
-  }
 
-  QXlsx::Document xlsx(cleanPath);
+  if (!stopped && currentRow != -1)
+    flushRow(currentRow + 1);
+
+  return true;
+}
+
+bool ExcelHandler::readSheetDocument(const QString &filePath, ExcelSheetStore &store,
+                                     ExcelTask *task, QString *error)
+{
+  store.clear();
+
+  // Stock books carry one sheet per department; parse them side by side
+  QXlsx::Document::LoadOptions options;
+  options.parallelSheets = true;
+  QXlsx::Document xlsx(filePath, options);
   if (!xlsx.load()) {
-    emit errorOccurred("Failed to load Excel file");
+    *error = "Failed to load Excel file";
     return false;
   }
 
   QXlsx::Worksheet *sheet = xlsx.currentWorksheet();
   if (!sheet) {
-    emit errorOccurred("No worksheet found");
+    *error = "No worksheet found";
     return false;
   }
 
@@ -717,139 +2020,263 @@ bool ExcelHandler::loadExcel(const QString &filePath)
   qDebug() << "📊 Adjusted range:" << startRow << "to" << endRow
            << ", columns" << startCol << "to" << endCol;
 
-  QVector<QVector<QVariant>> data;
-  int consecutiveEmptyRows = 0;
-  const int MAX_CONSECUTIVE_EMPTY = 5;
+  SheetRowCollector collector(store);
 
   // Read data row by row, checking actual cell content
   for (int row = startRow; row <= endRow; ++row) {
+    if (task && task->isCanceled()) {
+      *error = "Load canceled";
+      return false;
+    }
+
     QVector<QVariant> rowData;
-    bool rowIsEmpty = true;
-    int actualColumns = 0;
 
     // Try to read up to 26 columns (A-Z) or until we find the data
     int maxColToCheck = qMin(endCol, 26);
 
     for (int col = startCol; col <= maxColToCheck; ++col) {
       auto cell = sheet->cellAt(row, col);
-      QVariant cellValue;
-
-      if (cell && cell->value().isValid()) {
-        cellValue = cell->value();
-        // Check if cell has actual data
-        QString strValue = cellValue.toString().trimmed();
-        if (!strValue.isEmpty()) {
-          rowIsEmpty = false;
-          actualColumns = qMax(actualColumns, col - startCol + 1);
-        }
-      }
-
-      rowData.append(cellValue);
+      rowData.append(cell && cell->value().isValid() ? cell->value() : QVariant());
     }
 
-    // For first row (header), determine actual column count
-    if (row == startRow && !rowIsEmpty) {
-      qDebug() << "✓ Found header with" << actualColumns << "columns";
-      // Trim rowData to actual columns
-      while (rowData.size() > actualColumns) {
-        rowData.removeLast();
-      }
-    }
-
-    // Skip completely empty rows after header
-    if (rowIsEmpty && row > startRow) {
-      consecutiveEmptyRows++;
-      if (consecutiveEmptyRows >= MAX_CONSECUTIVE_EMPTY) {
-        qDebug() << "⏹ Stopped at row" << row << "- found" << MAX_CONSECUTIVE_EMPTY << "consecutive empty rows";
-        break;
-      }
-      continue;
-    } else if (!rowIsEmpty) {
-      consecutiveEmptyRows = 0;
-
-      // Match column count with header
-      if (row > startRow && !data.isEmpty()) {
-        int headerCols = data[0].size();
-        while (rowData.size() > headerCols) {
-          rowData.removeLast();
-        }
-        while (rowData.size() < headerCols) {
-          rowData.append(QVariant());
-        }
-      }
-
-      data.append(rowData);
-    }
+    if (!collector.addRow(row, row == startRow, rowData))
+      break;
+    if (task)
+      task->reportRows(store.rowCount());
   }
 
-  // Ensure all rows have the same number of columns
-  if (!data.isEmpty()) {
-    int maxCols = data[0].size(); // Use header column count
+  return true;
+}
+
+bool ExcelHandler::saveExcel(const QString &filePath)
+{
+  // Blocking saves wait for background jobs, which would otherwise rename
+  // their file over this one or discard journal records it doesn't hold
+  if (!checkIdle())
+    return false;
 
-    qDebug() << "📏 Normalizing to" << maxCols << "columns";
+  return saveNow(filePath, false);
+}
 
-    for (auto &row : data) {
-      while (row.size() < maxCols) {
-        row.append(QVariant());
-      }
-      while (row.size() > maxCols) {
-        row.removeLast();
-      }
-    }
-  }
+bool ExcelHandler::saveNow(const QString &filePath, bool compaction)
+{
+  QString savePath = resolveSavePath(filePath);
 
-  if (data.isEmpty()) {
-    emit errorOccurred("No data found in Excel file. The file may be empty or corrupted.");
+  if (savePath.isEmpty()) {
+    emit errorOccurred("No file path specified");
     return false;
   }
 
-  m_model->setExcelData(data);
-  m_currentFile = cleanPath;
-  setUnsavedChanges(false);
-
-  emit currentFileChanged();
-  emit fileLoaded(fileInfo.fileName());
-
-  qDebug() << "✓ Loaded:" << data.size() << "rows x" << (data.isEmpty() ? 0 : data[0].size()) << "columns";
-  qDebug() << "File type:" << getFileType();
   qDebug() << "========================================";
+  qDebug() << "Saving to Excel:" << savePath;
+
+  QString error;
+  qint64 mark = journalMark(savePath);
+  if (!writeWorkbook(m_model->store(), savePath, saveOptions(compaction), nullptr, &error)) {
+    emit errorOccurred(error);
+    return false;
+  }
 
+  QJsonObject base = mark >= 0 ? ExcelJournal::base(m_model->store()) : QJsonObject();
+  finishSave(savePath, m_editGeneration, mark, base);
   return true;
 }
 
-bool ExcelHandler::saveExcel(const QString &filePath)
+bool ExcelHandler::saveExcelAsync(const QString &filePath)
 {
-  QString savePath = filePath.isEmpty() ? m_currentFile : cleanFilePath(filePath);
+  QString savePath = resolveSavePath(filePath);
 
   if (savePath.isEmpty()) {
     emit errorOccurred("No file path specified");
     return false;
   }
 
+  return startSave(savePath, "save", nullptr, false);
+}
+
+bool ExcelHandler::startSave(const QString &savePath, const QString &operation,
+                             std::function<void(bool)> done, bool compaction)
+{
+  std::shared_ptr<ExcelTask> task = beginOperation(operation);
+  if (!task)
+    return false;
+
+  qDebug() << "========================================";
+  qDebug() << "Saving to Excel in background:" << savePath;
+
+  // The store is implicitly shared: the snapshot is cheap, and edits made
+  // while the worker writes detach from it instead of racing it
+  ExcelSheetStore snapshot = m_model->store();
+  quint64 generation = m_editGeneration;
+  qint64 mark = journalMark(savePath);
+
+  m_workerPool.start([this, task, snapshot, savePath, generation, mark, done, compaction]() {
+    QString error;
+    bool ok = writeWorkbook(snapshot, savePath, saveOptions(compaction), task.get(), &error);
+    // Header for the journal records left once the snapshot is saved
+    QJsonObject base = ok && mark >= 0 ? ExcelJournal::base(snapshot) : QJsonObject();
+    task->flush();
+
+    QMetaObject::invokeMethod(this, [this, task, savePath, generation, mark, base, done, ok,
+                                     error]() {
+      if (ok)
+        finishSave(savePath, generation, mark, base);
+      else if (!task->isCanceled())
+        emit errorOccurred(error);
+      if (done)
+        done(ok);
+      endOperation(ok);
+    }, Qt::QueuedConnection);
+  });
+
+  return true;
+}
+
+QString ExcelHandler::resolveSavePath(const QString &filePath)
+{
+  QString savePath = filePath.isEmpty() ? m_currentFile : cleanFilePath(filePath);
+
   // Add .xlsx extension if not present
-  if (!savePath.endsWith(".xlsx", Qt::CaseInsensitive) && !savePath.endsWith(".xls", Qt::CaseInsensitive)) {
+  if (!savePath.isEmpty() && !savePath.endsWith(".xlsx", Qt::CaseInsensitive)
+      && !savePath.endsWith(".xls", Qt::CaseInsensitive)) {
     savePath += ".xlsx";
   }
 
-  qDebug() << "========================================";
-  qDebug() << "Saving to Excel:" << savePath;
+  return savePath;
+}
 
-  QXlsx::Document xlsx;
-  QVector<QVector<QVariant>> data = m_model->getExcelData();
+namespace {
+// QSaveFile that reports bytes as QXlsx writes them and fails the write once
+// the task is canceled, which makes Document::saveAs() give up early
+class ProgressFile : public QSaveFile
+{
+public:
+  ProgressFile(const QString &name, ExcelTask *task) : QSaveFile(name), m_task(task) {}
+
+  bool failed() const { return m_failed; }
+
+protected:
+  qint64 writeData(const char *data, qint64 len) override
+  {
+    if (m_task && m_task->isCanceled()) {
+      m_failed = true;
+      return -1;
+    }
 
-  for (int row = 0; row < data.size(); ++row) {
-    for (int col = 0; col < data[row].size(); ++col) {
-      xlsx.write(row + 1, col + 1, data[row][col]);
+    qint64 written = QSaveFile::writeData(data, len);
+    if (written < 0) {
+      m_failed = true;
+    } else {
+      m_bytesWritten += written;
+      if (m_task)
+        m_task->reportBytes(m_bytesWritten);
     }
+    return written;
+  }
+
+private:
+  ExcelTask *m_task;
+  qint64 m_bytesWritten = 0;
+  bool m_failed = false;
+};
+
+// Plain numbers and strings go into the row written with writeRow(). Anything
+// write() would treat specially (formulas, links, dates, ...) returns false and
+// is written on its own.
+bool toCellValue(const QVariant &value, QXlsx::CellValue *cell)
+{
+  switch (value.isNull() ? QMetaType::UnknownType : value.userType()) {
+  case QMetaType::UnknownType:
+    *cell = QXlsx::CellValue();
+    return true;
+  case QMetaType::Int:
+  case QMetaType::UInt:
+  case QMetaType::LongLong:
+  case QMetaType::ULongLong:
+  case QMetaType::Double:
+  case QMetaType::Float:
+    *cell = QXlsx::CellValue(value.toDouble());
+    return true;
+  case QMetaType::QString: {
+    QString text = value.toString();
+    // A superset of what QXlsx turns into formulas and hyperlinks
+    if (text.startsWith('=') || text.contains("://") || text.contains("mailto:"))
+      return false;
+    *cell = QXlsx::CellValue(text);
+    return true;
+  }
+  default:
+    return false;
   }
+}
+}
+
+// Folding the journal into its workbook happens in the background and on
+// quit, so it trades file size for speed; explicit saves, including those of
+// the journaled workbook, keep the default
+QXlsx::Document::SaveOptions ExcelHandler::saveOptions(bool compaction)
+{
+  QXlsx::Document::SaveOptions options;
+  if (compaction) {
+    options.compression = QXlsx::Document::SaveOptions::FastCompression;
+    options.storeBelow = 4096;
+  }
+  return options;
+}
+
+bool ExcelHandler::writeWorkbook(const ExcelSheetStore &store, const QString &savePath,
+                                 const QXlsx::Document::SaveOptions &options,
+                                 ExcelTask *task, QString *error)
+{
+  QXlsx::Document xlsx;
 
-  if (!xlsx.saveAs(savePath)) {
-    emit errorOccurred("Failed to save file");
+  // Each row goes in with one typed call; the few cells that need write()'s
+  // conversions are left blank there and written after it
+  QVector<QXlsx::CellValue> rowValues(store.columnCount());
+  QVector<int> specialColumns;
+  for (int row = 0; row < store.rowCount(); ++row) {
+    if (task && task->isCanceled()) {
+      *error = "Save canceled";
+      return false;
+    }
+    specialColumns.clear();
+    for (int col = 0; col < store.columnCount(); ++col) {
+      if (!toCellValue(store.value(row, col), &rowValues[col])) {
+        rowValues[col] = QXlsx::CellValue();
+        specialColumns.append(col);
+      }
+    }
+    xlsx.writeRow(row + 1, 1, rowValues);
+    for (int col : specialColumns)
+      xlsx.write(row + 1, col + 1, store.value(row, col));
+    if (task)
+      task->reportRows(row + 1);
+  }
+
+  // QSaveFile writes beside the target and renames over it on commit, so a
+  // failed, canceled or interrupted save leaves the previous file intact
+  ProgressFile file(savePath, task);
+  bool written = file.open(QIODevice::WriteOnly) && xlsx.saveAs(&file, options)
+                 && !file.failed() && file.commit();
+  if (!written) {
+    *error = task && task->isCanceled() ? "Save canceled" : "Failed to save file";
     return false;
   }
 
+  return true;
+}
+
+void ExcelHandler::finishSave(const QString &savePath, quint64 generation, qint64 mark,
+                              const QJsonObject &base)
+{
+  // The workbook now holds every journaled edit up to the save's snapshot
+  if (mark >= 0 && m_journal.workbookPath() == savePath)
+    m_journal.discardThrough(mark, base);
+
   m_currentFile = savePath;
-  setUnsavedChanges(false);
+  updateJournal();
+  // Edits made while a background save was running are not in the file yet
+  setUnsavedChanges(generation != m_editGeneration);
 
   emit currentFileChanged();
   emit fileSaved(QFileInfo(savePath).fileName());
@@ -857,40 +2284,60 @@ bool ExcelHandler::saveExcel(const QString &filePath)
   qDebug() << "✓ Saved successfully";
   qDebug() << "File size:" << QFileInfo(savePath).size() << "bytes";
   qDebug() << "========================================";
-
-  return true;
 }
 
 bool ExcelHandler::validateFileStructure(const QString &filePath)
 {
-  QString cleanPath = cleanFilePath(filePath);
+  return isPurchaseFile(cleanFilePath(filePath));
+}
 
-  qDebug() << "========================================";
-  qDebug() << "🔍 Validating file structure:" << cleanPath;
+bool ExcelHandler::readHeaderRow(const QString &filePath, int columns, QVector<QString> &headers)
+{
+  headers = QVector<QString>(columns);
+
+  // Peek at row 1 only; the reader stops before the first data row
+  QXlsx::sax_options options;
+  options.max_row = 1;
+  bool ok = QXlsx::read_xlsx_sheet_sax(filePath, 0, options, [&](const QXlsx::sax_cell &cell) {
+    if (cell.row == 1 && cell.col >= 1 && cell.col <= columns)
+      headers[cell.col - 1] = cell.value.toString().trimmed();
+    return true;
+  });
+  if (ok)
+    return true;
 
-  QXlsx::Document xlsx(cleanPath);
-  if (!xlsx.load()) {
-    qDebug() << "❌ Failed to load file";
+  qDebug() << "⚠ Streaming read failed, falling back to full document load";
+  QXlsx::Document xlsx(filePath);
+  QXlsx::Worksheet *sheet = xlsx.load() ? xlsx.currentWorksheet() : nullptr;
+  if (!sheet)
     return false;
+
+  for (int col = 1; col <= columns; ++col) {
+    auto cell = sheet->cellAt(1, col);
+    headers[col - 1] = cell ? cell->value().toString().trimmed() : "";
   }
+  return true;
+}
 
-  QXlsx::Worksheet *sheet = xlsx.currentWorksheet();
-  if (!sheet) {
-    qDebug() << "❌ No worksheet found";
+bool ExcelHandler::isPurchaseFile(const QString &filePath)
+{
+  qDebug() << "========================================";
+  qDebug() << "🔍 Validating file structure:" << filePath;
+
+  QVector<QString> headers;
+  if (!readHeaderRow(filePath, 7, headers)) {
+    qDebug() << "❌ Failed to load file";
     return false;
   }
 
   // Check columns structure (7 columns)
   qDebug() << "Checking headers:";
   for (int col = 1; col <= 7; ++col) {
-    auto cell = sheet->cellAt(1, col);
-    QString header = cell ? cell->value().toString().trimmed() : "";
-    qDebug() << "  Column" << col << ":" << header;
+    qDebug() << "  Column" << col << ":" << headers[col - 1];
   }
 
   // Column 3 should be "Purchase" for merge files
-  auto col3Cell = sheet->cellAt(1, 3);
-  QString col3Header = col3Cell ? col3Cell->value().toString().trimmed() : "";
+  QString col3Header = headers[2];
 
   qDebug() << "";
   qDebug() << "Column 3 header:" << col3Header;
@@ -926,14 +2373,15 @@ void ExcelHandler::addNewItem(const QString &partName, const QString &category,
     m_model->setDataAt(existingRow, 2, currentStock + quantity);
     qDebug() << "  Updated existing - new stock:" << (currentStock + quantity);
   } else {
-    m_model->addRow();
-    int newRow = m_model->rowCount() - 1;
+    m_model->beginBatch();
+    int newRow = m_model->addRow();
 
     // Column mapping: 0=Part Name, 1=Part No, 2=Stock, 3=Department, ...
     m_model->setDataAt(newRow, 0, partName);                      // Part Name
     m_model->setDataAt(newRow, 1, "PN-" + QString::number(newRow)); // Part No
     m_model->setDataAt(newRow, 2, quantity);                      // Stock
     m_model->setDataAt(newRow, 3, category);                      // Department
+    m_model->commitBatch();
 
     qDebug() << "  Added new row:" << newRow;
   }
@@ -942,10 +2390,11 @@ void ExcelHandler::addNewItem(const QString &partName, const QString &category,
 int ExcelHandler::getNextSerialNumber() const
 {
   int maxNo = 0;
-  int rows = m_model->rowCount();
+  const ExcelSheetStore &store = m_model->store();
+  int rows = store.columnCount() > 0 ? store.rowCount() : 0;
 
   for (int row = 1; row < rows; ++row) {
-    int no = m_model->getData(row, 0).toInt();
+    int no = store.intValue(row, 0);
     if (no > maxNo) {
       maxNo = no;
     }
@@ -954,13 +2403,115 @@ int ExcelHandler::getNextSerialNumber() const
   return maxNo + 1;
 }
 
+void ExcelHandler::setStreamingLoad(bool enabled)
+{
+  if (m_streamingLoad != enabled) {
+    m_streamingLoad = enabled;
+    emit streamingLoadChanged();
+  }
+}
+
+bool ExcelHandler::checkIdle()
+{
+  if (!m_task)
+    return true;
+
+  emit errorOccurred("Please wait - another file operation (" + m_operation + ") is still running");
+  return false;
+}
+
+std::shared_ptr<ExcelTask> ExcelHandler::beginOperation(const QString &operation)
+{
+  if (!checkIdle())
+    return nullptr;
+
+  // Progress is posted back to the UI thread; queued events arrive in order,
+  // so every update lands before the job's completion
+  m_task = std::make_shared<ExcelTask>([this, operation](int rows, qint64 bytes) {
+    QMetaObject::invokeMethod(this, [this, operation, rows, bytes]() {
+      emit operationProgress(operation, rows, bytes);
+    }, Qt::QueuedConnection);
+  });
+  m_operation = operation;
+
+  emit busyChanged();
+  emit operationStarted(operation);
+  return m_task;
+}
+
+void ExcelHandler::endOperation(bool success)
+{
+  QString operation = m_operation;
+  bool canceled = m_task && m_task->isCanceled();
+  m_task.reset();
+  m_operation.clear();
+
+  qDebug() << (success ? "✓" : canceled ? "⏹" : "❌") << "Background" << operation
+           << (success ? "finished" : canceled ? "canceled" : "failed");
+
+  emit busyChanged();
+  emit operationFinished(operation, success);
+}
+
+void ExcelHandler::cancelOperation()
+{
+  if (m_task) {
+    qDebug() << "⏹ Canceling" << m_operation << "...";
+    m_task->cancel();
+  }
+}
+
 void ExcelHandler::onModelDataChanged()
 {
   setUnsavedChanges(true);
+
+  if (m_journal.isOpen() && !m_compactTimer.isActive())
+    m_compactTimer.start();
+}
+
+void ExcelHandler::updateJournal()
+{
+  // Only the permanent workbook is journaled
+  bool wanted = !m_permanentFile.isEmpty() && m_currentFile == m_permanentFile;
+  if (wanted && m_journal.isOpen() && m_journal.workbookPath() == m_currentFile)
+    return;
+
+  m_model->setJournal(nullptr);
+  m_journal.close();
+  m_compactTimer.stop();
+
+  if (wanted && m_journal.open(m_currentFile, ExcelJournal::base(m_model->store())))
+    m_model->setJournal(&m_journal);
+}
+
+bool ExcelHandler::isJournaled(const QString &workbookPath) const
+{
+  return m_journal.isOpen() && m_journal.workbookPath() == workbookPath;
+}
+
+qint64 ExcelHandler::journalMark(const QString &savePath) const
+{
+  return isJournaled(savePath) ? m_journal.size() : -1;
+}
+
+void ExcelHandler::compactJournal()
+{
+  if (!m_journal.isOpen() || m_journal.isEmpty())
+    return;
+
+  // A background save may still be writing; let it finish first
+  m_workerPool.waitForDone();
+
+  // The finished job's completion is still queued, so skip checkIdle()
+  qDebug() << "🗜 Compacting journal into" << m_journal.workbookPath();
+  saveNow(m_journal.workbookPath(), true);
 }
 
 void ExcelHandler::setUnsavedChanges(bool changed)
 {
+  if (changed)
+    ++m_editGeneration;
+
   if (m_hasUnsavedChanges != changed) {
     m_hasUnsavedChanges = changed;
     emit unsavedChangesChanged();
@@ -1159,6 +2710,32 @@ bool ExcelHandler::unlockFile(const QString &filePath)
 }
 
 bool ExcelHandler::syncToCloud()
+{
+  QString cloudFilePath;
+  bool inPlace = false;
+  if (!checkIdle() || !prepareCloudSync(&cloudFilePath, &inPlace))
+    return false;
+
+  return finishCloudSync(cloudFilePath, inPlace, saveExcel(m_currentFile));
+}
+
+bool ExcelHandler::syncToCloudAsync()
+{
+  QString cloudFilePath;
+  bool inPlace = false;
+  if (!checkIdle() || !prepareCloudSync(&cloudFilePath, &inPlace))
+    return false;
+
+  bool started = startSave(resolveSavePath(m_currentFile), "sync", [this, cloudFilePath, inPlace](bool saved) {
+    finishCloudSync(cloudFilePath, inPlace, saved);
+  }, false);
+  if (!started)
+    finishCloudSync(cloudFilePath, inPlace, false);
+
+  return started;
+}
+
+bool ExcelHandler::prepareCloudSync(QString *cloudFilePath, bool *inPlace)
 {
   if (m_cloudFolder.isEmpty()) {
     emit errorOccurred("No cloud folder configured. Please set cloud folder first.");
@@ -1181,15 +2758,33 @@ bool ExcelHandler::syncToCloud()
 
   updateSyncStatus("syncing");
 
-  QString cloudFilePath = getCloudFilePath();
-  qDebug() << "Cloud file path:" << cloudFilePath;
+  *cloudFilePath = getCloudFilePath();
+  qDebug() << "Cloud file path:" << *cloudFilePath;
 
   // Check if current file is already the cloud file
-  if (QFileInfo(m_currentFile).canonicalFilePath() == QFileInfo(cloudFilePath).canonicalFilePath()) {
+  *inPlace = QFileInfo(m_currentFile).canonicalFilePath() == QFileInfo(*cloudFilePath).canonicalFilePath();
+  if (*inPlace) {
     qDebug() << "✓ Current file is already in cloud, just saving...";
+    return true;
+  }
+
+  // Check if file is locked by another user
+  if (isFileLocked(*cloudFilePath)) {
+    emit errorOccurred("File is being edited by another user. Please try again later.");
+    updateSyncStatus("conflict");
+    return false;
+  }
+
+  // Lock the file
+  lockFile(*cloudFilePath);
+  return true;
+}
 
-    // Just save the file (it's already in the cloud location)
-    if (saveExcel(m_currentFile)) {
+bool ExcelHandler::finishCloudSync(const QString &cloudFilePath, bool inPlace, bool saved)
+{
+  if (inPlace) {
+    // Just saved the file (it's already in the cloud location)
+    if (saved) {
       m_lastSyncTime = QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss");
       saveCloudSettings();
       emit lastSyncTimeChanged();
@@ -1205,18 +2800,8 @@ bool ExcelHandler::syncToCloud()
     }
   }
 
-  // Check if file is locked by another user
-  if (isFileLocked(cloudFilePath)) {
-    emit errorOccurred("File is being edited by another user. Please try again later.");
-    updateSyncStatus("conflict");
-    return false;
-  }
-
-  // Lock the file
-  lockFile(cloudFilePath);
-
-  // Save current file first
-  if (!saveExcel(m_currentFile)) {
+  // Current file must be saved before it is copied
+  if (!saved) {
     unlockFile(cloudFilePath);
     emit errorOccurred("Failed to save local file");
     updateSyncStatus("synced");
@@ -1258,6 +2843,10 @@ bool ExcelHandler::syncToCloud()
 
 bool ExcelHandler::syncFromCloud()
 {
+  // The download replaces the workbook and its journal under a running job
+  if (!checkIdle())
+    return false;
+
   if (m_cloudFolder.isEmpty()) {
     emit errorOccurred("No cloud folder configured");
     return false;
@@ -1293,6 +2882,8 @@ bool ExcelHandler::syncFromCloud()
       // Copy cloud file to permanent file location
       QFile::remove(m_permanentFile);
       if (QFile::copy(cloudFilePath, m_permanentFile)) {
+        // The downloaded workbook replaces any edits journaled locally
+        QFile::remove(ExcelJournal::journalPath(m_permanentFile));
         m_currentFile = m_permanentFile;
         qDebug() << "✓ Copied cloud file to permanent location";
       } else {
@@ -1314,6 +2905,8 @@ bool ExcelHandler::syncFromCloud()
       m_currentFile = cloudFilePath;
     }
 
+    updateJournal();
+
     m_lastSyncTime = QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss");
     saveCloudSettings();
     emit lastSyncTimeChanged();
@@ -15,14 +15,162 @@
 #include <QDesktopServices>
 #include <QDateTime>
 #include <QSet>
+#include <QMultiHash>
 #include <QTimer>
+#include <QThreadPool>
+#include <QJsonArray>
+#include <QJsonObject>
 #include <xlsxdocument.h>
 #include <xlsxworksheet.h>
 
+#include <atomic>
+#include <functional>
+#include <memory>
+
+// Column-oriented cell storage behind ExcelTableModel.
+// Part Name, Department and Vendor are interned strings, Stock/Purchase is an
+// int32 column and the remaining columns keep plain QVariants. A cell that does
+// not fit its column type (e.g. the header text) is kept in a per-column
+// overflow map, so value() always returns what was stored.
+class ExcelSheetStore
+{
+public:
+  enum ColumnType {
+    VariantColumn,
+    StringColumn,
+    IntColumn
+  };
+
+  static ColumnType columnType(int column);
+
+  int rowCount() const { return m_rowCount; }
+  int columnCount() const { return m_columns.size(); }
+  bool isEmpty() const { return m_rowCount == 0; }
+
+  void reset(int columns);
+  void reserve(int rows);
+  void clear();
+  void appendRow(const QVector<QVariant> &row);
+  void appendEmptyRow();
+  void appendColumn();
+
+  // No bounds checks, callers validate row/column
+  QVariant value(int row, int column) const;
+  QString text(int row, int column) const;
+  int intValue(int row, int column) const;
+  void setValue(int row, int column, const QVariant &value);
+
+  QVector<QVector<QVariant>> toRows() const;
+
+private:
+  struct Column {
+    ColumnType type = VariantColumn;
+    QVector<qint32> cells;          // string id or int value (typed columns)
+    QVector<QVariant> variants;     // VariantColumn cells
+    QHash<int, QVariant> overflow;  // typed-column cells holding another type
+  };
+
+  qint32 intern(const QString &text);
+
+  QVector<Column> m_columns;
+  QVector<QString> m_strings;
+  QHash<QString, qint32> m_stringIds;
+  int m_rowCount = 0;
+};
+
+// Trigram inverted index over the searchable text of each row.
+// Every case-folded three-character window of a row's fields maps to the
+// sorted list of rows containing it; a substring query only has to check the
+// rows present in all of its trigrams' lists.
+class ExcelSearchIndex
+{
+public:
+  static constexpr int GRAM = 3;
+
+  void clear() { m_postings.clear(); }
+
+  // Moves a row from the trigrams of `before` to those of `after`
+  void updateRow(int row, const QStringList &before, const QStringList &after);
+
+  // Rows that may contain the query; `query` must be at least GRAM long
+  QVector<int> candidates(const QString &query) const;
+
+private:
+  using Trigram = quint64;
+
+  static QVector<Trigram> trigrams(const QStringList &fields);
+
+  QHash<Trigram, QVector<int>> m_postings;
+};
+
+class ExcelTableModel;
+
+// Write-ahead journal of edits to the permanent workbook, kept beside it as
+// "<workbook>.journal". Each edit is one JSON line, appended and fsync'd, so
+// a crash loses nothing; saving the workbook compacts the journal away.
+class ExcelJournal
+{
+public:
+  static QString journalPath(const QString &workbookPath) { return workbookPath + ".journal"; }
+
+  // A new journal starts with `base`, the header describing the sheet its
+  // records apply to (see base() below)
+  bool open(const QString &workbookPath, const QJsonObject &base);
+  void close();
+  bool isOpen() const { return m_file.isOpen(); }
+  QString workbookPath() const { return m_workbookPath; }
+  qint64 size() const { return m_file.isOpen() ? m_file.size() : 0; }
+  // No records after the header
+  bool isEmpty() const { return size() <= m_baseSize; }
+
+  bool append(const QJsonObject &record);
+
+  // Drops the records before `offset` once the workbook contains them; the
+  // rest now apply to the saved sheet, described by `base`
+  bool discardThrough(qint64 offset, const QJsonObject &base);
+
+  // Re-applies a workbook's journal to the model, setting `applied` to the
+  // records applied. Returns false if the journal was written for another
+  // state of the sheet or one of its records doesn't apply.
+  static bool replay(const QString &workbookPath, ExcelTableModel *model, int *applied);
+
+  // Header for a journal whose records apply to `store`. Row indices are the
+  // store's, so it also lists the empty rows the loader will drop, for
+  // replay() to put back, and a checksum of the Part Names.
+  static QJsonObject base(const ExcelSheetStore &store);
+
+  // Record builders
+  static QJsonObject setCell(int row, int column, const QVariant &value);
+  static QJsonObject appendRows(int firstRow, const QVector<QVector<QVariant>> &rows);
+  static QJsonObject appendColumn();
+  static QJsonObject batch(const QJsonArray &records);
+
+private:
+  static bool rebase(const QJsonObject &base, ExcelTableModel *model);
+  static bool apply(const QJsonObject &record, ExcelTableModel *model);
+
+  QString m_workbookPath;
+  QFile m_file;
+  qint64 m_baseSize = 0;
+};
+
 class ExcelTableModel : public QAbstractTableModel
 {
   Q_OBJECT
 public:
+  // One role per sheet column, so a delegate can read any field of its row
+  // (model.partName, model.stock, ...); "display" is the cell's own column
+  enum ColumnRole {
+    PartNameRole = Qt::UserRole + 1,
+    PartNoRole,
+    StockRole,
+    DepartmentRole,
+    PreparedRole,
+    ApprovedRole,
+    VendorRole
+  };
+  Q_ENUM(ColumnRole)
+
   explicit ExcelTableModel(QObject *parent = nullptr);
 
   int rowCount(const QModelIndex &parent = QModelIndex()) const override;
@@ -31,18 +179,102 @@ public:
   bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole) override;
   Qt::ItemFlags flags(const QModelIndex &index) const override;
   QHash<int, QByteArray> roleNames() const override;
+  QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
 
   void setExcelData(const QVector<QVector<QVariant>> &data);
   QVector<QVector<QVariant>> getExcelData() const;
+  void setStore(const ExcelSheetStore &store);
+  const ExcelSheetStore &store() const { return m_store; }
 
   Q_INVOKABLE QVariant getData(int row, int column) const;
   Q_INVOKABLE bool setDataAt(int row, int column, const QVariant &value);
-  Q_INVOKABLE void addRow();
+  Q_INVOKABLE int addRow();
+  int appendRows(const QVector<QVector<QVariant>> &rows);
   Q_INVOKABLE void addColumn();
   Q_INVOKABLE void clear();
 
+  // Batched edits: between beginBatch() and the matching commitBatch(),
+  // setDataAt/addRow only touch the store. The commit then announces the
+  // new rows with one insert and the edited cells with one dataChanged.
+  Q_INVOKABLE void beginBatch();
+  Q_INVOKABLE void commitBatch();
+  bool inBatch() const { return m_batchDepth > 0; }
+
+  // Edits are recorded to the journal while one is set; a batch is written
+  // as a single record when it commits
+  void setJournal(ExcelJournal *journal) { m_journal = journal; }
+
+  // Part Name lookup (column 0, header row excluded)
+  int findRowByName(const QString &partName) const;
+  static QString normalizeName(const QVariant &name);
+
+  // Rows whose Part Name, Part No or Vendor contain `text`, best first:
+  // exact name, name prefix, name substring, then Part No and Vendor hits
+  QVector<int> searchRows(const QString &text, int limit) const;
+
+private:
+  ExcelSheetStore m_store;
+
+  // Batch state: rows published to views, and the bounding box of edited
+  // cells among them (top > bottom when nothing is dirty)
+  int m_batchDepth = 0;
+  int m_batchRows = 0;
+  int m_dirtyTop = 0;
+  int m_dirtyBottom = -1;
+  int m_dirtyLeft = 0;
+  int m_dirtyRight = -1;
+
+  static int roleColumn(const QModelIndex &index, int role);
+  void emitCellsChanged(int top, int left, int bottom, int right);
+  void markDirty(int row, int column);
+  void resetBatchState();
+
+  ExcelJournal *m_journal = nullptr;
+  QJsonArray m_journalBatch;
+
+  void journal(const QJsonObject &record);
+
+  // normalized Part Name -> rows holding it
+  QMultiHash<QString, int> m_nameIndex;
+
+  void indexName(int row, const QVariant &name);
+  void unindexName(int row, const QVariant &name);
+  void rebuildNameIndex();
+
+  // Part Name, Part No and Vendor (columns 0, 1 and 6), header row excluded
+  ExcelSearchIndex m_searchIndex;
+
+  QStringList searchFields(int row) const;
+  void rebuildSearchIndex();
+};
+
+// Cancel flag and progress sink shared between ExcelHandler and a background job.
+// Progress is throttled so the worker does not flood the event loop.
+class ExcelTask
+{
+public:
+  using ProgressCallback = std::function<void(int rowsProcessed, qint64 bytesWritten)>;
+
+  explicit ExcelTask(ProgressCallback progress = ProgressCallback())
+    : m_progress(std::move(progress)) {}
+
+  void cancel() { m_canceled = true; }
+  bool isCanceled() const { return m_canceled; }
+
+  void reportRows(int rows);
+  void reportBytes(qint64 bytes);
+  void flush();
+
 private:
-  QVector<QVector<QVariant>> m_data;
+  static constexpr int ROW_STEP = 1000;
+  static constexpr qint64 BYTE_STEP = 256 * 1024;
+
+  std::atomic_bool m_canceled{false};
+  ProgressCallback m_progress;
+  int m_rows = 0;
+  qint64 m_bytes = 0;
+  int m_reportedRows = 0;
+  qint64 m_reportedBytes = 0;
 };
 
 class ExcelHandler : public QObject
@@ -52,6 +284,8 @@ class ExcelHandler : public QObject
   Q_PROPERTY(QString currentFile READ currentFile NOTIFY currentFileChanged)
   Q_PROPERTY(bool hasUnsavedChanges READ hasUnsavedChanges NOTIFY unsavedChangesChanged)
   Q_PROPERTY(QString permanentFile READ permanentFile NOTIFY permanentFileChanged)
+  Q_PROPERTY(bool streamingLoad READ streamingLoad WRITE setStreamingLoad NOTIFY streamingLoadChanged)
+  Q_PROPERTY(bool busy READ busy NOTIFY busyChanged)
 
   // Cloud Sync Properties
   Q_PROPERTY(QString cloudFolder READ cloudFolder WRITE setCloudFolder NOTIFY cloudFolderChanged)
@@ -63,11 +297,15 @@ class ExcelHandler : public QObject
 
 public:
   explicit ExcelHandler(QObject *parent = nullptr);
+  ~ExcelHandler() override;
 
   ExcelTableModel* model() const { return m_model; }
   QString currentFile() const { return m_currentFile; }
   bool hasUnsavedChanges() const { return m_hasUnsavedChanges; }
   QString permanentFile() const { return m_permanentFile; }
+  bool streamingLoad() const { return m_streamingLoad; }
+  void setStreamingLoad(bool enabled);
+  bool busy() const { return m_task != nullptr; }
 
   Q_INVOKABLE void createNew(int rows = 10, int cols = 10);
   Q_INVOKABLE void createStockFile(int rows = 15);
@@ -77,6 +315,14 @@ public:
   Q_INVOKABLE bool loadExcel(const QString &filePath);
   Q_INVOKABLE bool saveExcel(const QString &filePath = QString());
 
+  // Background variants: return false if the job could not start, report
+  // through operationProgress and finish with operationFinished
+  Q_INVOKABLE bool loadExcelAsync(const QString &filePath);
+  Q_INVOKABLE bool saveExcelAsync(const QString &filePath = QString());
+  Q_INVOKABLE bool appendFromFileAsync(const QString &filePath);
+  Q_INVOKABLE bool syncToCloudAsync();
+  Q_INVOKABLE void cancelOperation();
+
   // Permanent file management
   Q_INVOKABLE bool setPermanentFile(const QString &filePath);
   Q_INVOKABLE bool loadPermanentFile();
@@ -90,7 +336,7 @@ public:
 
   // Search functionality
   Q_INVOKABLE int searchPartName(const QString &partName);
-  Q_INVOKABLE QVariantList searchAllMatches(const QString &searchText);
+  Q_INVOKABLE QVariantList searchAllMatches(const QString &searchText, int maxResults = 100);
 
   // File upload management
   Q_INVOKABLE bool uploadFileForPart(int row, const QString &filePath);
@@ -128,6 +374,11 @@ signals:
   void currentFileChanged();
   void unsavedChangesChanged();
   void permanentFileChanged();
+  void streamingLoadChanged();
+  void busyChanged();
+  void operationStarted(const QString &operation);
+  void operationProgress(const QString &operation, int rowsProcessed, qint64 bytesWritten);
+  void operationFinished(const QString &operation, bool success);
   void errorOccurred(const QString &error);
   void fileLoaded(const QString &fileName);
   void fileSaved(const QString &fileName);
@@ -152,8 +403,19 @@ private:
   QString m_currentFile;
   QString m_permanentFile;
   bool m_hasUnsavedChanges;
+  bool m_streamingLoad;
   QString m_uploadsDir;
 
+  // Background jobs: one at a time on a dedicated worker thread
+  QThreadPool m_workerPool;
+  std::shared_ptr<ExcelTask> m_task;
+  QString m_operation;
+  quint64 m_editGeneration = 0;
+
+  // Journal of the permanent workbook, compacted by a deferred background save
+  ExcelJournal m_journal;
+  QTimer m_compactTimer;
+
   // Cloud sync members
   QString m_cloudFolder;
   bool m_syncEnabled;
@@ -169,7 +431,66 @@ private:
   void loadPermanentFileSettings();
   void initializeUploadsDirectory();
   int findPartByName(const QString &partName);
-  bool updateExistingPart(int row, const QVector<QVariant> &newData);
+
+  // Sheet readers: SAX straight into the store, or the full QXlsx::Document
+  static bool readSheet(const QString &filePath, bool streaming, ExcelSheetStore &store,
+                        ExcelTask *task, QString *error);
+  static bool readSheetStreaming(const QString &filePath, ExcelSheetStore &store, ExcelTask *task);
+  static bool readSheetDocument(const QString &filePath, ExcelSheetStore &store,
+                                ExcelTask *task, QString *error);
+  static bool writeWorkbook(const ExcelSheetStore &store, const QString &savePath,
+                            const QXlsx::Document::SaveOptions &options,
+                            ExcelTask *task, QString *error);
+  static QXlsx::Document::SaveOptions saveOptions(bool compaction);
+  static bool readHeaderRow(const QString &filePath, int columns, QVector<QString> &headers);
+  static bool isPurchaseFile(const QString &filePath);
+  static bool readPurchaseFile(const QString &filePath, QVector<QVector<QVariant>> &rows,
+                               ExcelTask *task, QString *error);
+  static bool readPurchaseDocument(const QString &filePath, QVector<QVector<QVariant>> &rows,
+                                   ExcelTask *task, QString *error);
+
+  // Main-thread halves shared by the blocking and background variants
+  bool checkExcelPath(const QString &cleanPath);
+  void applyLoadedSheet(const QString &cleanPath, const ExcelSheetStore &store);
+  QString resolveSavePath(const QString &filePath);
+  bool saveNow(const QString &filePath, bool compaction);
+  void finishSave(const QString &savePath, quint64 generation, qint64 mark,
+                  const QJsonObject &base);
+  bool isJournaled(const QString &workbookPath) const;
+  qint64 journalMark(const QString &savePath) const;
+  void updateJournal();
+  void compactJournal();
+
+  // Purchase merge as a delta against the current stock: rows to update in
+  // place (invalid entries are left alone) and new parts to append
+  struct PurchaseMerge
+  {
+    struct Update
+    {
+      int row = -1;
+      QVector<QVariant> values;
+    };
+
+    QVector<Update> updates;
+    QVector<QVector<QVariant>> inserts;
+    int duplicatesSkipped = 0;
+
+    int rowsAdded() const { return inserts.size(); }
+    int rowsUpdated() const { return updates.size(); }
+  };
+
+  PurchaseMerge planPurchaseMerge(const QVector<QVector<QVariant>> &rows) const;
+  void applyPurchaseMerge(const PurchaseMerge &merge);
+  bool prepareCloudSync(QString *cloudFilePath, bool *inPlace);
+  bool finishCloudSync(const QString &cloudFilePath, bool inPlace, bool saved);
+
+  // Background job plumbing
+  bool checkIdle();
+  std::shared_ptr<ExcelTask> beginOperation(const QString &operation);
+  void endOperation(bool success);
+  // `compaction` marks saves that fold the journal in (timer, quit)
+  bool startSave(const QString &savePath, const QString &operation,
+                 std::function<void(bool)> done, bool compaction);
 
   // Cloud sync helpers
   void updateSyncStatus(const QString &status);